@@ -0,0 +1,246 @@
+# Microsoft Developer Studio Project File - Name="Benchmark" - Package Owner=<4>
+# Microsoft Developer Studio Generated Build File, Format Version 6.00
+# ** DO NOT EDIT **
+
+# TARGTYPE "Win32 (x86) Console Application" 0x0103
+
+CFG=Benchmark - Win32 Release
+!MESSAGE This is not a valid makefile. To build this project using NMAKE,
+!MESSAGE use the Export Makefile command and run
+!MESSAGE 
+!MESSAGE NMAKE /f "Benchmark.mak".
+!MESSAGE 
+!MESSAGE You can specify a configuration when running NMAKE
+!MESSAGE by defining the macro CFG on the command line. For example:
+!MESSAGE 
+!MESSAGE NMAKE /f "Benchmark.mak" CFG="Benchmark - Win32 Release"
+!MESSAGE 
+!MESSAGE Possible choices for configuration are:
+!MESSAGE 
+!MESSAGE "Benchmark - Win32 Release" (based on "Win32 (x86) Console Application")
+!MESSAGE "Benchmark - Win32 Debug" (based on "Win32 (x86) Console Application")
+!MESSAGE 
+
+# Begin Project
+# PROP AllowPerConfigDependencies 0
+# PROP Scc_ProjName ""
+# PROP Scc_LocalPath ""
+CPP=cl.exe
+RSC=rc.exe
+
+!IF  "$(CFG)" == "Benchmark - Win32 Release"
+
+# PROP BASE Use_MFC 0
+# PROP BASE Use_Debug_Libraries 0
+# PROP BASE Output_Dir "Benchmark___Win32_Release"
+# PROP BASE Intermediate_Dir "Benchmark___Win32_Release"
+# PROP BASE Target_Dir ""
+# PROP Use_MFC 0
+# PROP Use_Debug_Libraries 0
+# PROP Output_Dir "BenchmarkRelease"
+# PROP Intermediate_Dir "BenchmarkRelease"
+# PROP Ignore_Export_Lib 0
+# PROP Target_Dir ""
+# ADD BASE CPP /nologo /G6 /MD /W3 /GX /O2 /I "C:\Libs\SDL-1.2.11\include" /I "C:\Libs\zlib-1.2.3" /D "NDEBUG" /D "PROFILE" /D "PPOOL_STATISTICS" /D "WIN32" /D "_CONSOLE" /D "_MBCS" /YX /FD /c
+# ADD CPP /nologo /G6 /MD /W3 /GX /O2 /I "C:\Libs\SDL-1.2.11\include" /I "C:\Libs\zlib-1.2.3" /D "NDEBUG" /D "PROFILE" /D "PPOOL_STATISTICS" /D "WIN32" /D "_CONSOLE" /D "_MBCS" /YX /FD /c
+# ADD BASE RSC /l 0x809 /d "NDEBUG"
+# ADD RSC /l 0x809 /d "NDEBUG"
+BSC32=bscmake.exe
+# ADD BASE BSC32 /nologo
+# ADD BSC32 /nologo
+LINK32=link.exe
+# ADD BASE LINK32 sdl.lib sdlmain.lib zlib.lib user32.lib advapi32.lib /nologo /subsystem:console /machine:I386 /libpath:"C:\Libs\zlib-1.2.3" /libpath:"C:\Libs\SDL-1.2.11\lib"
+# ADD LINK32 sdl.lib sdlmain.lib zlib.lib user32.lib advapi32.lib /nologo /subsystem:console /machine:I386 /libpath:"C:\Libs\zlib-1.2.3" /libpath:"C:\Libs\SDL-1.2.11\lib"
+
+!ELSEIF  "$(CFG)" == "Benchmark - Win32 Debug"
+
+# PROP BASE Use_MFC 0
+# PROP BASE Use_Debug_Libraries 0
+# PROP BASE Output_Dir "Benchmark___Win32_Debug"
+# PROP BASE Intermediate_Dir "Benchmark___Win32_Debug"
+# PROP BASE Target_Dir ""
+# PROP Use_MFC 0
+# PROP Use_Debug_Libraries 0
+# PROP Output_Dir "BenchmarkDebug"
+# PROP Intermediate_Dir "BenchmarkDebug"
+# PROP Ignore_Export_Lib 0
+# PROP Target_Dir ""
+# ADD BASE CPP /nologo /G6 /MD /W3 /GX /Zi /Od /I "C:\Libs\SDL-1.2.11\include" /I "C:\Libs\zlib-1.2.3" /D "NDEBUG" /D "PROFILE" /D "PPOOL_STATISTICS" /D "WIN32" /D "_CONSOLE" /D "_MBCS" /YX /FD /c
+# ADD CPP /nologo /G6 /MD /W3 /GX /Zi /Od /I "C:\Libs\SDL-1.2.11\include" /I "C:\Libs\zlib-1.2.3" /D "NDEBUG" /D "PROFILE" /D "PPOOL_STATISTICS" /D "WIN32" /D "_CONSOLE" /D "_MBCS" /YX /FD /c
+# ADD BASE RSC /l 0x809 /d "NDEBUG"
+# ADD RSC /l 0x809 /d "NDEBUG"
+BSC32=bscmake.exe
+# ADD BASE BSC32 /nologo
+# ADD BSC32 /nologo
+LINK32=link.exe
+# ADD BASE LINK32 sdl.lib sdlmain.lib zlib.lib user32.lib advapi32.lib /nologo /subsystem:console /debug /machine:I386 /libpath:"C:\Libs\zlib-1.2.3" /libpath:"C:\Libs\SDL-1.2.11\lib"
+# ADD LINK32 sdl.lib sdlmain.lib zlib.lib user32.lib advapi32.lib /nologo /subsystem:console /debug /machine:I386 /libpath:"C:\Libs\zlib-1.2.3" /libpath:"C:\Libs\SDL-1.2.11\lib"
+
+!ENDIF 
+
+# Begin Target
+
+# Name "Benchmark - Win32 Release"
+# Name "Benchmark - Win32 Debug"
+# Begin Group "Source Files"
+
+# PROP Default_Filter "cpp;c;cxx;rc;def;r;odl;idl;hpj;bat"
+# Begin Group "Plus 3"
+
+# PROP Default_Filter ""
+# Begin Source File
+
+SOURCE=.\src\Plus3\Drive\DriveADF.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Plus3\Drive\DriveBase.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Plus3\Drive\DriveFDI.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Plus3\Drive\fdi2raw\fdi2raw.c
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Plus3\Helper\Helper.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Plus3\Drive\Sector.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Plus3\wd1770.cpp
+# End Source File
+# End Group
+# Begin Group "Tape"
+
+# PROP Default_Filter ""
+# Begin Source File
+
+SOURCE=.\src\Tape\FastTape.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Tape\FeederCSW.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Tape\Feeders.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Tape\FeederUEF.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Tape\Tape.cpp
+# End Source File
+# End Group
+# Begin Group "Display"
+
+# PROP Default_Filter ""
+# Begin Source File
+
+SOURCE=.\src\Display.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\DisplayTables.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\DisplayUpdate.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Scaler.cpp
+# End Source File
+# End Group
+# Begin Group "HostMachine"
+
+# PROP Default_Filter ""
+# Begin Source File
+
+SOURCE=.\src\HostMachine\HeadlessHostMachine.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\HostMachine\HostMachine.cpp
+# End Source File
+# End Group
+# Begin Group "Configuration"
+
+# PROP Default_Filter ""
+# Begin Source File
+
+SOURCE=.\src\Configuration\Config.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Configuration\ConfigurationStore.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Configuration\ElectronConfiguration.cpp
+# End Source File
+# End Group
+# Begin Group "Plus 1"
+
+# PROP Default_Filter ""
+# Begin Source File
+
+SOURCE=.\src\Plus1\Plus1.cpp
+# End Source File
+# End Group
+# Begin Source File
+
+SOURCE=.\src\6502core.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\6502misc.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Benchmark.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\ComponentBase.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Keyboard.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\ProcessPool.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Rewind.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\StateWriter.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\UEFChunk.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\UEFMain.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\ULA.cpp
+# End Source File
+# End Group
+# End Target
+# End Project
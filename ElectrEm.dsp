@@ -163,6 +163,10 @@ SOURCE=.\src\DisplayTables.cpp
 
 SOURCE=.\src\DisplayUpdate.cpp
 # End Source File
+# Begin Source File
+
+SOURCE=.\src\Scaler.cpp
+# End Source File
 # End Group
 # Begin Group "GUI"
 
@@ -242,6 +246,14 @@ SOURCE=.\src\ProcessPool.cpp
 # End Source File
 # Begin Source File
 
+SOURCE=.\src\Rewind.cpp
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\StateWriter.cpp
+# End Source File
+# Begin Source File
+
 SOURCE=.\src\UEFChunk.cpp
 # End Source File
 # Begin Source File
@@ -282,10 +294,26 @@ SOURCE=.\SRC\BASIC.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\src\Fence.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\src\HostMachine\HostMachine.h
 # End Source File
 # Begin Source File
 
+SOURCE=.\src\Rewind.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\Scaler.h
+# End Source File
+# Begin Source File
+
+SOURCE=.\src\StateWriter.h
+# End Source File
+# Begin Source File
+
 SOURCE=.\src\GUI\Windows\PreferencesDialog.h
 # End Source File
 # Begin Source File
@@ -4,7 +4,6 @@
 #include "ProcessPool.h"
 #include "ComponentBase.h"
 #include "SDL.h"
-#include "SDL_thread.h"
 
 #define OneMhz_BUS	0
 #define TwoMhz_BUS	1
@@ -35,7 +34,7 @@ struct C6502State
 	BrokenWord pc;
 };
 
-#define C6502IOCTL_FINISHOPCODE		0x200
+#define C6502IOCTL_FINISHOPCODE		0x200	/* Parameter: Uint32 *, receives the cycles still owed */
 
 /*
 
@@ -45,6 +44,9 @@ struct C6502State
 #define Transpose6502Address8(addr)		(addr&~0xff) + (addr >> 2)
 #define Transpose6502Address32(addr)	addr + ((addr&~0xff) >> 2) + 64
 
+/* records a write to RAM page p (0-127) for the display's benefit */
+#define MarkDirtyPage(p)	DirtyPages[(p) >> 5] |= (Uint32)1 << ((p)&31)
+
 class C6502 : public CComponentBase
 {
 	public:
@@ -66,13 +68,32 @@ class C6502 : public CComponentBase
 			void SetReadPage32(int LocalAddr, int GlobalAddr, int Length);
 
 		void SetGathering(Uint16 *AddressSource, Uint32 *Target32);
+
+		/* gathering is performed lazily: FlushGathering brings it up to
+		the current cycle, and SetGatherWindow nominates the lowest RAM
+		address the display may currently read, so that writes below it
+		don't need to cause a flush */
+		void FlushGathering();
+		void SetGatherWindow(Uint16 LowAddr);
+
+		/* fills Mask with a bit for each of the RAM pages in the gather
+		window that have been written since the last call, then clears
+		the record. Used by the display to find lines that need redrawing */
+		void GetDirtyPages(Uint32 *Mask);
 		void SetMemoryView(int pos, int layout);
 
 		Uint32 GetCyclesExecuted();
+
+		/* the running cycle count passed as TimeStamp to trapped accesses */
+		Uint32 GetTotalCycles();
 		bool IOCtl(Uint32 Control, void *Parameter = NULL, Uint32 TimeStamp = 0);
 
 		void SetInstructionLimit(Uint32);
 
+		/* selects whether the 32bit shadow datapath used by multiplexed
+		display is maintained */
+		void SetMultiplexed(bool);
+
 		/* memory allocation and access */
 		bool SetMemoryTotal(int);
 		int GetStorage(int);
@@ -92,9 +113,11 @@ class C6502 : public CComponentBase
 		void Push(Uint8, Uint32 = 0);
 
 	private :
-		static int CPUThreadHelper(void *tptr);
-		int CPUThread();
+		void Run();
+		template <bool Wide> void RunCore();
+		bool WideCore;
 		volatile bool CPUDead;
+		bool JustWokeUp;
 
 		/* Register set */
 		Uint8 a8, x8, y8, s;
@@ -113,54 +136,47 @@ class C6502 : public CComponentBase
 			Uint8 *Read8Ptrs[256], *Write8Ptrs[256];
 			Uint32 *Read32Ptrs[256], *Write32Ptrs[256];
 			Uint32 **ExecCyclePtrs[256];
+
+			/* 1 + the RAM page written to, or 0 if not RAM */
+			Uint8 GatherPages[256];
 		};
 
+		/* see PPTrapFlags */
 		Uint32 *TrapFlags;
+		Uint16 *TrapPages;
 
 		MemoryLayout *CurrentView[8];
 		MemoryLayout *AllLayouts, *CurrentLayout;
 		int NumLayouts;
 
-		bool ZeroPageClear, StackPageClear;
-
 		/* Timing & Gathering */
 		Uint32 *GatherTarget, *GatherTargetStart;
 		Uint16 *GatherAddresses, *GatherAddressesStart;
+		Uint8 GatherLowPage;
+		Uint32 DirtyPages[4];
 
 		/* Allocated memory */
 		Uint32 *MemoryPool;
 		int AllocatedBytes;
 		int AllocTarget;
 
-		/* CPU thread & synchronisation */
-		SDL_sem *GoSemaphore, *StopSemaphore;
-		SDL_Thread *MainEx;
-		volatile bool Quit;
-
 		/*
 
-			cycle counting mechanisms - thread shared, so 'volatile'
-			In reality, these are cast back and forth from volatile
-			as and when necessary, in an optimal fashion
-
-			Compiler could not be expected to spot this optimisation,
-			as it depends on knowing in that volatility is necessary
-			only before and after interaction with semaphores, etc
+			cycle counting mechanisms - CyclesToRun is the deadline for
+			the current slice, SubCycleCount the progress towards it.
+			CycleDebt is time owed by an instruction that straddled the
+			previous deadline
 
 		*/
 		Uint32 CyclesToRun, TotalCycleCount, SubCycleCount, FrameCount;
-		Uint32 InstructionsToRun;
-
-		volatile Uint32 VolCyclesToRun, VolTotalCycleCount, VolSubCycleCount, VolFrameCount;
-		volatile Uint32 VolInstructionsToRun;
+		Uint32 InstructionsToRun, CycleDebt;
 
 		volatile bool IRQLine, RSTLine, NMILine, ForceRST;
 
 		/* a rare conversion from macro to function */
-		void Break();
-		void ILoopRun();
-		inline bool CycleDoneT(int CycleDownCount, MemoryLayout *CMem, bool &QuitEarly);
-		inline bool CycleDoneNotEarlyT(int CycleDownCount, MemoryLayout *CMem);
+		inline void CycleDoneT(Uint32 CycleDownCount, bool &QuitEarly);
+		inline void CycleDoneNotEarlyT(Uint32 CycleDownCount);
+		inline void AddCycleDebt(Uint16 Addr, MemoryLayout *CMem);
 };
 
 #endif
@@ -29,88 +29,132 @@
 
 #define EvaluateIRQ()		DoIRQ = IRQLine && !(Flags.Misc&FLAG_I)
 
-#define TrapAddr(v)			TrapFlags[(v) >> 5]&(1 << ((v)&31))
+/*
+
+	The bit test is only reached for pages that have at least one trapped
+	address in them - the &FC-&FE pages, plus whatever ROM hooks are
+	active - so that everything else goes straight to memory.
+
+*/
+#define TrapBit(v)			(TrapFlags[(v) >> 5]&(1 << ((v)&31)))
+#define TrapAddr(v)			(TrapPages[(v) >> 8] && TrapBit(v))
+#define TrapAddrBW(v)		(TrapPages[v.b.h] && TrapBit(v.a))
+#define TrapAddrZ(v)		(TrapPages[0] && TrapBit(v))
+
+#define ZeroPageClear		(!TrapPages[0])
+#define StackPageClear		(!TrapPages[1])
 
-#define LoadVolatiles()		CyclesToRun = VolCyclesToRun; TotalCycleCount = VolTotalCycleCount; SubCycleCount = VolSubCycleCount; FrameCount = VolFrameCount; InstructionsToRun = VolInstructionsToRun;
-#define StoreVolatiles()	VolCyclesToRun = CyclesToRun; VolTotalCycleCount = TotalCycleCount; VolSubCycleCount = SubCycleCount; VolFrameCount = FrameCount; VolInstructionsToRun = InstructionsToRun;
+/*
+
+	RunCore is instantiated twice - with Wide set it also carries the 32bit
+	shadow registers and memory needed for multiplexed display, otherwise
+	that half of the datapath compiles away. See C6502::SetMultiplexed.
+
+*/
+#define IfWide(s)			if(Wide) { s; }
+
+/*
+
+	Video gathering is lazy - the CPU just counts cycles, and the display
+	bytes are only copied up to 'now' when a write is about to land in a
+	page that the display may be reading. See C6502::FlushGathering. Such
+	writes are also noted so that the display knows what may have changed.
+
+*/
+#define GatherCheck(page)\
+	if(CMem->GatherPages[page] > GatherLowPage)\
+	{\
+		FlushGathering();\
+		MarkDirtyPage(CMem->GatherPages[page]-1);\
+	}
+
+/*
+
+	Trapped accesses are timestamped with the cycle they really happen on.
+	Once an instruction has run past the deadline TotalCycleCount stops at
+	it and the rest of the instruction's time goes into CycleDebt, so that
+	has to be added on for the devices to catch up to the right moment
+
+*/
+#define AccessTime	(TotalCycleCount + CycleDebt)
 
 #define ReadMem8(addr, val)				val = CMem->Read8Ptrs[(addr) >> 8][(addr)&0xff]
-#define ReadMem32(addr, val8, val32)	val8 = CMem->Read8Ptrs[(addr) >> 8][(addr)&0xff]; val32 = CMem->Read32Ptrs[(addr) >> 8][(addr)&0xff]
-#define WriteMem8(addr, val)			CMem->Write8Ptrs[(addr) >> 8][(addr)&0xff] = val
-#define WriteMem32(addr, val8, val32)	CMem->Write8Ptrs[(addr) >> 8][(addr)&0xff] = val8; CMem->Read32Ptrs[(addr) >> 8][(addr)&0xff] = val32
+#define ReadMem32(addr, val8, val32)	val8 = CMem->Read8Ptrs[(addr) >> 8][(addr)&0xff]; IfWide(val32 = CMem->Read32Ptrs[(addr) >> 8][(addr)&0xff])
+#define WriteMem8(addr, val)			GatherCheck((addr) >> 8); CMem->Write8Ptrs[(addr) >> 8][(addr)&0xff] = val
+#define WriteMem32(addr, val8, val32)	GatherCheck((addr) >> 8); CMem->Write8Ptrs[(addr) >> 8][(addr)&0xff] = val8; IfWide(CMem->Read32Ptrs[(addr) >> 8][(addr)&0xff] = val32)
 
-#define Read8(addr, val)				if(TrapAddr(addr)) QuitEarly = PPPtr->Read(addr, TotalCycleCount, val, TempWord); else ReadMem8(addr, val)
-#define Read32(addr, val8, val32)		if(TrapAddr(addr)) QuitEarly = PPPtr->Read(addr, TotalCycleCount, val8, val32); else {ReadMem32(addr, val8, val32);}
-#define Write8(addr, val)				if(TrapAddr(addr)) QuitEarly = PPPtr->Write(addr, TotalCycleCount, val, TempWord); else WriteMem8(addr, val)
-#define Write32(addr, val8, val32)		if(TrapAddr(addr)) QuitEarly = PPPtr->Write(addr, TotalCycleCount, val8, val32); else {WriteMem32(addr, val8, val32);}
+#define Read8(addr, val)				if(TrapAddr(addr)) QuitEarly = PPPtr->Read(addr, AccessTime, val, TempWord); else ReadMem8(addr, val)
+#define Read32(addr, val8, val32)		if(TrapAddr(addr)) QuitEarly = PPPtr->Read(addr, AccessTime, val8, val32); else {ReadMem32(addr, val8, val32);}
+#define Write8(addr, val)				if(TrapAddr(addr)) QuitEarly = PPPtr->Write(addr, AccessTime, val, TempWord); else {WriteMem8(addr, val);}
+#define Write32(addr, val8, val32)		if(TrapAddr(addr)) QuitEarly = PPPtr->Write(addr, AccessTime, val8, val32); else {WriteMem32(addr, val8, val32);}
 
 #define ReadMem8BW(addr, val)			val = CMem->Read8Ptrs[addr.b.h][addr.b.l]
-#define ReadMem32BW(addr, val8, val32)	val8 = CMem->Read8Ptrs[addr.b.h][addr.b.l]; val32 = CMem->Read32Ptrs[addr.b.h][addr.b.l]
-#define WriteMem8BW(addr, val)			CMem->Write8Ptrs[addr.b.h][addr.b.l] = val
-#define WriteMem32BW(addr, val8, val32)	CMem->Write8Ptrs[addr.b.h][addr.b.l] = val8; CMem->Read32Ptrs[addr.b.h][addr.b.l] = val32
+#define ReadMem32BW(addr, val8, val32)	val8 = CMem->Read8Ptrs[addr.b.h][addr.b.l]; IfWide(val32 = CMem->Read32Ptrs[addr.b.h][addr.b.l])
+#define WriteMem8BW(addr, val)			GatherCheck(addr.b.h); CMem->Write8Ptrs[addr.b.h][addr.b.l] = val
+#define WriteMem32BW(addr, val8, val32)	GatherCheck(addr.b.h); CMem->Write8Ptrs[addr.b.h][addr.b.l] = val8; IfWide(CMem->Read32Ptrs[addr.b.h][addr.b.l] = val32)
 
-#define Read8BW(addr, val)				if(TrapAddr(addr.a)) QuitEarly = PPPtr->Read(addr.a, TotalCycleCount, val, TempWord); else ReadMem8BW(addr, val)
-#define Read32BW(addr, val8, val32)		if(TrapAddr(addr.a)) QuitEarly = PPPtr->Read(addr.a, TotalCycleCount, val8, val32); else {ReadMem32BW(addr, val8, val32);}
-#define Write8BW(addr, val)				if(TrapAddr(addr.a)) QuitEarly = PPPtr->Write(addr.a, TotalCycleCount, val, TempWord); else WriteMem8BW(addr, val)
-#define Write32BW(addr, val8, val32)	if(TrapAddr(addr.a)) QuitEarly = PPPtr->Write(addr.a, TotalCycleCount, val8, val32); else {WriteMem32BW(addr, val8, val32);}
+#define Read8BW(addr, val)				if(TrapAddrBW(addr)) QuitEarly = PPPtr->Read(addr.a, AccessTime, val, TempWord); else ReadMem8BW(addr, val)
+#define Read32BW(addr, val8, val32)		if(TrapAddrBW(addr)) QuitEarly = PPPtr->Read(addr.a, AccessTime, val8, val32); else {ReadMem32BW(addr, val8, val32);}
+#define Write8BW(addr, val)				if(TrapAddrBW(addr)) QuitEarly = PPPtr->Write(addr.a, AccessTime, val, TempWord); else {WriteMem8BW(addr, val);}
+#define Write32BW(addr, val8, val32)	if(TrapAddrBW(addr)) QuitEarly = PPPtr->Write(addr.a, AccessTime, val8, val32); else {WriteMem32BW(addr, val8, val32);}
 
 #define ReadMem8Z(addrl, val)			val = CMem->Read8Ptrs[0][addrl]
-#define ReadMem32Z(addrl, val8, val32)	val8 = CMem->Read8Ptrs[0][addrl]; val32 = CMem->Read32Ptrs[0][addrl]
-#define WriteMem8Z(addrl, val)			CMem->Write8Ptrs[0][addrl] = val
-#define WriteMem32Z(addrl, val8, val32)	CMem->Write8Ptrs[0][addrl] = val8; CMem->Read32Ptrs[0][addrl] = val32
+#define ReadMem32Z(addrl, val8, val32)	val8 = CMem->Read8Ptrs[0][addrl]; IfWide(val32 = CMem->Read32Ptrs[0][addrl])
+#define WriteMem8Z(addrl, val)			GatherCheck(0); CMem->Write8Ptrs[0][addrl] = val
+#define WriteMem32Z(addrl, val8, val32)	GatherCheck(0); CMem->Write8Ptrs[0][addrl] = val8; IfWide(CMem->Read32Ptrs[0][addrl] = val32)
 
-#define Read8Z(addrl, val)				if(TrapAddr(addrl)) QuitEarly = PPPtr->Read(addrl, TotalCycleCount, val, TempWord); else ReadMem8Z(addrl, val)
-#define Read32Z(addrl, val8, val32)		if(TrapAddr(addrl)) QuitEarly = PPPtr->Read(addrl, TotalCycleCount, val8, val32); else {ReadMem32Z(addrl, val8, val32);}
-#define Write8Z(addrl, val)				if(TrapAddr(addrl)) QuitEarly = PPPtr->Write(addrl, TotalCycleCount, val, TempWord); else WriteMem8Z(addrl, val)
-#define Write32Z(addrl, val8, val32)	if(TrapAddr(addrl)) QuitEarly = PPPtr->Write(addrl, TotalCycleCount, val8, val32); else {WriteMem32Z(addrl, val8, val32);}
+#define Read8Z(addrl, val)				if(TrapAddrZ(addrl)) QuitEarly = PPPtr->Read(addrl, AccessTime, val, TempWord); else ReadMem8Z(addrl, val)
+#define Read32Z(addrl, val8, val32)		if(TrapAddrZ(addrl)) QuitEarly = PPPtr->Read(addrl, AccessTime, val8, val32); else {ReadMem32Z(addrl, val8, val32);}
+#define Write8Z(addrl, val)				if(TrapAddrZ(addrl)) QuitEarly = PPPtr->Write(addrl, AccessTime, val, TempWord); else {WriteMem8Z(addrl, val);}
+#define Write32Z(addrl, val8, val32)	if(TrapAddrZ(addrl)) QuitEarly = PPPtr->Write(addrl, AccessTime, val8, val32); else {WriteMem32Z(addrl, val8, val32);}
 
 #define Modify(addr, op, val8, val32)\
 	if(TrapAddr(addr))\
 	{\
-		QuitEarly = PPPtr->Read(addr, TotalCycleCount, val8, val32); CycleDone(addr);\
-		QuitEarly = PPPtr->Write(addr, TotalCycleCount, val8, val32); op; CycleDone(addr);\
+		QuitEarly = PPPtr->Read(addr, AccessTime, val8, val32); CycleDone(addr);\
+		QuitEarly = PPPtr->Write(addr, AccessTime, val8, val32); op; CycleDone(addr);\
 		EvaluateIRQ();\
-		QuitEarly = PPPtr->Write(addr, TotalCycleCount, val8, val32); CycleDone(addr);\
+		QuitEarly = PPPtr->Write(addr, AccessTime, val8, val32); CycleDone(addr);\
 	}\
 	else\
 	{\
-		val8 = CMem->Read8Ptrs[(addr) >> 8][(addr)&0xff]; val32 = CMem->Read32Ptrs[(addr) >> 8][(addr)&0xff];\
+		val8 = CMem->Read8Ptrs[(addr) >> 8][(addr)&0xff]; IfWide(val32 = CMem->Read32Ptrs[(addr) >> 8][(addr)&0xff]);\
 		op; CycleDoneNotEarly(addr); CycleDoneNotEarly(addr);\
-		CMem->Write8Ptrs[(addr) >> 8][(addr)&0xff] = val8; CMem->Write32Ptrs[(addr) >> 8][(addr)&0xff] = val32;\
+		GatherCheck((addr) >> 8); CMem->Write8Ptrs[(addr) >> 8][(addr)&0xff] = val8; IfWide(CMem->Write32Ptrs[(addr) >> 8][(addr)&0xff] = val32);\
 		EvaluateIRQ();\
 		CycleDoneNotEarly(addr);\
 	}
 
 #define ModifyBW(addr, op, val8, val32)\
-	if(TrapAddr(addr.a))\
+	if(TrapAddrBW(addr))\
 	{\
-		QuitEarly = PPPtr->Read(addr.a, TotalCycleCount, val8, val32); CycleDone(addr.a);\
-		QuitEarly = PPPtr->Write(addr.a, TotalCycleCount, val8, val32); op; CycleDone(addr.a);\
+		QuitEarly = PPPtr->Read(addr.a, AccessTime, val8, val32); CycleDone(addr.a);\
+		QuitEarly = PPPtr->Write(addr.a, AccessTime, val8, val32); op; CycleDone(addr.a);\
 		EvaluateIRQ();\
-		QuitEarly = PPPtr->Write(addr.a, TotalCycleCount, val8, val32); CycleDone(addr.a);\
+		QuitEarly = PPPtr->Write(addr.a, AccessTime, val8, val32); CycleDone(addr.a);\
 	}\
 	else\
 	{\
-		val8 = CMem->Read8Ptrs[addr.b.h][addr.b.l]; val32 = CMem->Read32Ptrs[addr.b.h][addr.b.l];\
+		val8 = CMem->Read8Ptrs[addr.b.h][addr.b.l]; IfWide(val32 = CMem->Read32Ptrs[addr.b.h][addr.b.l]);\
 		op; CycleDoneNotEarly(addr.a); CycleDoneNotEarly(addr.a);\
-		CMem->Write8Ptrs[addr.b.h][addr.b.l] = val8; CMem->Write32Ptrs[addr.b.h][addr.b.l] = val32;\
+		GatherCheck(addr.b.h); CMem->Write8Ptrs[addr.b.h][addr.b.l] = val8; IfWide(CMem->Write32Ptrs[addr.b.h][addr.b.l] = val32);\
 		EvaluateIRQ();\
 		CycleDoneNotEarly(addr.a);\
 	}
 
 #define ModifyZ(addr, op, val8, val32)\
-	if(TrapAddr(addr))\
+	if(TrapAddrZ(addr))\
 	{\
-		QuitEarly = PPPtr->Read(addr, TotalCycleCount, val8, val32); CycleDone(0);\
-		QuitEarly = PPPtr->Write(addr, TotalCycleCount, val8, val32); op; CycleDone(0);\
+		QuitEarly = PPPtr->Read(addr, AccessTime, val8, val32); CycleDone(0);\
+		QuitEarly = PPPtr->Write(addr, AccessTime, val8, val32); op; CycleDone(0);\
 		EvaluateIRQ();\
-		QuitEarly = PPPtr->Write(addr, TotalCycleCount, val8, val32); CycleDone(0);\
+		QuitEarly = PPPtr->Write(addr, AccessTime, val8, val32); CycleDone(0);\
 	}\
 	else\
 	{\
-		val8 = CMem->Read8Ptrs[0][addr]; val32 = CMem->Read32Ptrs[0][addr];\
+		val8 = CMem->Read8Ptrs[0][addr]; IfWide(val32 = CMem->Read32Ptrs[0][addr]);\
 		op; CycleDoneNotEarly(0); CycleDoneNotEarly(0);\
-		CMem->Write8Ptrs[0][addr] = val8; CMem->Write32Ptrs[0][addr] = val32;\
+		GatherCheck(0); CMem->Write8Ptrs[0][addr] = val8; IfWide(CMem->Write32Ptrs[0][addr] = val32);\
 		EvaluateIRQ();\
 		CycleDoneNotEarly(addr);\
 	}
@@ -246,12 +290,11 @@
 
 /* ARR is weirdo */
 #define ARRBinary()\
-	a8 &= NextByte; a32 &= NextWord;\
+	a8 &= NextByte;\
 	a8 = (a8 >> 1) | (RD_CARRY() << 7);\
 	LD_NEGZERO(a8);\
 	LD_CARRY((a8 >> 6)&1);\
-	a32 = (a32 >> 4) | (RD_CARRY_WD() << 7);\
-	LD_CARRY_WD((a32 >> 24)&0xf);\
+	IfWide(a32 &= NextWord; a32 = (a32 >> 4) | (RD_CARRY_WD() << 7); LD_CARRY_WD((a32 >> 24)&0xf));\
 	LD_OVERFLOW((a8 << 2) ^ (a8 << 1))
 
 #define ARRDecimal()\
@@ -291,8 +334,7 @@
 	a8 &= NextByte;\
 	LD_NEGZERO(a8);\
 	LD_CARRY(a8 >> 7);\
-	a32 &= NextWord;\
-	LD_CARRY_WD(a32 >> 28)
+	IfWide(a32 &= NextWord; LD_CARRY_WD(a32 >> 28))
 
 #define ALR()\
 	AND();\
@@ -303,17 +345,17 @@
 #define DCP()	DEC(NextByte); CP(a8, NextByte)
 
 #define AND()\
-	a32 &= NextWord;\
+	IfWide(a32 &= NextWord);\
 	a8 &= NextByte;\
 	LD_NEGZERO(a8)
 
 #define ORA()\
-	a32 |= NextWord;\
+	IfWide(a32 |= NextWord);\
 	a8 |= NextByte;\
 	LD_NEGZERO(a8)
 
 #define EOR()\
-	a32 ^= NextWord;\
+	IfWide(a32 ^= NextWord);\
 	a8 ^= NextByte;\
 	LD_NEGZERO(a8)
 
@@ -321,60 +363,48 @@
 	LD_CARRY(v&1);\
 	v >>= 1;\
 	LD_NEGZERO(v);\
-	LD_CARRY_WD(vb&15);\
-	vb >>= 4
+	IfWide(LD_CARRY_WD(vb&15); vb >>= 4)
 
 #define ASL(v, vb)	\
 	LD_CARRY(v>>7);\
 	v <<= 1;\
 	LD_NEGZERO(v);\
-	LD_CARRY_WD(vb>>28);\
-	vb <<= 4
+	IfWide(LD_CARRY_WD(vb>>28); vb <<= 4)
 
 #define ROR(v, vb)	\
 	temp8 = (v >> 1) | (RD_CARRY() << 7);\
 	LD_CARRY(v&1);\
 	v = temp8;\
 	LD_NEGZERO(v);\
-	temp32 = (vb >> 4) | (RD_CARRY_WD() << 28);\
-	LD_CARRY_WD(vb&15);\
-	vb = temp32
+	IfWide(temp32 = (vb >> 4) | (RD_CARRY_WD() << 28); LD_CARRY_WD(vb&15); vb = temp32)
 
 #define ROL(v, vb)	\
 	temp16.a = (v << 1) | RD_CARRY();\
 	LD_CARRY(temp16.b.h);\
 	v = temp16.b.l;\
 	LD_NEGZERO(v);\
-	temp32 = (vb << 4) | RD_CARRY_WD();\
-	LD_CARRY_WD(vb >> 28);\
-	vb = temp32
+	IfWide(temp32 = (vb << 4) | RD_CARRY_WD(); LD_CARRY_WD(vb >> 28); vb = temp32)
 
 #define SLO()\
 	LD_CARRY(NextByte>>7);\
 	NextByte <<= 1;\
 	a8 |= NextByte;\
 	LD_NEGZERO(a8);\
-	LD_CARRY_WD(NextWord>>28);\
-	NextWord <<= 4;\
-	a32 |= NextWord
+	IfWide(LD_CARRY_WD(NextWord>>28); NextWord <<= 4; a32 |= NextWord)
 
 #define RLA()\
 	temp8 = (NextByte << 1) | RD_CARRY();\
 	LD_CARRY(NextByte >> 7);\
 	a8 &= (NextByte = temp8);\
 	LD_NEGZERO(a8);\
-	temp32 = (NextWord << 4) | RD_CARRY_WD();\
-	LD_CARRY_WD(temp32&15);\
-	a32 &= (NextWord = temp32)
+	IfWide(temp32 = (NextWord << 4) | RD_CARRY_WD(); LD_CARRY_WD(temp32&15); a32 &= (NextWord = temp32))
 
 #define SRE()\
 	LD_CARRY(NextByte&1);\
 	NextByte >>= 1;\
 	a8 ^= NextByte;\
 	LD_NEGZERO(a8);\
-	LD_CARRY_WD(a32&15);\
-	NextWord >>= 4;\
-	a32 ^= NextWord
+	IfWide(LD_CARRY_WD(a32&15); NextWord >>= 4; a32 ^= NextWord)
 
 #define CP(r, v)	\
 	temp16.a = r - v;\
@@ -388,79 +418,74 @@
 
 #define LD(v8, v32)\
 	v8 = NextByte;\
-	v32 = NextWord;\
+	IfWide(v32 = NextWord);\
 	LD_NEGZERO(v8)
 
 #define ST(v8, v32) Write32BW(Addr, v8, v32)
 #define STZ(v8, v32) Write32Z(Addr.a, v8, v32)
 
-#define Break()\
-		StoreVolatiles();\
-		SDL_SemPost(StopSemaphore);\
-		SDL_SemWait(GoSemaphore);\
-		LoadVolatiles();
-
-#define ILoopRun()\
-	{\
-		Uint32 Period = CyclesToRun - SubCycleCount;\
-\
-		SubCycleCount += Period;\
-		TotalCycleCount += Period;\
-		FrameCount += Period;\
-		CycleDownCount -= Period;\
-\
-		while(Period--)\
-			*GatherTarget++ = MemoryPool[*GatherAddresses++];\
-\
-		StoreVolatiles();\
-		SDL_SemPost(StopSemaphore);\
-		SDL_SemWait(GoSemaphore);\
-		LoadVolatiles();\
-	}
-
 #define RunPeriod(n)\
 		SubCycleCount += n;\
 		TotalCycleCount += n;\
-		FrameCount += n;\
-		while(n--)\
-			*GatherTarget++ = MemoryPool[*GatherAddresses++]
+		FrameCount += n
 
 #define CycleDownCount(addr) CMem->ExecCyclePtrs[addr >> 8][FrameCount >> BUS_SHIFT][FrameCount&BUS_MASK]
 
-inline bool C6502::CycleDoneT(int CycleDownCount, MemoryLayout *CMem, bool &QuitEarly)
+/*
+
+	Run executes whole instructions until CyclesToRun have passed. If the
+	deadline falls part way through an instruction then the instruction is
+	completed anyway and the cycles beyond the deadline are kept in
+	CycleDebt, to be paid off at the start of the next slice. So the rest
+	of the machine always sees exactly the number of cycles it asked for.
+
+*/
+inline void C6502::CycleDoneT(Uint32 CycleDownCount, bool &QuitEarly)
 {
 	if(QuitEarly)
 	{
-		CycleDownCount--; 
-		SubCycleCount ++;
-		TotalCycleCount ++;
-		FrameCount ++;
-		*GatherTarget++ = MemoryPool[*GatherAddresses++];
-		Break(); if(Quit) return true;
+		/* a device wants the slice to end now - finish this cycle, owe the rest */
+		Uint32 Period = 1;
 		QuitEarly = false;
+		RunPeriod(Period);
+		CyclesToRun = SubCycleCount;
+		CycleDebt += CycleDownCount-1;
+		return;
 	}
-	while((CycleDownCount+SubCycleCount) >= CyclesToRun)
-	{
-		ILoopRun();
-		if(Quit) return true;
-	}
-	RunPeriod(CycleDownCount);
-	return false;
+	CycleDoneNotEarlyT(CycleDownCount);
 }
 
-inline bool C6502::CycleDoneNotEarlyT(int CycleDownCount, MemoryLayout *CMem)
+inline void C6502::CycleDoneNotEarlyT(Uint32 CycleDownCount)
 {
-	while((CycleDownCount+SubCycleCount) >= CyclesToRun)
+	if((CycleDownCount+SubCycleCount) < CyclesToRun)
 	{
-		ILoopRun();
-		if(Quit) return true;
+		RunPeriod(CycleDownCount);
+		return;
 	}
-	RunPeriod(CycleDownCount);
-	return false;
+
+	Uint32 Period = CyclesToRun - SubCycleCount;
+	CycleDownCount -= Period;
+	RunPeriod(Period);
+	CycleDebt += CycleDownCount;
 }
 
-#define CycleDone(v) if(CycleDoneT(CycleDownCount(v), CMem, QuitEarly)) return 0
-#define CycleDoneNotEarly(v) if(CycleDoneNotEarlyT(CycleDownCount(v), CMem)) return 0
+/* once the deadline has passed, FrameCount may sit at the very end of the field, so wrap it */
+inline void C6502::AddCycleDebt(Uint16 Addr, MemoryLayout *CMem)
+{
+	Uint32 BusTime = (FrameCount + CycleDebt) % BUS_REPEAT;
+	CycleDebt += CMem->ExecCyclePtrs[Addr >> 8][BusTime >> BUS_SHIFT][BusTime&BUS_MASK];
+}
+
+#define CycleDone(v)\
+	{\
+		if(SubCycleCount < CyclesToRun) CycleDoneT(CycleDownCount(v), QuitEarly);\
+		else { QuitEarly = false; AddCycleDebt(v, CMem); }\
+	}
+#define CycleDoneNotEarly(v)\
+	{\
+		if(SubCycleCount < CyclesToRun) CycleDoneNotEarlyT(CycleDownCount(v));\
+		else AddCycleDebt(v, CMem);\
+	}
 
 /*
 
@@ -547,16 +572,66 @@ inline bool C6502::CycleDoneNotEarlyT(int CycleDownCount, MemoryLayout *CMem)
 
 */
 
+/*
+
+	Opcode dispatch. Where the compiler supports taking the address of a
+	label (GCC and anything pretending to be GCC) each opcode is reached
+	through a 256 entry table of labels, which avoids the range check and
+	gives the branch predictor a better go than a switch does. Define
+	CPU_NOGOTO to use a plain switch regardless.
+
+	All 256 opcodes must be listed exactly once, via Opcode(0xnn) using
+	lower case hex.
+
+	Only the dispatch is table driven. Handlers are still written out from
+	the addressing mode macros rather than generated from mode and
+	operation templates, and every access still tests TrapPages/TrapFlags
+	and looks its timing up in ExecCyclePtrs. Both depend on the address
+	and, for timing, on where in the field the access falls, and a paging
+	write can change them between any two cycles, so neither can be
+	resolved once per handler.
+
+*/
+#if defined(__GNUC__) && !defined(CPU_NOGOTO)
+#define CPU_COMPUTEDGOTO
+#endif
+
+#ifdef CPU_COMPUTEDGOTO
+#define DispatchOpcode(i)	goto *OpcodeTable[i];
+#define Opcode(n)			Op_##n:
+#define EndOpcode			goto OpcodeDone
+
+#define OpcodeRow(r)\
+	&&Op_0x##r##0, &&Op_0x##r##1, &&Op_0x##r##2, &&Op_0x##r##3,\
+	&&Op_0x##r##4, &&Op_0x##r##5, &&Op_0x##r##6, &&Op_0x##r##7,\
+	&&Op_0x##r##8, &&Op_0x##r##9, &&Op_0x##r##a, &&Op_0x##r##b,\
+	&&Op_0x##r##c, &&Op_0x##r##d, &&Op_0x##r##e, &&Op_0x##r##f
+#else
+#define DispatchOpcode(i)	switch(i)
+#define Opcode(n)			case n:
+#define EndOpcode			break
+#endif
+
 /* MSVC 6 build problems [displeasing] workaround */
 #ifdef CPU_NOOPT
 #pragma optimize( "", off ) 
 #endif
-int C6502::CPUThread()
+template <bool Wide> void C6502::RunCore()
 {
+#ifdef CPU_COMPUTEDGOTO
+	static void *const OpcodeTable[256] =
+	{
+		OpcodeRow(0), OpcodeRow(1), OpcodeRow(2), OpcodeRow(3),
+		OpcodeRow(4), OpcodeRow(5), OpcodeRow(6), OpcodeRow(7),
+		OpcodeRow(8), OpcodeRow(9), OpcodeRow(a), OpcodeRow(b),
+		OpcodeRow(c), OpcodeRow(d), OpcodeRow(e), OpcodeRow(f)
+	};
+#endif
+
 	Uint32 NextWord, TempWord;
 	BrokenWord Addr;
 	MemoryLayout *CMem;
-	bool QuitEarly = false, DoIRQ, JustWokeUp = false;
+	bool QuitEarly = false, DoIRQ;
 	Uint8 Instr =0 , NextByte;
 
 	/* these used to be declared locally for any opcodes that use them,
@@ -567,23 +642,29 @@ int C6502::CPUThread()
 	BrokenWord temp16, TempAddr;
 	Uint32 temp32;
 
-	/* wait to be told to go for the first time */
-	SDL_SemWait(GoSemaphore);
-	LoadVolatiles();
+	/* pay off whatever the last instruction of the previous slice still owes */
+	if(CycleDebt)
+	{
+		Uint32 Period = CyclesToRun - SubCycleCount;
+		if(Period > CycleDebt) Period = CycleDebt;
+		CycleDebt -= Period;
+		RunPeriod(Period);
+	}
 
-	while(1)
+	while(SubCycleCount < CyclesToRun)
 	{
-		while(CPUDead)
+		if(CPUDead)
 		{
-			Break();
 			JustWokeUp = true;
+			break;
 		}
 	
 		if(InstructionsToRun)
 		{
 			if(! --InstructionsToRun)
 			{
-				Break();
+				CyclesToRun = SubCycleCount;
+				break;
 			}
 		}
 
@@ -617,21 +698,11 @@ int C6502::CPUThread()
 		EvaluateIRQ();
 
 		/* perform operation */
-		switch(Instr)
+		DispatchOpcode(Instr)
 		{
-			default:
-				if(!JustWokeUp)
-				{
-					PPPtr->Message(PPM_UNKNOWNOP, (void *)Instr);
-					CPUDead = true; //halt
-				}
-				JustWokeUp = false;
-				pc.a--;
-			break;
-
-			case 0x02: case 0x12: case 0x22: case 0x32:
-			case 0x42: case 0x52: case 0x62: case 0x72:
-			case 0x92: case 0xb2: case 0xd2: case 0xf2:
+			Opcode(0x02) Opcode(0x12) Opcode(0x22) Opcode(0x32)
+			Opcode(0x42) Opcode(0x52) Opcode(0x62) Opcode(0x72)
+			Opcode(0x92) Opcode(0xb2) Opcode(0xd2) Opcode(0xf2)
 				if(!JustWokeUp)
 				{
 					PPPtr->Message(PPM_CPUDIED, NULL);
@@ -639,10 +710,10 @@ int C6502::CPUThread()
 				}
 				JustWokeUp = false;
 				pc.a--;
-			break;
+			EndOpcode;
 
 			/* BRK */
-			case 0x00:
+			Opcode(0x00)
 				pc.a++;
 				if(StackPageClear)
 				{
@@ -660,10 +731,10 @@ int C6502::CPUThread()
 				Read8(0xfffe, pc.b.l); CycleDone(0xfffe);
 				EvaluateIRQ();
 				Read8(0xffff, pc.b.h); CycleDone(0xffff);
-			break;
+			EndOpcode;
 
 			/* RTI */
-			case 0x40:
+			Opcode(0x40)
 				s++; CycleDone(0x0100);
 
 				if(StackPageClear)
@@ -680,10 +751,10 @@ int C6502::CPUThread()
 					EvaluateIRQ();
 					Pull8n(pc.b.h); CycleDone(0x0100);
 				}
-			break;
+			EndOpcode;
 
 			/* RTS */
-			case 0x60:
+			Opcode(0x60)
 				s++; CycleDone(0x0100);
 				if(StackPageClear)
 				{
@@ -697,31 +768,31 @@ int C6502::CPUThread()
 				}
 				EvaluateIRQ();
 				CycleDone(pc.a); pc.a++;
-			break;
+			EndOpcode;
 
 			/* PHA, PHP */
-			case 0x48: //PHA
+			Opcode(0x48) //PHA
 				Push32(a8, a32); CycleDone(0x0100);
-			break;
+			EndOpcode;
 
-			case 0x08: //PHP
+			Opcode(0x08) //PHP
 				Push32(RD_STATUS8(), RD_STATUS32()); CycleDone(0x0100);
-			break;
+			EndOpcode;
 
 			/* PLA, PLP */
-			case 0x28: //PLP
+			Opcode(0x28) //PLP
 				s++; CycleDone(0x0100);
 				Pull32n(NextByte, NextWord); SET_STATUS32(NextByte, NextWord); SetPLoadFlags(); CycleDone(0x0100);
-			break;
+			EndOpcode;
 
-			case 0x68: //PLA
+			Opcode(0x68) //PLA
 				s++; CycleDone(0x0100);
 				Pull32n(a8, a32) 
 				LD_NEGZERO(a8); CycleDone(0x0100);
-			break;
+			EndOpcode;
 
 			/* JSR */
-			case 0x20: //JSR
+			Opcode(0x20) //JSR
 				pc.a++;
 
 				CycleDone(0x0100);	// unknown internal operation
@@ -738,7 +809,7 @@ int C6502::CPUThread()
 
 				EvaluateIRQ();
 				Read8BW(pc, Addr.b.h); CycleDone(pc.a); pc.b.h = Addr.b.h; pc.b.l = NextByte;
-			break;
+			EndOpcode;
 
 			/* relative addressing */
 #define ConditionalBranch(v)\
@@ -760,51 +831,51 @@ int C6502::CPUThread()
 			pc.a = NewAddr.a;\
 		}
 
-			case 0x10: ConditionalBranch(!RD_NEG());		break; //BPL
-			case 0x30: ConditionalBranch(RD_NEG());			break; //BMI
-			case 0x50: ConditionalBranch(!RD_OVERFLOW());	break; //BVC
-			case 0x70: ConditionalBranch(RD_OVERFLOW());	break; //BVS
-			case 0x90: ConditionalBranch(!RD_CARRY());		break; //BCC
-			case 0xb0: ConditionalBranch(RD_CARRY());		break; //BCS
-			case 0xd0: ConditionalBranch(RD_ZERO());		break; //BNE [recall: zero flag is inverted]
-			case 0xf0: ConditionalBranch(!RD_ZERO());		break; //BEQ
+			Opcode(0x10) ConditionalBranch(!RD_NEG());		EndOpcode; //BPL
+			Opcode(0x30) ConditionalBranch(RD_NEG());			EndOpcode; //BMI
+			Opcode(0x50) ConditionalBranch(!RD_OVERFLOW());	EndOpcode; //BVC
+			Opcode(0x70) ConditionalBranch(RD_OVERFLOW());	EndOpcode; //BVS
+			Opcode(0x90) ConditionalBranch(!RD_CARRY());		EndOpcode; //BCC
+			Opcode(0xb0) ConditionalBranch(RD_CARRY());		EndOpcode; //BCS
+			Opcode(0xd0) ConditionalBranch(RD_ZERO());		EndOpcode; //BNE [recall: zero flag is inverted]
+			Opcode(0xf0) ConditionalBranch(!RD_ZERO());		EndOpcode; //BEQ
 
 #undef ConditionalBranch
 
 			/* accumulator or implied addressing */
-			case 0x18: LD_CARRY(0);							break; //CLC
-			case 0x38: LD_CARRY(1);							break; //SEC
-			case 0x58: Flags.Misc &= ~FLAG_I;				break; //CLI
-			case 0x78: Flags.Misc |= FLAG_I;				break; //SEI
-			case 0xb8: LD_OVERFLOW(0);						break; //CLV
-			case 0xd8: Flags.Misc &= ~FLAG_D;				break; //CLD
-			case 0xf8: Flags.Misc |= FLAG_D;				break; //SED
-
-			case 0x9a: s = x8;								break; //TXS
-			case 0xba: x8 = s; LD_NEGZERO(x8);				break; //TSX
-			case 0x98: a8 = y8; LD_NEGZERO(a8); a32 = y32;	break; //TYA
-			case 0x8a: a8 = x8; LD_NEGZERO(a8); a32 = x32;	break; //TXA
-			case 0xa8: y8 = a8; LD_NEGZERO(y8); y32 = a32;	break; //TAY
-			case 0xaa: x8 = a8; LD_NEGZERO(x8); x32 = a32;	break; //TAX
-
-			case 0xe8: INC(x8);								break; //INX
-			case 0xc8: INC(y8);								break; //INY
-
-			case 0x88: DEC(y8);								break; //DEY
-			case 0xca: DEC(x8);								break; //DEX
-
-			case 0x0a: ASL(a8, a32);						break; //ASL A
-			case 0x2a: ROL(a8, a32);						break; //ROL A
-			case 0x4a: LSR(a8, a32);						break; //LSR A
-			case 0x6a: ROR(a8, a32);						break; //ROR A
-
-			case 0x1a:
-			case 0x3a:
-			case 0x5a:
-			case 0x7a:
-			case 0xda:
-			case 0xea:
-			case 0xfa: NOP();								break;
+			Opcode(0x18) LD_CARRY(0);							EndOpcode; //CLC
+			Opcode(0x38) LD_CARRY(1);							EndOpcode; //SEC
+			Opcode(0x58) Flags.Misc &= ~FLAG_I;				EndOpcode; //CLI
+			Opcode(0x78) Flags.Misc |= FLAG_I;				EndOpcode; //SEI
+			Opcode(0xb8) LD_OVERFLOW(0);						EndOpcode; //CLV
+			Opcode(0xd8) Flags.Misc &= ~FLAG_D;				EndOpcode; //CLD
+			Opcode(0xf8) Flags.Misc |= FLAG_D;				EndOpcode; //SED
+
+			Opcode(0x9a) s = x8;								EndOpcode; //TXS
+			Opcode(0xba) x8 = s; LD_NEGZERO(x8);				EndOpcode; //TSX
+			Opcode(0x98) a8 = y8; LD_NEGZERO(a8); IfWide(a32 = y32);	EndOpcode; //TYA
+			Opcode(0x8a) a8 = x8; LD_NEGZERO(a8); IfWide(a32 = x32);	EndOpcode; //TXA
+			Opcode(0xa8) y8 = a8; LD_NEGZERO(y8); IfWide(y32 = a32);	EndOpcode; //TAY
+			Opcode(0xaa) x8 = a8; LD_NEGZERO(x8); IfWide(x32 = a32);	EndOpcode; //TAX
+
+			Opcode(0xe8) INC(x8);								EndOpcode; //INX
+			Opcode(0xc8) INC(y8);								EndOpcode; //INY
+
+			Opcode(0x88) DEC(y8);								EndOpcode; //DEY
+			Opcode(0xca) DEC(x8);								EndOpcode; //DEX
+
+			Opcode(0x0a) ASL(a8, a32);						EndOpcode; //ASL A
+			Opcode(0x2a) ROL(a8, a32);						EndOpcode; //ROL A
+			Opcode(0x4a) LSR(a8, a32);						EndOpcode; //LSR A
+			Opcode(0x6a) ROR(a8, a32);						EndOpcode; //ROR A
+
+			Opcode(0x1a)
+			Opcode(0x3a)
+			Opcode(0x5a)
+			Opcode(0x7a)
+			Opcode(0xda)
+			Opcode(0xea)
+			Opcode(0xfa) NOP();								EndOpcode;
 
 			/* immediate addressing */
 
@@ -812,65 +883,65 @@ int C6502::CPUThread()
 	pc.a++;\
 	c;
 
-			case 0xa9: ImmediateOp( LD(a8, a32) );	break; //LDA
-			case 0xa2: ImmediateOp( LD(x8, x32) );	break; //LDX
-			case 0xa0: ImmediateOp( LD(y8, y32) );	break; //LDY
-
-			case 0xe0: ImmediateOp( CP(x8, NextByte) );	break; //CPX
-			case 0xc0: ImmediateOp( CP(y8, NextByte) );	break; //CPY
-			case 0xc9: ImmediateOp( CP(a8, NextByte) );	break; //CMP
-
-			case 0x09: ImmediateOp(ORA());	break; //ORA
-			case 0x29: ImmediateOp(AND());	break; //AND
-			case 0x49: ImmediateOp(EOR());	break; //EOR
-			case 0x69: ImmediateOp(ADC());	break; //ADC
-			case 0xeb:
-			case 0xe9: ImmediateOp(SBC());	break; //SBC
-
-			case 0x80:
-			case 0x82:
-			case 0x89:
-			case 0xc2:
-			case 0xe2:
+			Opcode(0xa9) ImmediateOp( LD(a8, a32) );	EndOpcode; //LDA
+			Opcode(0xa2) ImmediateOp( LD(x8, x32) );	EndOpcode; //LDX
+			Opcode(0xa0) ImmediateOp( LD(y8, y32) );	EndOpcode; //LDY
+
+			Opcode(0xe0) ImmediateOp( CP(x8, NextByte) );	EndOpcode; //CPX
+			Opcode(0xc0) ImmediateOp( CP(y8, NextByte) );	EndOpcode; //CPY
+			Opcode(0xc9) ImmediateOp( CP(a8, NextByte) );	EndOpcode; //CMP
+
+			Opcode(0x09) ImmediateOp(ORA());	EndOpcode; //ORA
+			Opcode(0x29) ImmediateOp(AND());	EndOpcode; //AND
+			Opcode(0x49) ImmediateOp(EOR());	EndOpcode; //EOR
+			Opcode(0x69) ImmediateOp(ADC());	EndOpcode; //ADC
+			Opcode(0xeb)
+			Opcode(0xe9) ImmediateOp(SBC());	EndOpcode; //SBC
+
+			Opcode(0x80)
+			Opcode(0x82)
+			Opcode(0x89)
+			Opcode(0xc2)
+			Opcode(0xe2)
 				ImmediateOp(NOP());
-			break; //NOP
+			EndOpcode; //NOP
 
-			case 0x0b:
-			case 0x2b: ImmediateOp(ANC()); break; //ANC
-			case 0x4b: ImmediateOp(ALR()); break; //ALR
-			case 0x6b: ImmediateOp(ARR()); break; //ARR
-			case 0x8b:
+			Opcode(0x0b)
+			Opcode(0x2b) ImmediateOp(ANC()); EndOpcode; //ANC
+			Opcode(0x4b) ImmediateOp(ALR()); EndOpcode; //ALR
+			Opcode(0x6b) ImmediateOp(ARR()); EndOpcode; //ARR
+			Opcode(0x8b)
 				ImmediateOp(
 					a8 = (a8|0xee)&NextByte&x8;
 					LD_NEGZERO(a8);
-					a32 = (a32|0xfff0fff0)&NextWord&x32;
+					IfWide(a32 = (a32|0xfff0fff0)&NextWord&x32);
 				);
-			break; //ANE
-			case 0xab:
+			EndOpcode; //ANE
+			Opcode(0xab)
 				ImmediateOp(
 					a8 = x8 = (a8|0xee)&NextByte;
 					LD_NEGZERO(a8);
-					a32 = x32 = (a32|0xfff0fff0)&NextWord;
+					IfWide(a32 = x32 = (a32|0xfff0fff0)&NextWord);
 				);
-			break; //LXA
-			case 0xcb:
+			EndOpcode; //LXA
+			Opcode(0xcb)
 				ImmediateOp(
-						x8 &= a8; x32 &= a32;
+						x8 &= a8; IfWide(x32 &= a32);
 						temp16.a = x8 - NextByte;
 						x8 = temp16.b.l;
 						LD_NEGZERO(temp16.b.l);
 						LD_CARRY(temp16.b.h ? 0 : 1);
-						x32 -= NextWord;
+						IfWide(x32 -= NextWord);
 				);
-			break; //SBX
+			EndOpcode; //SBX
 
 #undef ImmediateOp
 
 		/* absolute addressing */
-			case 0x4c:	//JMP
+			Opcode(0x4c)	//JMP
 				pc.a++; Addr.b.l = NextByte;
 				Read8BW(pc, Addr.b.h); CycleDone(pc.a); pc.a = Addr.a; 
-			break;
+			EndOpcode;
 
 #define AbsoluteRead(c)\
 	pc.a++; Addr.b.l = NextByte;\
@@ -878,24 +949,24 @@ int C6502::CPUThread()
 	EvaluateIRQ();\
 	Read32BW(Addr, NextByte, NextWord); c; CycleDone(Addr.a);
 
-			case 0xac: AbsoluteRead(LD(y8, y32));				break; //LDY
-			case 0xad: AbsoluteRead(LD(a8, a32));				break; //LDA
-			case 0xae: AbsoluteRead(LD(x8, x32));				break; //LDX
-			case 0xaf: AbsoluteRead(LD(x8 = a8, x32 = a32));	break; //LAX
+			Opcode(0xac) AbsoluteRead(LD(y8, y32));				EndOpcode; //LDY
+			Opcode(0xad) AbsoluteRead(LD(a8, a32));				EndOpcode; //LDA
+			Opcode(0xae) AbsoluteRead(LD(x8, x32));				EndOpcode; //LDX
+			Opcode(0xaf) AbsoluteRead(LD(x8 = a8, x32 = a32));	EndOpcode; //LAX
 
-			case 0x0d: AbsoluteRead(ORA());						break; //ORA
-			case 0x2d: AbsoluteRead(AND());						break; //AND
-			case 0x4d: AbsoluteRead(EOR());						break; //EOR
-			case 0x6d: AbsoluteRead(ADC());						break; //ADC
-			case 0xed: AbsoluteRead(SBC());						break; //SBC
+			Opcode(0x0d) AbsoluteRead(ORA());						EndOpcode; //ORA
+			Opcode(0x2d) AbsoluteRead(AND());						EndOpcode; //AND
+			Opcode(0x4d) AbsoluteRead(EOR());						EndOpcode; //EOR
+			Opcode(0x6d) AbsoluteRead(ADC());						EndOpcode; //ADC
+			Opcode(0xed) AbsoluteRead(SBC());						EndOpcode; //SBC
 
-			case 0xcc: AbsoluteRead( CP(y8, NextByte) );		break; //CPY
-			case 0xcd: AbsoluteRead( CP(a8, NextByte) );		break; //CMP
-			case 0xec: AbsoluteRead( CP(x8, NextByte) );		break; //CPX
+			Opcode(0xcc) AbsoluteRead( CP(y8, NextByte) );		EndOpcode; //CPY
+			Opcode(0xcd) AbsoluteRead( CP(a8, NextByte) );		EndOpcode; //CMP
+			Opcode(0xec) AbsoluteRead( CP(x8, NextByte) );		EndOpcode; //CPX
 
-			case 0x2c: AbsoluteRead( BIT() );					break; //BIT
+			Opcode(0x2c) AbsoluteRead( BIT() );					EndOpcode; //BIT
 
-			case 0x0c: AbsoluteRead( NOP() );					break; //NOP
+			Opcode(0x0c) AbsoluteRead( NOP() );					EndOpcode; //NOP
 
 #undef AbsoluteRead
 
@@ -905,10 +976,10 @@ int C6502::CPUThread()
 	EvaluateIRQ();\
 	c; CycleDone(Addr.a);
 
-			case 0x8c: AbsoluteWrite( ST(y8, y32) );			break; //STY
-			case 0x8d: AbsoluteWrite( ST(a8, a32) );			break; //STA
-			case 0x8e: AbsoluteWrite( ST(x8, x32) );			break; //STX
-			case 0x8f: AbsoluteWrite( ST(x8&a8, x32&a32) );		break; //SAX
+			Opcode(0x8c) AbsoluteWrite( ST(y8, y32) );			EndOpcode; //STY
+			Opcode(0x8d) AbsoluteWrite( ST(a8, a32) );			EndOpcode; //STA
+			Opcode(0x8e) AbsoluteWrite( ST(x8, x32) );			EndOpcode; //STX
+			Opcode(0x8f) AbsoluteWrite( ST(x8&a8, x32&a32) );		EndOpcode; //SAX
 
 #undef AbsoluteWrite
 
@@ -917,21 +988,21 @@ int C6502::CPUThread()
 	Read8BW(pc, Addr.b.h); CycleDone(pc.a); pc.a++; \
 	ModifyBW(Addr, c, NextByte, NextWord)
 
-			case 0x0e: AbsoluteModify(ASL(NextByte, NextWord))		break; //ASL
-			case 0x2e: AbsoluteModify(ROL(NextByte, NextWord))		break; //ROL
-			case 0x4e: AbsoluteModify(LSR(NextByte, NextWord))		break; //LSR
-			case 0x6e: AbsoluteModify(ROR(NextByte, NextWord))		break; //ROR
+			Opcode(0x0e) AbsoluteModify(ASL(NextByte, NextWord))		EndOpcode; //ASL
+			Opcode(0x2e) AbsoluteModify(ROL(NextByte, NextWord))		EndOpcode; //ROL
+			Opcode(0x4e) AbsoluteModify(LSR(NextByte, NextWord))		EndOpcode; //LSR
+			Opcode(0x6e) AbsoluteModify(ROR(NextByte, NextWord))		EndOpcode; //ROR
 
-			case 0xce: AbsoluteModify(DEC(NextByte))				break; //DEC
-			case 0xee: AbsoluteModify(INC(NextByte))				break; //INC
+			Opcode(0xce) AbsoluteModify(DEC(NextByte))				EndOpcode; //DEC
+			Opcode(0xee) AbsoluteModify(INC(NextByte))				EndOpcode; //INC
 
-			case 0x0f: AbsoluteModify( SLO() )						break; //SLO
-			case 0x2f: AbsoluteModify( RLA() )						break; //RLA
-			case 0x4f: AbsoluteModify( SRE() )						break; //SRE
+			Opcode(0x0f) AbsoluteModify( SLO() )						EndOpcode; //SLO
+			Opcode(0x2f) AbsoluteModify( RLA() )						EndOpcode; //RLA
+			Opcode(0x4f) AbsoluteModify( SRE() )						EndOpcode; //SRE
 
-			case 0x6f: AbsoluteModify( RRA() )						break; //RRA
-			case 0xcf: AbsoluteModify( DCP() )						break; //DCP
-			case 0xef: AbsoluteModify( ISC() )						break; //ISC
+			Opcode(0x6f) AbsoluteModify( RRA() )						EndOpcode; //RRA
+			Opcode(0xcf) AbsoluteModify( DCP() )						EndOpcode; //DCP
+			Opcode(0xef) AbsoluteModify( ISC() )						EndOpcode; //ISC
 
 #undef AbsoluteModify
 
@@ -941,25 +1012,25 @@ int C6502::CPUThread()
 	EvaluateIRQ();\
 	Addr.a = NextByte; Read32Z(Addr.a, NextByte, NextWord); c; CycleDone(0);
 
-			case 0xa4: ZeroRead( LD(y8, y32) );				break; //LDY
-			case 0xa5: ZeroRead( LD(a8, a32) );				break; //LDA
-			case 0xa6: ZeroRead( LD(x8, x32) );				break; //LDX
-			case 0xa7: ZeroRead( LD(x8 = a8, x32 = a32) );	break; //LAX
+			Opcode(0xa4) ZeroRead( LD(y8, y32) );				EndOpcode; //LDY
+			Opcode(0xa5) ZeroRead( LD(a8, a32) );				EndOpcode; //LDA
+			Opcode(0xa6) ZeroRead( LD(x8, x32) );				EndOpcode; //LDX
+			Opcode(0xa7) ZeroRead( LD(x8 = a8, x32 = a32) );	EndOpcode; //LAX
 
-			case 0x05: ZeroRead( ORA() );					break; //ORA
-			case 0x25: ZeroRead( AND() );					break; //AND
-			case 0x45: ZeroRead( EOR() );					break; //EOR
-			case 0x65: ZeroRead( ADC() );					break; //ADC
-			case 0xe5: ZeroRead( SBC() );					break; //SBC
+			Opcode(0x05) ZeroRead( ORA() );					EndOpcode; //ORA
+			Opcode(0x25) ZeroRead( AND() );					EndOpcode; //AND
+			Opcode(0x45) ZeroRead( EOR() );					EndOpcode; //EOR
+			Opcode(0x65) ZeroRead( ADC() );					EndOpcode; //ADC
+			Opcode(0xe5) ZeroRead( SBC() );					EndOpcode; //SBC
 
-			case 0x24: ZeroRead( BIT() );					break; //BIT
-			case 0xc4: ZeroRead( CP(y8, NextByte) );		break; //CPY
-			case 0xc5: ZeroRead( CP(a8, NextByte) );		break; //CMP
-			case 0xe4: ZeroRead( CP(x8, NextByte) );		break; //CPX
+			Opcode(0x24) ZeroRead( BIT() );					EndOpcode; //BIT
+			Opcode(0xc4) ZeroRead( CP(y8, NextByte) );		EndOpcode; //CPY
+			Opcode(0xc5) ZeroRead( CP(a8, NextByte) );		EndOpcode; //CMP
+			Opcode(0xe4) ZeroRead( CP(x8, NextByte) );		EndOpcode; //CPX
 
-			case 0x04:
-			case 0x44:
-			case 0x64: ZeroRead( NOP() );					break; //NOP
+			Opcode(0x04)
+			Opcode(0x44)
+			Opcode(0x64) ZeroRead( NOP() );					EndOpcode; //NOP
 
 #undef ZeroRead
 
@@ -968,10 +1039,10 @@ int C6502::CPUThread()
 	EvaluateIRQ();\
 	Addr.a = NextByte; c; CycleDone(0);
 
-			case 0x84: ZeroWrite(STZ(y8, y32));			break; //STY
-			case 0x85: ZeroWrite(STZ(a8, a32));			break; //STA
-			case 0x86: ZeroWrite(STZ(x8, x32));			break; //STX
-			case 0x87: ZeroWrite(STZ(a8&x8, a32&x32));	break; //SAX
+			Opcode(0x84) ZeroWrite(STZ(y8, y32));			EndOpcode; //STY
+			Opcode(0x85) ZeroWrite(STZ(a8, a32));			EndOpcode; //STA
+			Opcode(0x86) ZeroWrite(STZ(x8, x32));			EndOpcode; //STX
+			Opcode(0x87) ZeroWrite(STZ(a8&x8, a32&x32));	EndOpcode; //SAX
 
 #undef ZeroWrite
 
@@ -979,21 +1050,21 @@ int C6502::CPUThread()
 	pc.a++;\
 	Addr.a = NextByte; ModifyZ(Addr.a, op, NextByte, NextWord)
 
-			case 0xc6: ZeroModify( DEC(NextByte) )				break; //DEC
-			case 0xe6: ZeroModify( INC(NextByte) )				break; //INC
+			Opcode(0xc6) ZeroModify( DEC(NextByte) )				EndOpcode; //DEC
+			Opcode(0xe6) ZeroModify( INC(NextByte) )				EndOpcode; //INC
 
-			case 0x06: ZeroModify( ASL(NextByte, NextWord) )	break; //ASL
-			case 0x26: ZeroModify( ROL(NextByte, NextWord) )	break; //ROL
-			case 0x46: ZeroModify( LSR(NextByte, NextWord) )	break; //LSR
-			case 0x66: ZeroModify( ROR(NextByte, NextWord) )	break; //ROR
+			Opcode(0x06) ZeroModify( ASL(NextByte, NextWord) )	EndOpcode; //ASL
+			Opcode(0x26) ZeroModify( ROL(NextByte, NextWord) )	EndOpcode; //ROL
+			Opcode(0x46) ZeroModify( LSR(NextByte, NextWord) )	EndOpcode; //LSR
+			Opcode(0x66) ZeroModify( ROR(NextByte, NextWord) )	EndOpcode; //ROR
 
-			case 0x07: ZeroModify( SLO() )						break; //SLO
-			case 0x27: ZeroModify( RLA() )						break; //RLA
-			case 0x47: ZeroModify( SRE() )						break; //SRE
+			Opcode(0x07) ZeroModify( SLO() )						EndOpcode; //SLO
+			Opcode(0x27) ZeroModify( RLA() )						EndOpcode; //RLA
+			Opcode(0x47) ZeroModify( SRE() )						EndOpcode; //SRE
 
-			case 0x67: ZeroModify( RRA() )						break; //RRA
-			case 0xc7: ZeroModify( DCP() )						break; //DCP
-			case 0xe7: ZeroModify( ISC() )						break; //ISC
+			Opcode(0x67) ZeroModify( RRA() )						EndOpcode; //RRA
+			Opcode(0xc7) ZeroModify( DCP() )						EndOpcode; //DCP
+			Opcode(0xe7) ZeroModify( ISC() )						EndOpcode; //ISC
 
 #undef ZeroModify
 
@@ -1014,25 +1085,25 @@ int C6502::CPUThread()
 		temp8 = NextByte; Read32Z(temp8, NextByte, NextWord); op; CycleDone(0);\
 	}
 
-			case 0xb4: ZeroPageIndexedRead( x8, LD(y8, y32));				break; //LDY zero,x
-			case 0xb5: ZeroPageIndexedRead( x8, LD(a8, a32));				break; //LDA zero,x
-			case 0xb6: ZeroPageIndexedRead( y8, LD(x8, x32));				break; //LDX zero,y
-			case 0xb7: ZeroPageIndexedRead( y8, LD(x8 = a8, x32 = a32));	break; //LAX zero,y
+			Opcode(0xb4) ZeroPageIndexedRead( x8, LD(y8, y32));				EndOpcode; //LDY zero,x
+			Opcode(0xb5) ZeroPageIndexedRead( x8, LD(a8, a32));				EndOpcode; //LDA zero,x
+			Opcode(0xb6) ZeroPageIndexedRead( y8, LD(x8, x32));				EndOpcode; //LDX zero,y
+			Opcode(0xb7) ZeroPageIndexedRead( y8, LD(x8 = a8, x32 = a32));	EndOpcode; //LAX zero,y
 
-			case 0x15: ZeroPageIndexedRead( x8, ORA() );					break; //ORA zero,x
-			case 0x35: ZeroPageIndexedRead( x8, AND() );					break; //AND zero,x
-			case 0x55: ZeroPageIndexedRead( x8, EOR() );					break; //EOR zero,x
-			case 0x75: ZeroPageIndexedRead( x8, ADC() );					break; //ADC zero,x
-			case 0xf5: ZeroPageIndexedRead( x8, SBC() );					break; //SBC zero,x
+			Opcode(0x15) ZeroPageIndexedRead( x8, ORA() );					EndOpcode; //ORA zero,x
+			Opcode(0x35) ZeroPageIndexedRead( x8, AND() );					EndOpcode; //AND zero,x
+			Opcode(0x55) ZeroPageIndexedRead( x8, EOR() );					EndOpcode; //EOR zero,x
+			Opcode(0x75) ZeroPageIndexedRead( x8, ADC() );					EndOpcode; //ADC zero,x
+			Opcode(0xf5) ZeroPageIndexedRead( x8, SBC() );					EndOpcode; //SBC zero,x
 
-			case 0xd5: ZeroPageIndexedRead( x8, CP( a8, NextByte ) );		break; //CMP zero,x
+			Opcode(0xd5) ZeroPageIndexedRead( x8, CP( a8, NextByte ) );		EndOpcode; //CMP zero,x
 
-			case 0x14:
-			case 0x34:
-			case 0x54:
-			case 0x74:
-			case 0xd4:
-			case 0xf4: ZeroPageIndexedRead( x8, NOP() );					break; //NOP
+			Opcode(0x14)
+			Opcode(0x34)
+			Opcode(0x54)
+			Opcode(0x74)
+			Opcode(0xd4)
+			Opcode(0xf4) ZeroPageIndexedRead( x8, NOP() );					EndOpcode; //NOP
 
 #undef ZeroPageIndexedRead
 
@@ -1041,10 +1112,10 @@ int C6502::CPUThread()
 	EvaluateIRQ();\
 	Addr.a = NextByte; op; CycleDone(0)
 
-			case 0x94: ZeroPageIndexedWrite( x8, STZ(y8, y32));			break; //STY zero,x
-			case 0x95: ZeroPageIndexedWrite( x8, STZ(a8, a32));			break; //STA zero,x
-			case 0x96: ZeroPageIndexedWrite( y8, STZ(x8, x32));			break; //STX zero,y
-			case 0x97: ZeroPageIndexedWrite( y8, STZ(x8&a8, x32&a32));	break; //SAX zero,y
+			Opcode(0x94) ZeroPageIndexedWrite( x8, STZ(y8, y32));			EndOpcode; //STY zero,x
+			Opcode(0x95) ZeroPageIndexedWrite( x8, STZ(a8, a32));			EndOpcode; //STA zero,x
+			Opcode(0x96) ZeroPageIndexedWrite( y8, STZ(x8, x32));			EndOpcode; //STX zero,y
+			Opcode(0x97) ZeroPageIndexedWrite( y8, STZ(x8&a8, x32&a32));	EndOpcode; //SAX zero,y
 
 #undef ZeroPageIndexedWrite
 
@@ -1052,21 +1123,21 @@ int C6502::CPUThread()
 	pc.a++; Read8Z(NextByte, TempAddr.b.l); NextByte += x8; CycleDone(0);\
 	TempAddr.b.l = NextByte; ModifyZ(TempAddr.b.l, op, NextByte, NextWord)
 
-			case 0x16: ZeroPageIndexedModify( ASL(NextByte, NextWord) )	break; //ASL
-			case 0x36: ZeroPageIndexedModify( ROL(NextByte, NextWord) )	break; //ROL
-			case 0x56: ZeroPageIndexedModify( LSR(NextByte, NextWord) )	break; //LSR
-			case 0x76: ZeroPageIndexedModify( ROR(NextByte, NextWord) )	break; //ROR
+			Opcode(0x16) ZeroPageIndexedModify( ASL(NextByte, NextWord) )	EndOpcode; //ASL
+			Opcode(0x36) ZeroPageIndexedModify( ROL(NextByte, NextWord) )	EndOpcode; //ROL
+			Opcode(0x56) ZeroPageIndexedModify( LSR(NextByte, NextWord) )	EndOpcode; //LSR
+			Opcode(0x76) ZeroPageIndexedModify( ROR(NextByte, NextWord) )	EndOpcode; //ROR
 
-			case 0xd6: ZeroPageIndexedModify( DEC(NextByte) )			break; //DEC
-			case 0xf6: ZeroPageIndexedModify( INC(NextByte) )			break; //INC
+			Opcode(0xd6) ZeroPageIndexedModify( DEC(NextByte) )			EndOpcode; //DEC
+			Opcode(0xf6) ZeroPageIndexedModify( INC(NextByte) )			EndOpcode; //INC
 
-			case 0x17: ZeroPageIndexedModify( SLO() )					break; //SLO
-			case 0x37: ZeroPageIndexedModify( RLA() )					break; //RLA
-			case 0x57: ZeroPageIndexedModify( SRE() )					break; //SRE
+			Opcode(0x17) ZeroPageIndexedModify( SLO() )					EndOpcode; //SLO
+			Opcode(0x37) ZeroPageIndexedModify( RLA() )					EndOpcode; //RLA
+			Opcode(0x57) ZeroPageIndexedModify( SRE() )					EndOpcode; //SRE
 
-			case 0x77: ZeroPageIndexedModify( RRA() )					break; //RRA
-			case 0xd7: ZeroPageIndexedModify( DCP() )					break; //DCP
-			case 0xf7: ZeroPageIndexedModify( ISC() )					break; //ISC
+			Opcode(0x77) ZeroPageIndexedModify( RRA() )					EndOpcode; //RRA
+			Opcode(0xd7) ZeroPageIndexedModify( DCP() )					EndOpcode; //DCP
+			Opcode(0xf7) ZeroPageIndexedModify( ISC() )					EndOpcode; //ISC
 
 #undef ZeroPageIndexedModify
 
@@ -1080,41 +1151,41 @@ int C6502::CPUThread()
 	EvaluateIRQ();\
 	op; CycleDone(Addr.a)
 
-			case 0x1d: AbsoluteIndexedRead( x8, ORA() );					break; //ORA abs, x
-			case 0x3d: AbsoluteIndexedRead( x8, AND() );					break; //AND abs, x
-			case 0x5d: AbsoluteIndexedRead( x8, EOR() );					break; //EOR abs, x
-			case 0x7d: AbsoluteIndexedRead( x8, ADC() );					break; //ADC abs, x
-			case 0xfd: AbsoluteIndexedRead( x8, SBC() );					break; //SBC abs, x
+			Opcode(0x1d) AbsoluteIndexedRead( x8, ORA() );					EndOpcode; //ORA abs, x
+			Opcode(0x3d) AbsoluteIndexedRead( x8, AND() );					EndOpcode; //AND abs, x
+			Opcode(0x5d) AbsoluteIndexedRead( x8, EOR() );					EndOpcode; //EOR abs, x
+			Opcode(0x7d) AbsoluteIndexedRead( x8, ADC() );					EndOpcode; //ADC abs, x
+			Opcode(0xfd) AbsoluteIndexedRead( x8, SBC() );					EndOpcode; //SBC abs, x
 
-			case 0x19: AbsoluteIndexedRead( y8, ORA() );					break; //ORA abs, y
-			case 0x39: AbsoluteIndexedRead( y8, AND() );					break; //AND abs, y
-			case 0x59: AbsoluteIndexedRead( y8, EOR() );					break; //EOR abs, y
-			case 0x79: AbsoluteIndexedRead( y8, ADC() );					break; //ADC abs, y
-			case 0xf9: AbsoluteIndexedRead( y8, SBC() );					break; //SBC abs, y
+			Opcode(0x19) AbsoluteIndexedRead( y8, ORA() );					EndOpcode; //ORA abs, y
+			Opcode(0x39) AbsoluteIndexedRead( y8, AND() );					EndOpcode; //AND abs, y
+			Opcode(0x59) AbsoluteIndexedRead( y8, EOR() );					EndOpcode; //EOR abs, y
+			Opcode(0x79) AbsoluteIndexedRead( y8, ADC() );					EndOpcode; //ADC abs, y
+			Opcode(0xf9) AbsoluteIndexedRead( y8, SBC() );					EndOpcode; //SBC abs, y
 
-			case 0xb9: AbsoluteIndexedRead( y8, LD(a8, a32) );				break; //LDA abs, y
+			Opcode(0xb9) AbsoluteIndexedRead( y8, LD(a8, a32) );				EndOpcode; //LDA abs, y
 
-			case 0xbd: AbsoluteIndexedRead( x8, LD(a8, a32) );				break; //LDA abs, x
-			case 0xbc: AbsoluteIndexedRead( x8, LD(y8, y32) );				break; //LDY abs, x
-			case 0xbe: AbsoluteIndexedRead( y8, LD(x8, x32) );				break; //LDX abs, y
-			case 0xbf: AbsoluteIndexedRead( y8, LD(x8 = a8, x32 = a32) );	break; //LAX abs, y
+			Opcode(0xbd) AbsoluteIndexedRead( x8, LD(a8, a32) );				EndOpcode; //LDA abs, x
+			Opcode(0xbc) AbsoluteIndexedRead( x8, LD(y8, y32) );				EndOpcode; //LDY abs, x
+			Opcode(0xbe) AbsoluteIndexedRead( y8, LD(x8, x32) );				EndOpcode; //LDX abs, y
+			Opcode(0xbf) AbsoluteIndexedRead( y8, LD(x8 = a8, x32 = a32) );	EndOpcode; //LAX abs, y
 
-			case 0xdd: AbsoluteIndexedRead( x8, CP(a8, NextByte) );			break; //CMP abs, x
-			case 0xd9: AbsoluteIndexedRead( y8, CP(a8, NextByte) );			break; //CMP abs, y
+			Opcode(0xdd) AbsoluteIndexedRead( x8, CP(a8, NextByte) );			EndOpcode; //CMP abs, x
+			Opcode(0xd9) AbsoluteIndexedRead( y8, CP(a8, NextByte) );			EndOpcode; //CMP abs, y
 
-			case 0x1c:
-			case 0x3c:
-			case 0x5c:
-			case 0x7c:
-			case 0xdc:
-			case 0xfc: AbsoluteIndexedRead( x8, NOP() );					break; //NOP
+			Opcode(0x1c)
+			Opcode(0x3c)
+			Opcode(0x5c)
+			Opcode(0x7c)
+			Opcode(0xdc)
+			Opcode(0xfc) AbsoluteIndexedRead( x8, NOP() );					EndOpcode; //NOP
 
-			case 0xbb:
+			Opcode(0xbb)
 				AbsoluteIndexedRead( y8, 
 					a8 = x8 = s = s&NextByte;
 					LD_NEGZERO(a8);
 				);
-			break; //LAS
+			EndOpcode; //LAS
 
 #undef AbsoluteIndexedRead
 
@@ -1126,16 +1197,16 @@ int C6502::CPUThread()
 	EvaluateIRQ();\
 	Addr.a += i; op; CycleDone(Addr.a)
 
-			case 0x99: AbsoluteIndexedWrite( y8, ST(a8, a32));			break; //STA abs, y
-			case 0x9d: AbsoluteIndexedWrite( x8, ST(a8, a32));			break; //STA abs, x
+			Opcode(0x99) AbsoluteIndexedWrite( y8, ST(a8, a32));			EndOpcode; //STA abs, y
+			Opcode(0x9d) AbsoluteIndexedWrite( x8, ST(a8, a32));			EndOpcode; //STA abs, x
 
-			case 0x9b: AbsoluteIndexedWrite( y8,
+			Opcode(0x9b) AbsoluteIndexedWrite( y8,
 				s = a8&x8;
 				ST(s&(Addr.b.h+1), 0);
-			);			break; //SHS abs, y
-			case 0x9c: AbsoluteIndexedWrite( x8, ST(y8&(Addr.b.h+1), y32));			break; //SHY abs, x
-			case 0x9e: AbsoluteIndexedWrite( y8, ST(x8&(Addr.b.h+1), x32));			break; //SHA abs, y
-			case 0x9f: AbsoluteIndexedWrite( y8, ST(a8&x8&(Addr.b.h+1), a32&x32));	break; //SHX abs, y
+			);			EndOpcode; //SHS abs, y
+			Opcode(0x9c) AbsoluteIndexedWrite( x8, ST(y8&(Addr.b.h+1), y32));			EndOpcode; //SHY abs, x
+			Opcode(0x9e) AbsoluteIndexedWrite( y8, ST(x8&(Addr.b.h+1), x32));			EndOpcode; //SHA abs, y
+			Opcode(0x9f) AbsoluteIndexedWrite( y8, ST(a8&x8&(Addr.b.h+1), a32&x32));	EndOpcode; //SHX abs, y
 
 #undef AbsoluteIndexedWrite
 
@@ -1146,29 +1217,29 @@ int C6502::CPUThread()
 	Read32BW(TempAddr, NextByte, NextWord); CycleDone(TempAddr.a);\
 	Addr.a += i; ModifyBW(Addr, op, NextByte, NextWord)
 
-			case 0x1e: AbsoluteIndexedModify( x8, ASL(NextByte, NextWord) )		break; //ASL abs,x
-			case 0x3e: AbsoluteIndexedModify( x8, ROL(NextByte, NextWord) )		break; //ROL abs,x
-			case 0x5e: AbsoluteIndexedModify( x8, LSR(NextByte, NextWord) )		break; //LSR abs,x
-			case 0x7e: AbsoluteIndexedModify( x8, ROR(NextByte, NextWord) )		break; //ROR abs,x
+			Opcode(0x1e) AbsoluteIndexedModify( x8, ASL(NextByte, NextWord) )		EndOpcode; //ASL abs,x
+			Opcode(0x3e) AbsoluteIndexedModify( x8, ROL(NextByte, NextWord) )		EndOpcode; //ROL abs,x
+			Opcode(0x5e) AbsoluteIndexedModify( x8, LSR(NextByte, NextWord) )		EndOpcode; //LSR abs,x
+			Opcode(0x7e) AbsoluteIndexedModify( x8, ROR(NextByte, NextWord) )		EndOpcode; //ROR abs,x
 
-			case 0xde: AbsoluteIndexedModify( x8, DEC(NextByte) )				break; //DEC abs,x
-			case 0xfe: AbsoluteIndexedModify( x8, INC(NextByte) )				break; //INC abs,x
+			Opcode(0xde) AbsoluteIndexedModify( x8, DEC(NextByte) )				EndOpcode; //DEC abs,x
+			Opcode(0xfe) AbsoluteIndexedModify( x8, INC(NextByte) )				EndOpcode; //INC abs,x
 
-			case 0x1f: AbsoluteIndexedModify( x8, SLO() )						break; //SLO abs,x
-			case 0x3f: AbsoluteIndexedModify( x8, RLA() )						break; //RLA abs,x 
-			case 0x5f: AbsoluteIndexedModify( x8, SRE() )						break; //SRE abs,x
+			Opcode(0x1f) AbsoluteIndexedModify( x8, SLO() )						EndOpcode; //SLO abs,x
+			Opcode(0x3f) AbsoluteIndexedModify( x8, RLA() )						EndOpcode; //RLA abs,x 
+			Opcode(0x5f) AbsoluteIndexedModify( x8, SRE() )						EndOpcode; //SRE abs,x
 
-			case 0x7f: AbsoluteIndexedModify( x8, RRA() )						break; //RRA abs,x
-			case 0xdf: AbsoluteIndexedModify( x8, DCP() )						break; //DCP abs,x
-			case 0xff: AbsoluteIndexedModify( x8, ISC() )						break; //ISC abs,x
+			Opcode(0x7f) AbsoluteIndexedModify( x8, RRA() )						EndOpcode; //RRA abs,x
+			Opcode(0xdf) AbsoluteIndexedModify( x8, DCP() )						EndOpcode; //DCP abs,x
+			Opcode(0xff) AbsoluteIndexedModify( x8, ISC() )						EndOpcode; //ISC abs,x
 
-			case 0x1b: AbsoluteIndexedModify( y8, SLO() )						break; //SLO abs,y
-			case 0x3b: AbsoluteIndexedModify( y8, RLA() )						break; //RLA abs,y
-			case 0x5b: AbsoluteIndexedModify( y8, SRE() )						break; //SRE abs,y
+			Opcode(0x1b) AbsoluteIndexedModify( y8, SLO() )						EndOpcode; //SLO abs,y
+			Opcode(0x3b) AbsoluteIndexedModify( y8, RLA() )						EndOpcode; //RLA abs,y
+			Opcode(0x5b) AbsoluteIndexedModify( y8, SRE() )						EndOpcode; //SRE abs,y
 
-			case 0x7b: AbsoluteIndexedModify( y8, RRA() )						break; //RRA abs,y
-			case 0xdb: AbsoluteIndexedModify( y8, DCP() )						break; //DCP abs,y
-			case 0xfb: AbsoluteIndexedModify( y8, ISC() )						break; //ISC abs,y
+			Opcode(0x7b) AbsoluteIndexedModify( y8, RRA() )						EndOpcode; //RRA abs,y
+			Opcode(0xdb) AbsoluteIndexedModify( y8, DCP() )						EndOpcode; //DCP abs,y
+			Opcode(0xfb) AbsoluteIndexedModify( y8, ISC() )						EndOpcode; //ISC abs,y
 
 #undef AbsoluteIndexedModify
 
@@ -1191,15 +1262,15 @@ int C6502::CPUThread()
 	EvaluateIRQ();\
 	Read32BW(Addr, NextByte, NextWord); op; CycleDone(Addr.a)
 
-			case 0x01: IndexedIndirectRead( ORA() );					break; //ORA
-			case 0x21: IndexedIndirectRead( AND() );					break; //AND
-			case 0x41: IndexedIndirectRead( EOR() );					break; //EOR
-			case 0x61: IndexedIndirectRead( ADC() );					break; //ADC
-			case 0xe1: IndexedIndirectRead( SBC() );					break; //SBC
-			case 0xc1: IndexedIndirectRead( CP(a8, NextByte) );			break; //CMP
+			Opcode(0x01) IndexedIndirectRead( ORA() );					EndOpcode; //ORA
+			Opcode(0x21) IndexedIndirectRead( AND() );					EndOpcode; //AND
+			Opcode(0x41) IndexedIndirectRead( EOR() );					EndOpcode; //EOR
+			Opcode(0x61) IndexedIndirectRead( ADC() );					EndOpcode; //ADC
+			Opcode(0xe1) IndexedIndirectRead( SBC() );					EndOpcode; //SBC
+			Opcode(0xc1) IndexedIndirectRead( CP(a8, NextByte) );			EndOpcode; //CMP
 
-			case 0xa1: IndexedIndirectRead( LD(a8, a32) );				break; //LDA
-			case 0xa3: IndexedIndirectRead( LD(x8 = a8, x32 = a32) );	break; //LAX
+			Opcode(0xa1) IndexedIndirectRead( LD(a8, a32) );				EndOpcode; //LDA
+			Opcode(0xa3) IndexedIndirectRead( LD(x8 = a8, x32 = a32) );	EndOpcode; //LAX
 
 #undef IndexedIndirectRead
 
@@ -1220,8 +1291,8 @@ int C6502::CPUThread()
 	EvaluateIRQ();\
 	op; CycleDone(Addr.a)
 
-			case 0x81: IndexedIndirectWrite( ST(a8, a32) );			break; //STA
-			case 0x83: IndexedIndirectWrite( ST(x8&a8, x32&a32) );	break; //SAX
+			Opcode(0x81) IndexedIndirectWrite( ST(a8, a32) );			EndOpcode; //STA
+			Opcode(0x83) IndexedIndirectWrite( ST(x8&a8, x32&a32) );	EndOpcode; //SAX
 
 #undef IndexedIndirectWrite
 
@@ -1241,13 +1312,13 @@ int C6502::CPUThread()
 	}\
 	ModifyBW(Addr, op, NextByte, NextWord)
 
-			case 0x03: IndexedIndirectModify( SLO() )	break; //SLO
-			case 0x23: IndexedIndirectModify( RLA() )	break; //RLA
-			case 0x43: IndexedIndirectModify( SRE() )	break; //SRE
+			Opcode(0x03) IndexedIndirectModify( SLO() )	EndOpcode; //SLO
+			Opcode(0x23) IndexedIndirectModify( RLA() )	EndOpcode; //RLA
+			Opcode(0x43) IndexedIndirectModify( SRE() )	EndOpcode; //SRE
 
-			case 0x63: IndexedIndirectModify( RRA() )	break; //RRA
-			case 0xc3: IndexedIndirectModify( DCP() )	break; //DCP
-			case 0xe3: IndexedIndirectModify( ISC() )	break; //ISC
+			Opcode(0x63) IndexedIndirectModify( RRA() )	EndOpcode; //RRA
+			Opcode(0xc3) IndexedIndirectModify( DCP() )	EndOpcode; //DCP
+			Opcode(0xe3) IndexedIndirectModify( ISC() )	EndOpcode; //ISC
 
 #undef IndexedIndirectModify
 
@@ -1271,16 +1342,16 @@ int C6502::CPUThread()
 	EvaluateIRQ();\
 	c; CycleDone(Addr.a)
 
-			case 0x11: IndirectIndexedRead( ORA() );					break; //ORA
-			case 0x31: IndirectIndexedRead( AND() );					break; //AND
-			case 0x51: IndirectIndexedRead( EOR() );					break; //EOR
-			case 0x71: IndirectIndexedRead( ADC() );					break; //ADC
-			case 0xf1: IndirectIndexedRead( SBC() );					break; //SBC
+			Opcode(0x11) IndirectIndexedRead( ORA() );					EndOpcode; //ORA
+			Opcode(0x31) IndirectIndexedRead( AND() );					EndOpcode; //AND
+			Opcode(0x51) IndirectIndexedRead( EOR() );					EndOpcode; //EOR
+			Opcode(0x71) IndirectIndexedRead( ADC() );					EndOpcode; //ADC
+			Opcode(0xf1) IndirectIndexedRead( SBC() );					EndOpcode; //SBC
 
-			case 0xb1: IndirectIndexedRead( LD(a8, a32));				break; //LDA
-			case 0xb3: IndirectIndexedRead( LD(x8 = a8, x32 = a32));	break; //LAX
+			Opcode(0xb1) IndirectIndexedRead( LD(a8, a32));				EndOpcode; //LDA
+			Opcode(0xb3) IndirectIndexedRead( LD(x8 = a8, x32 = a32));	EndOpcode; //LAX
 
-			case 0xd1: IndirectIndexedRead( CP(a8, NextByte));			break; //CMP
+			Opcode(0xd1) IndirectIndexedRead( CP(a8, NextByte));			EndOpcode; //CMP
 
 #undef IndirectIndexedRead
 
@@ -1303,8 +1374,8 @@ int C6502::CPUThread()
 	Addr.a += y8;\
 	c; CycleDone(Addr.a)
 
-			case 0x91: IndirectIndexedWrite( ST(a8, a32) );						break; //STA
-			case 0x93: IndirectIndexedWrite( ST(a8&x8&(Addr.b.h+1), a32&x32));	break; //SHA
+			Opcode(0x91) IndirectIndexedWrite( ST(a8, a32) );						EndOpcode; //STA
+			Opcode(0x93) IndirectIndexedWrite( ST(a8&x8&(Addr.b.h+1), a32&x32));	EndOpcode; //SHA
 
 #undef IndirectIndexedWrite
 
@@ -1326,25 +1397,28 @@ int C6502::CPUThread()
 	Addr.a += y8;\
 	ModifyBW(Addr, op, NextByte, NextWord)
 
-			case 0x13: IndirectIndexedModify( SLO() )	break; //SLO
-			case 0x33: IndirectIndexedModify( RLA() )	break; //RLA
-			case 0x53: IndirectIndexedModify( SRE() )	break; //SRE
+			Opcode(0x13) IndirectIndexedModify( SLO() )	EndOpcode; //SLO
+			Opcode(0x33) IndirectIndexedModify( RLA() )	EndOpcode; //RLA
+			Opcode(0x53) IndirectIndexedModify( SRE() )	EndOpcode; //SRE
 
-			case 0x73: IndirectIndexedModify( RRA() )	break; //RRA
-			case 0xd3: IndirectIndexedModify( DCP() )	break; //DCP
-			case 0xf3: IndirectIndexedModify( ISC() )	break; //ISC
+			Opcode(0x73) IndirectIndexedModify( RRA() )	EndOpcode; //RRA
+			Opcode(0xd3) IndirectIndexedModify( DCP() )	EndOpcode; //DCP
+			Opcode(0xf3) IndirectIndexedModify( ISC() )	EndOpcode; //ISC
 
 #undef IndexedIndirectModify
 			/* absolute indirect addressing */
 
-			case 0x6c: //JMP (addr)
+			Opcode(0x6c) //JMP (addr)
 				pc.a++;
 				Addr.b.l = NextByte; Read8BW(pc, Addr.b.h); CycleDone(pc.a); pc.a++;
 				Read8BW(Addr, pc.b.l); Addr.b.l++; CycleDone(Addr.a);
 				EvaluateIRQ();
 				Read8BW(Addr, pc.b.h); CycleDone(Addr.a);
-			break;
+			EndOpcode;
 		}
+#ifdef CPU_COMPUTEDGOTO
+		OpcodeDone:
+#endif
 
 		/* check whether should be IRQ'ing now (actually was checked mid-operation) */
 		if(DoIRQ)
@@ -1382,14 +1456,20 @@ int C6502::CPUThread()
 			RSTLine = ForceRST = false;
 		}
 	}
-
-	return 0;
 }
 /* MSVC 6 build problems [displeasing] workaround */
 #ifdef CPU_NOOPT
 #pragma optimize( "", on ) 
 #endif
 
+void C6502::Run()
+{
+	if(WideCore)
+		RunCore<true>();
+	else
+		RunCore<false>();
+}
+
 void C6502::GetState(C6502State &st)
 {
 	st.a32 = a32; st.a8 = a8;
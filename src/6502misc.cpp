@@ -25,22 +25,27 @@
 #define PAGE_STEP8		1280
 #define PAGE_STEP32		320
 
+/* the display only ever reads the first 32kb of the pool - see C6502::SetGatherWindow */
+#define GatherPage(addr)	(((addr) < 0x8000) ? (((addr) >> 8)+1) : 0)
+
 #include "6502.h"
 #include <memory.h>
 
 C6502::C6502()
 {
-	GoSemaphore = SDL_CreateSemaphore(0);
-	StopSemaphore = SDL_CreateSemaphore(0);
-	VolInstructionsToRun = 0;
+	InstructionsToRun = 0;
+	CyclesToRun = SubCycleCount = CycleDebt = 0;
 
-	Quit = false;
-	CPUDead = false;
-	MainEx = SDL_CreateThread(CPUThreadHelper, this);
+	CPUDead = JustWokeUp = false;
+	WideCore = false;
 
 //	SetGathering((Uint16 *)AddrTemp, (Uint8 *)AddrTemp, (Uint32 *)AddrTemp);
 
 	AllLayouts = NULL;
+	GatherTargetStart = GatherTarget = NULL;
+	GatherAddressesStart = GatherAddresses = NULL;
+	GatherLowPage = 0;
+	DirtyPages[0] = DirtyPages[1] = DirtyPages[2] = DirtyPages[3] = 0xffffffff;
 	Flags.Carry = Flags.Misc = Flags.Neg = Flags.Overflow = Flags.Zero = 0;
 	Flags.Carry32 = 0;
 
@@ -49,16 +54,6 @@ C6502::C6502()
 
 C6502::~C6502()
 {
-	/* cause CPU thread to exit neatly */
-	Quit = true;
-	VolSubCycleCount = 0;
-	VolCyclesToRun = 1;
-
-	SDL_SemPost(GoSemaphore);
-	SDL_WaitThread(MainEx, NULL);
-	SDL_DestroySemaphore(GoSemaphore);
-	SDL_DestroySemaphore(StopSemaphore);
-
 	delete[] AllLayouts;
 	delete[] MemoryPool;
 }
@@ -68,8 +63,7 @@ void C6502::AttachTo(CProcessPool &pool, Uint32 id)
 	PPPtr = &pool;
 	PPNum = id;
 
-	IOCtl(C6502IOCTL_FINISHOPCODE);
-	VolTotalCycleCount = VolFrameCount = 0;
+	TotalCycleCount = FrameCount = CycleDebt = 0;
 
 	IRQLine = false;
 }
@@ -78,29 +72,33 @@ Uint32 C6502::Update(Uint32 t, bool)
 {
 	if(t)
 	{
-		VolCyclesToRun = t;
-		VolSubCycleCount = 0;
+		CyclesToRun = t;
+		SubCycleCount = 0;
 
-		/* signal main thread to continue for a bit */
-		SDL_SemPost(GoSemaphore);
-		/* wait for it to finish */
-		SDL_SemWait(StopSemaphore);
+		Run();
 	}
 	else
-		VolCyclesToRun = VolSubCycleCount = 0;
+		CyclesToRun = SubCycleCount = 0;
 
 	return CYCLENO_ANY;
 }
 
 Uint32 C6502::GetCyclesExecuted()
 {
-	return VolSubCycleCount;
+	return SubCycleCount;
+}
+
+Uint32 C6502::GetTotalCycles()
+{
+	return TotalCycleCount;
 }
 
 void C6502::EstablishMemoryLayouts(int count)
 {
 	delete[] AllLayouts;
 	AllLayouts = new MemoryLayout[count];
+	while(count--)
+		memset(AllLayouts[count].GatherPages, 0, 256);
 }
 
 void C6502::SetMemoryLayout(int id)
@@ -153,6 +151,7 @@ void C6502::SetRepeatedWritePage(int LocalAddr, int GlobalAddr, int Length)
 	{
 		CurrentLayout->Write8Ptrs[LocalAddr] = Ptr8;
 		CurrentLayout->Write32Ptrs[LocalAddr] = Ptr32;
+		CurrentLayout->GatherPages[LocalAddr] = GatherPage(GlobalAddr);
 		LocalAddr++;
 	}
 }
@@ -169,6 +168,8 @@ void C6502::SetWritePage(int LocalAddr, int GlobalAddr, int Length)
 	{
 		CurrentLayout->Write8Ptrs[LocalAddr] = Ptr8; Ptr8 += PAGE_STEP8;
 		CurrentLayout->Write32Ptrs[LocalAddr] = Ptr32; Ptr32 += PAGE_STEP32;
+		CurrentLayout->GatherPages[LocalAddr] = GatherPage(GlobalAddr);
+		GlobalAddr += 256;
 		LocalAddr++;
 	}
 }
@@ -186,9 +187,35 @@ void C6502::SetExecCyclePage(int LocalAddr, Uint32 **Table, int Length)
 
 void C6502::SetGathering(Uint16 *AddressSource, Uint32 *Target)
 {
+	/* complete whatever is left of the previous field before moving on */
+	FlushGathering();
+
 	GatherAddressesStart = GatherAddresses = AddressSource;
 	GatherTargetStart = GatherTarget = Target;
-	VolFrameCount = 0;
+	FrameCount = 0;
+}
+
+void C6502::FlushGathering()
+{
+	if(!GatherTargetStart) return;
+
+	Uint32 *GatherEnd = GatherTargetStart + FrameCount;
+	while(GatherTarget < GatherEnd)
+		*GatherTarget++ = MemoryPool[*GatherAddresses++];
+}
+
+void C6502::SetGatherWindow(Uint16 LowAddr)
+{
+	GatherLowPage = LowAddr >> 8;
+}
+
+void C6502::GetDirtyPages(Uint32 *Mask)
+{
+	for(int c = 0; c < 4; c++)
+	{
+		Mask[c] = DirtyPages[c];
+		DirtyPages[c] = 0;
+	}
 }
 
 void C6502::SetMemoryView(int pos, int layout)
@@ -219,47 +246,20 @@ bool C6502::IOCtl(Uint32 Control, void *Parameter, Uint32 TimeStamp)
 			CPUDead = false;
 		return true;
 
-		/* trap flags has no meaningful TimeStamp field */
+		/* trap flags has no meaningful TimeStamp field. The table stays
+		live, so later claims and releases are seen without another IOCtl */
 		case IOCTL_NEWTRAPFLAGS:
-			TrapFlags = (Uint32 *)Parameter;
-
-			/* 32 addresses per variable => 8 cover 256 */
-			ZeroPageClear =
-				(TrapFlags[0] | TrapFlags[1] | TrapFlags[2] | TrapFlags[3] |
-				TrapFlags[4] | TrapFlags[5] | TrapFlags[6] | TrapFlags[7]) ? false : true;
-			StackPageClear =
-				(TrapFlags[8] | TrapFlags[9] | TrapFlags[10] | TrapFlags[11] |
-				TrapFlags[12] | TrapFlags[13] | TrapFlags[14] | TrapFlags[15]) ? false : true;
-
+			TrapFlags = ((PPTrapFlags *)Parameter)->Addresses;
+			TrapPages = ((PPTrapFlags *)Parameter)->PageCounts;
 		return true;
 
 		case C6502IOCTL_FINISHOPCODE:
-		{
-			Uint16 Addrs[128];
-			Uint32 Targs[128];
-
-			memset(Addrs, 0, sizeof(Uint16)*128);
-
-			Uint16 *GABackup = GatherAddresses; GatherAddresses = Addrs;
-			Uint32 *GTBackup = GatherTarget; GatherTarget = Targs;
-			Uint32 VolFrameBackup = VolFrameCount; VolFrameCount = 0;
-
-			int OpcodesRemaining = VolInstructionsToRun;
-			VolInstructionsToRun = 1;
-				VolCyclesToRun = 128; // just to be safe!
-				VolSubCycleCount = 0;
-
-				/* signal main thread to continue for a bit */
-				SDL_SemPost(GoSemaphore);
-				/* wait for it to finish */
-				SDL_SemWait(StopSemaphore);
-
-			/* backup stuff temporarily stored away */
-			VolInstructionsToRun = OpcodesRemaining ? (OpcodesRemaining-1) : 0;
-			GatherAddresses = GABackup;
-			GatherTarget = GTBackup;
-			VolFrameCount = VolFrameBackup;
-		}
+			/* instructions always run to completion, so all that can be
+			outstanding is time owed by the most recent one. That has to
+			be paid off by a slice like any other, so that SubCycleCount,
+			FrameCount and the process pool all see it - see
+			CProcessPool::FinishOpcode */
+			if(Parameter) *((Uint32 *)Parameter) = CycleDebt;
 		return true;
 	}
 
@@ -268,12 +268,18 @@ bool C6502::IOCtl(Uint32 Control, void *Parameter, Uint32 TimeStamp)
 
 void C6502::WriteMem(Uint16 OpAddr, Uint16 WriteAddr, Uint8 Data8, Uint32 Data32)
 {
+	FlushGathering();
+	if(CurrentView[OpAddr >> 14]->GatherPages[WriteAddr >> 8])
+		MarkDirtyPage(CurrentView[OpAddr >> 14]->GatherPages[WriteAddr >> 8]-1);
 	CurrentView[OpAddr >> 14]->Write8Ptrs[WriteAddr >> 8][WriteAddr&0xff] = Data8;
 	CurrentView[OpAddr >> 14]->Write32Ptrs[WriteAddr >> 8][WriteAddr&0xff] = Data32;
 }
 
 void C6502::WriteMem(Uint16 OpAddr, Uint16 WriteAddr, Uint8 Data8)
 {
+	FlushGathering();
+	if(CurrentView[OpAddr >> 14]->GatherPages[WriteAddr >> 8])
+		MarkDirtyPage(CurrentView[OpAddr >> 14]->GatherPages[WriteAddr >> 8]-1);
 	CurrentView[OpAddr >> 14]->Write8Ptrs[WriteAddr >> 8][WriteAddr&0xff] = Data8;
 }
 
@@ -300,7 +306,12 @@ void C6502::Push(Uint8 Data8, Uint32 Data32)
 
 void C6502::SetInstructionLimit(Uint32 Limit)
 {
-	VolInstructionsToRun = Limit;
+	InstructionsToRun = Limit;
+}
+
+void C6502::SetMultiplexed(bool Enabled)
+{
+	WideCore = Enabled;
 }
 
 /*
@@ -335,6 +346,10 @@ void C6502::WriteMemoryBlock(int Base, int Offset, int Length, Uint8 *Data8, Uin
 	Uint8 *Ptr8;
 	Uint32 *Ptr32;
 
+	/* bulk loads are rare enough that the display may as well redraw everything */
+	FlushGathering();
+	DirtyPages[0] = DirtyPages[1] = DirtyPages[2] = DirtyPages[3] = 0xffffffff;
+
 	DevolveAddress(Base, Ptr8, Ptr32);
 
 	while(Offset >= 256)
@@ -344,18 +359,15 @@ void C6502::WriteMemoryBlock(int Base, int Offset, int Length, Uint8 *Data8, Uin
 		Offset -= 256;
 	}
 
-	if(Offset)
+	while(Length > 0)
 	{
-		memcpy(Ptr8+Offset, Data8, 256-Offset); Ptr8 += PAGE_STEP8-Offset; Ptr8 += 256 - Offset;
-		if(Data32) {memcpy(Ptr32+Offset, Data32, (256-Offset)<<2); Ptr32 += PAGE_STEP32-Offset; Ptr32 += 256 - Offset;}
-		Offset = 0;
-	}
+		int Run = 256 - Offset;
+		if(Run > Length) Run = Length;
 
-	while(Length >= 256)
-	{
-		memcpy(Ptr8, Data8, 256); Data8 += 256; Ptr8 += PAGE_STEP8;
-		if(Data32) {memcpy(Ptr32, Data32, 1024); Data32 += 256; Ptr32 += PAGE_STEP32;}
-		Length -= 256;
+		memcpy(Ptr8+Offset, Data8, Run); Data8 += Run; Ptr8 += PAGE_STEP8;
+		if(Data32) {memcpy(Ptr32+Offset, Data32, Run << 2); Data32 += Run; Ptr32 += PAGE_STEP32;}
+		Length -= Run;
+		Offset = 0;
 	}
 }
 
@@ -373,22 +385,14 @@ void C6502::ReadMemoryBlock(int Base, int Offset, int Length, Uint8 *Data8, Uint
 		Offset -= 256;
 	}
 
-	if(Offset)
+	while(Length > 0)
 	{
-		memcpy(Data8, Ptr8+Offset, 256-Offset); Ptr8 += PAGE_STEP8-Offset; Ptr8 += 256 - Offset;
-		if(Data32) {memcpy(Data32, Ptr32+Offset, (256-Offset)<<2); Ptr32 += PAGE_STEP32-Offset; Ptr32 += 256 - Offset;}
-		Offset = 0;
-	}
+		int Run = 256 - Offset;
+		if(Run > Length) Run = Length;
 
-	while(Length >= 256)
-	{
-		memcpy(Data8, Ptr8, 256); Data8 += 256; Ptr8 += PAGE_STEP8;
-		if(Data32) {memcpy(Data32, Ptr32, 1024); Data32 += 256; Ptr32 += PAGE_STEP32;}
-		Length -= 256;
+		memcpy(Data8, Ptr8+Offset, Run); Data8 += Run; Ptr8 += PAGE_STEP8;
+		if(Data32) {memcpy(Data32, Ptr32+Offset, Run << 2); Data32 += Run; Ptr32 += PAGE_STEP32;}
+		Length -= Run;
+		Offset = 0;
 	}
 }
-
-int C6502::CPUThreadHelper(void *tptr)
-{
-	return ((C6502 *)tptr)->CPUThread();
-}
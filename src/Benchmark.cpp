@@ -0,0 +1,166 @@
+/*
+
+	ElectrEm (c) 2000-6 Thomas Harte - an Acorn Electron Emulator
+
+	This is open software, distributed under the GPL 2, see 'Copying' for
+	details
+
+	Benchmark.cpp
+	=============
+
+	Alternative launching point that runs the emulated machine with no
+	window, no sound and no frame pacing for a fixed number of fields, then
+	reports how quickly that went. Usage:
+
+		benchmark [-frames n] [-roms path] [-plus1] [-plus3] [file ...]
+
+	Files are anything CProcessPool::Open accepts, i.e. UEFs, ADFs, etc.
+
+	Must be built with PROFILE defined (which removes the 50Hz throttle from
+	CProcessPool::Update) and with HeadlessHostMachine as the host. Defining
+	PPOOL_STATISTICS additionally gets a per component breakdown, which
+	CProcessPool prints to stderr as it is destroyed.
+
+	SDL 1.2 is still required, both to build and to run: the process pool
+	takes its threads, mutexes, timers and event queue from SDL, and the
+	display and audio are opened as usual, just on SDL's "dummy" drivers.
+	So no window system or sound device is needed, but the SDL library is.
+
+	Benchmark.dsp in the top level folder builds it under Windows, and
+	the Makefile alongside it on Linux and other POSIX machines that have
+	SDL 1.2 (with sdl-config) and zlib installed:
+
+		make benchmark
+
+*/
+
+#ifndef PROFILE
+#error "Benchmark.cpp needs PROFILE defined, otherwise the emulation is paced to real time"
+#endif
+
+#include "HostMachine/HostMachine.h"
+#include "ProcessPool.h"
+#include "ComponentBase.h"
+#include "SDL.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define CYCLES_PER_FIELD	39936
+
+/* returns true if any of the errors the emulator may post during startup
+has arrived, having reported it */
+static bool CheckForFailure()
+{
+	bool Failed = false;
+	SDL_Event ev;
+
+	while(SDL_PollEvent(&ev))
+	{
+		if(ev.type != SDL_USEREVENT) continue;
+
+		switch(ev.user.code)
+		{
+			default: break;
+			case PPDEBUG_SCREENFAILED:	GetHost()->DisplayError("Unable to create display");		Failed = true; break;
+			case PPDEBUG_OSFAILED:		GetHost()->DisplayError("Unable to load the OS ROM");		Failed = true; break;
+			case PPDEBUG_BASICFAILED:	GetHost()->DisplayError("Unable to load the BASIC ROM");	Failed = true; break;
+		}
+	}
+
+	return Failed;
+}
+
+int main(int argc, char *argv[])
+{
+	/* no window, no sound */
+	putenv((char *)"SDL_VIDEODRIVER=dummy");
+	putenv((char *)"SDL_AUDIODRIVER=dummy");
+	if(SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO | SDL_INIT_TIMER) < 0)
+	{
+		GetHost()->DisplayError("Unable to initialise SDL: %s", SDL_GetError());
+		return 1;
+	}
+	atexit(SDL_Quit);
+
+	GetHost()->RegisterArgs(argc, argv);
+
+	ElectronConfiguration Base;
+	Base.Display.AllowOverlay = false;
+	Base.Display.StartFullScreen = false;
+	Uint32 Frames = 500;
+
+	/* parse all program arguments to modify configuration */
+	int iptr = 1;
+	while(iptr < argc)
+	{
+		if(!strcmp(argv[iptr], "-frames") && iptr+1 < argc)
+			Frames = atoi(argv[++iptr]);
+		else
+		if(!strcmp(argv[iptr], "-roms") && iptr+1 < argc)
+			GetHost()->RegisterPath("%ROMPATH%", argv[++iptr]);
+		else
+		if(!strcmp(argv[iptr], "-plus1"))
+			Base.Plus1 = true;
+		else
+		if(!strcmp(argv[iptr], "-plus3"))
+			Base.Plus3.Enabled = true;
+		else
+		if(argv[iptr][0] == '-')
+		{
+			fprintf(stderr, "usage: %s [-frames n] [-roms path] [-plus1] [-plus3] [file ...]\n", argv[0]);
+			return 1;
+		}
+		iptr++;
+	}
+
+	if(!Frames || Frames > 0xffffffff / CYCLES_PER_FIELD)
+	{
+		GetHost()->DisplayError("Frame count must be between 1 and %u", 0xffffffff / CYCLES_PER_FIELD);
+		return 1;
+	}
+
+	CProcessPool *PPool = new CProcessPool( Base );
+	PPool->SetDebugFlags(PPDEBUG_SCREENFAILED | PPDEBUG_OSFAILED | PPDEBUG_BASICFAILED);
+	if(CheckForFailure())
+	{
+		delete PPool;
+		return 1;
+	}
+
+	/* load anything else requested */
+	iptr = 1;
+	while(iptr < argc)
+	{
+		if(!strcmp(argv[iptr], "-frames") || !strcmp(argv[iptr], "-roms"))
+			iptr++;
+		else
+		if(argv[iptr][0] != '-' && !PPool->Open(argv[iptr]))
+			GetHost()->DisplayWarning("Unable to open %s", argv[iptr]);
+		iptr++;
+	}
+
+	/* run emulation on this thread until the cycle limit is hit */
+	PPool->SetCycleLimit(Frames * CYCLES_PER_FIELD);
+	Uint32 StartTime = SDL_GetTicks();
+	PPool->Go(true);
+	Uint32 RunTime = SDL_GetTicks() - StartTime;
+
+	if(CheckForFailure())
+	{
+		delete PPool;
+		return 1;
+	}
+	if(!RunTime) RunTime = 1;
+
+	double Seconds = (double)RunTime / 1000.0;
+	printf("%u frames (%u cycles) in %0.3f seconds\n", Frames, Frames * CYCLES_PER_FIELD, Seconds);
+	printf("%0.3f emulated MHz, %0.1f frames/s, %0.1fx real time\n",
+		((double)Frames * CYCLES_PER_FIELD) / (Seconds * 1000000.0),
+		(double)Frames / Seconds,
+		(double)Frames / (Seconds * 50.0));
+
+	delete PPool;
+	return 0;
+}
@@ -9,7 +9,7 @@
 #define IOCTL_SETIRQ			1
 #define IOCTL_SETNMI			2
 #define IOCTL_SETRST			3
-#define IOCTL_SETCLOCKRATE		4
+#define IOCTL_SETCLOCKRATE		4	/* Parameter is a Uint32 * giving the speed emulation is paced to as a multiple of real time, 0 if unlimited */
 #define IOCTL_PAUSE				5
 #define IOCTL_UNPAUSE			6
 #define IOCTL_SUPERRESET		7
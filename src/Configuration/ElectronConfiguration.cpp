@@ -21,11 +21,19 @@ ElectronConfiguration::ElectronConfiguration()
 	GFXPath = NULL;
 	Autoload = Autoconfigure = true;
 	Plus3.Drive1WriteProtect = Plus3.Drive2WriteProtect = false;
+	Plus3.FastDisc = false;
 	Display.AllowOverlay = Display.DisplayMultiplexed = true;
 	Display.StartFullScreen = false;
 	Volume = 128;
+	Speed.Normal = 1;
+	Speed.Turbo = 0;
+	Speed.FrameSkip = 0;
+	Speed.Mute = false;
+	Rewind.Memory = 4096;
+	Rewind.Interval = 50;
 	Jim = false;
 	PersistentState = false;
+	StateCompression = 6;
 
 	int c = MAXNUM_EXTRAROMS;
 	while(c--)
@@ -95,10 +103,18 @@ bool ElectronConfiguration::operator !=(ElectronConfiguration &rvalue)
 	Compare(Plus3.Enabled);
 	Compare(Plus3.Drive1WriteProtect);
 	Compare(Plus3.Drive2WriteProtect);
+	Compare(Plus3.FastDisc);
 	Compare(Display.AllowOverlay);
 	Compare(Display.DisplayMultiplexed);
 	Compare(Display.StartFullScreen);
 	Compare(Volume);
+	Compare(Speed.Normal);
+	Compare(Speed.Turbo);
+	Compare(Speed.FrameSkip);
+	Compare(Speed.Mute);
+	Compare(Rewind.Memory);
+	Compare(Rewind.Interval);
+	Compare(StateCompression);
 #undef Compare
 #define Compare(sv)\
 	if(sv || rvalue.sv)\
@@ -127,12 +143,20 @@ void ElectronConfiguration::Read( BasicConfigurationStore * store )
 	Plus3.Enabled = store->ReadBool( "Plus3", false );
 	Plus3.Drive1WriteProtect = store->ReadBool("Drive1WriteProtect", false );
 	Plus3.Drive2WriteProtect = store->ReadBool("Drive2WriteProtect", false );
+	Plus3.FastDisc = store->ReadBool("FastDisc", false );
 	Display.AllowOverlay = store->ReadBool("AllowOverlay", false );
 	Display.DisplayMultiplexed = store->ReadBool("DisplayMultiplexed", true );
 	Display.StartFullScreen = store->ReadBool("StartFullScreen", false );
 	Volume = store->ReadInt( "Volume", 128 ); if(Volume < 0) Volume = 0; if(Volume > 255) Volume = 255;
+	Speed.Normal = store->ReadInt( "Speed", 1 ); if(Speed.Normal < 0) Speed.Normal = 1;
+	Speed.Turbo = store->ReadInt( "TurboSpeed", 0 ); if(Speed.Turbo < 0) Speed.Turbo = 0;
+	Speed.FrameSkip = store->ReadInt( "FrameSkip", 0 ); if(Speed.FrameSkip < 0) Speed.FrameSkip = 0;
+	Speed.Mute = store->ReadBool( "TurboMute", false );
+	Rewind.Memory = store->ReadInt( "RewindMemory", 4096 ); if(Rewind.Memory < 0) Rewind.Memory = 0;
+	Rewind.Interval = store->ReadInt( "RewindInterval", 50 ); if(Rewind.Interval < 1) Rewind.Interval = 1;
 	Jim = store->ReadBool("JimEnabled", false);
 	PersistentState = store->ReadBool("PersistentState", false);
+	StateCompression = store->ReadInt( "StateCompression", 6 ); if(StateCompression < 0) StateCompression = 0; if(StateCompression > 9) StateCompression = 9;
 
 	switch( store->ReadInt( "SloggerMRB", 0 ) )
 	{
@@ -167,16 +191,26 @@ void ElectronConfiguration::Write( BasicConfigurationStore * store )
 	store -> WriteBool( "Plus3", Plus3.Enabled );
 	store -> WriteBool( "Drive1WriteProtect", Plus3.Drive1WriteProtect);
 	store -> WriteBool( "Drive2WriteProtect", Plus3.Drive2WriteProtect);
+	store -> WriteBool( "FastDisc", Plus3.FastDisc);
 
 	store -> WriteBool( "AllowOverlay", Display.AllowOverlay );
 	store -> WriteBool( "DisplayMultiplexed", Display.DisplayMultiplexed);
 	store -> WriteBool( "StartFullScreen", Display.StartFullScreen );
 	
 	store -> WriteBool( "PersistentState", PersistentState);
+	store -> WriteInt( "StateCompression", StateCompression);
 	store -> WriteBool( "JimOn", Jim);
 
 	store -> WriteInt( "Volume", Volume);
 
+	store -> WriteInt( "Speed", Speed.Normal);
+	store -> WriteInt( "TurboSpeed", Speed.Turbo);
+	store -> WriteInt( "FrameSkip", Speed.FrameSkip);
+	store -> WriteBool( "TurboMute", Speed.Mute);
+
+	store -> WriteInt( "RewindMemory", Rewind.Memory);
+	store -> WriteInt( "RewindInterval", Rewind.Interval);
+
 	int sloggerMode;
 	switch( MRBMode )
 	{
@@ -34,12 +34,14 @@ public:
 
 	bool Jim;
 	bool PersistentState;
+	int StateCompression;	/* zlib level, 0 to 9, for saved states */
 
 	struct
 	{
 		bool Drive1WriteProtect;
 		bool Drive2WriteProtect;
 		bool Enabled;
+		bool FastDisc;	/* moves whole sectors when the DFS or ADFS ROM asks for them */
 	} Plus3;
 
 	struct
@@ -59,6 +61,19 @@ public:
 	} ExtraROMs[MAXNUM_EXTRAROMS];
 
 	int Volume;
+
+	struct
+	{
+		int Normal, Turbo;	/* as multiples of real time, 0 for as fast as possible */
+		int FrameSkip;		/* fields run per field drawn when not at 1x, 0 to pick automatically */
+		bool Mute;			/* silence audio when not at 1x, rather than speeding it up */
+	} Speed;
+
+	struct
+	{
+		int Memory;			/* kilobytes that may be used for rewinding, 0 to disable */
+		int Interval;		/* fields between captures */
+	} Rewind;
 	
 public:
 	ElectronConfiguration();	
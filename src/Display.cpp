@@ -22,28 +22,17 @@
 #include <stdlib.h>
 #include <memory.h>
 #include "6502.h"
-/*
-	In PAL terms, 52us of scanline time is visible, for 288 lines.
-	
-	Elk uses 256/288 lines, which is 8/9ths of total.
-	It also uses 40/52 us, which is 10/13ths of the total.
-
-	=> 9/8*10/13 = 45/52 of width should be used if display is full height
-*/
-#define CORRECT_W(w)	(w*45)/52
-
 CDisplay::CDisplay( ElectronConfiguration &cfg )
 {
 	const SDL_VideoInfo *DesktopInfo = SDL_GetVideoInfo();
 	NativeBytesPerPixel = DesktopInfo->vfmt->BytesPerPixel;
 
-	SetupCRCTable();
-
 	SDL_WM_SetCaption(WINDOW_TITLE, NULL);
 
 	DisplayTables = NULL;
 	MultiDisplayTables = NULL;
 	Overlay = NULL;
+	DrawSpan = &CDisplay::DrawSpan8;
 	FrameBuffer = NULL;
 	Surface = false;
 
@@ -70,6 +59,19 @@ CDisplay::CDisplay( ElectronConfiguration &cfg )
 
 	/* thread related stuff */
 	FrameBufferMutex = SDL_CreateMutex();
+	ExchangeMutex = SDL_CreateMutex();
+	FrameBuffers[0] = FrameBuffers[1] = FrameBuffers[2] = NULL;
+	ScreenValid = false;
+
+	NextStamp = 0;
+	for(int y = 0; y < 256; y++)
+	{
+		MarkLine(y);
+		LineSources[y] = 0xffffffff;
+		LineStates[y][0] = LineStates[y][1] = LineStates[y][2] = 0;
+		LinePages[y][0] = LinePages[y][1] = LinePages[y][2] = LinePages[y][3] = 0;
+	}
+	PreviousDirtyPages[0] = PreviousDirtyPages[1] = PreviousDirtyPages[2] = PreviousDirtyPages[3] = 0;
 }
 
 CDisplay::~CDisplay()
@@ -81,7 +83,9 @@ CDisplay::~CDisplay()
 #endif
 
 	if(Overlay) SDL_FreeYUVOverlay(Overlay);
+	FreeFrameBuffers();
 	SDL_DestroyMutex(FrameBufferMutex);
+	SDL_DestroyMutex(ExchangeMutex);
 	delete[] DisplayTables;
 	delete[] MultiDisplayTables;
 }
@@ -102,10 +106,21 @@ SDL_Surface * CDisplay::GetBufferCopy()
 	fmt.Bmask = 0x0000ff;
 #endif
 
-	newBuffer = SDL_ConvertSurface( GetFrontBuffer(), 
-		&fmt,
-		SDL_SWSURFACE);
-	ReleaseFrontBuffer();
+	/* take the picture straight from the most recent frame if possible,
+	otherwise settle for whatever is on screen */
+	SDL_mutexP(FrameBufferMutex);
+	if(!Overlay && FrameBuffers[0] && FrameValid[ShowBuffer])
+	{
+		newBuffer = SDL_CreateRGBSurface(SDL_SWSURFACE, 640, BackHeight, 24, fmt.Rmask, fmt.Gmask, fmt.Bmask, 0);
+		if(newBuffer)
+			Scaler.Draw(FrameBuffers[ShowBuffer], BackPitch, 640, BackHeight, FrameBuffer->format, newBuffer);
+	}
+	else
+		newBuffer = SDL_ConvertSurface( FrameBuffer, 
+			&fmt,
+			SDL_SWSURFACE);
+	SDL_mutexV(FrameBufferMutex);
+
 	return newBuffer;
 }
 
@@ -151,46 +166,12 @@ void CDisplay::Iconify(bool icon)
 	Icon = icon;
 //	printf("iconify %s\n", icon? "true": "false"); fflush(stdout);
 
-	if(!icon) /* implies window has been restored from minimised - clean frame buffer and set FrameBuffer for a full redraw */
+	if(!icon) /* implies window has been restored from minimised - have every buffer and then the screen redrawn in full */
 	{
 		GetSurface();
 
-		if(Overlay)
-		{
-			if(!SDL_LockYUVOverlay(Overlay))
-			{
-				for(int y = 0; y < Overlay->h; y++)
-				{
-					int x = Overlay->w;
-					while(x--)
-					{
-						switch(Overlay->format)
-						{
-							case SDL_UYVY_OVERLAY:
-								((Uint8 *)Overlay->pixels[0])[(y*Overlay->pitches[0]) + (x << 1)] = 128;
-								((Uint8 *)Overlay->pixels[0])[(y*Overlay->pitches[0]) + (x << 1) + 1] = 16;
-							break;
-
-							case SDL_YVYU_OVERLAY:
-							case SDL_YUY2_OVERLAY:
-								((Uint8 *)Overlay->pixels[0])[(y*Overlay->pitches[0]) + (x << 1)] = 16;
-								((Uint8 *)Overlay->pixels[0])[(y*Overlay->pitches[0]) + (x << 1) + 1] = 128;
-							break;
-						}
-					}
-				}
-
-				SDL_UnlockYUVOverlay(Overlay);
-			}
-		}
-
-		if(FrameBuffer)
-		{
-			SDL_FillRect(FrameBuffer, NULL, SDL_MapRGB(FrameBuffer->format, 0, 0, 0));
-			SDL_UpdateRect(FrameBuffer, 0, 0, 0, 0);
-		}
-
-		for(int y = 0; y < 256; y++) CRCBuffer[y] = 0;
+		FrameValid[0] = FrameValid[1] = FrameValid[2] = false;
+		ScreenValid = false;
 	}
 	else
 	{
@@ -280,6 +261,7 @@ void CDisplay::GetSurface()
 
 			TableEntryLength = 16;
 			TableShift = 3;
+			DrawSpan = &CDisplay::DrawSpanOverlay;
 
 			((Uint8 *)&Black)[YOffs1] = 16;
 			((Uint8 *)&Black)[YOffs1^1] = 128;
@@ -325,10 +307,10 @@ void CDisplay::GetSurface()
 
 				switch(FrameBuffer->format->BytesPerPixel)
 				{
-					case 1 : TableShift = 2; Black = 7; break;
-					case 2 : TableShift = 3; break;
-					case 3 :
-					case 4 : TableShift = 4; break;
+					case 1 : TableShift = 2; Black = 7;	DrawSpan = &CDisplay::DrawSpan8;	break;
+					case 2 : TableShift = 3;			DrawSpan = &CDisplay::DrawSpan16;	break;
+					case 3 : TableShift = 4;			DrawSpan = &CDisplay::DrawSpan24;	break;
+					case 4 : TableShift = 4;			DrawSpan = &CDisplay::DrawSpan32;	break;
 				}
 
 				DisplayTables = new Uint32[256 << TableShift];
@@ -373,6 +355,8 @@ void CDisplay::GetSurface()
 		ScaleTarget.w = CORRECT_W(FrameBuffer->w);
 		ScaleTarget.x = (FrameBuffer->w/2) - (ScaleTarget.w/2);
 
+		AllocateFrameBuffers();
+
 		Surface = true;
 		if ( DispFlags & SDL_FULLSCREEN )
 			SDL_ShowCursor(SDL_DISABLE);
@@ -395,8 +379,44 @@ void CDisplay::GetSurface()
 //		EndRestriction();
 }
 
+void CDisplay::AllocateFrameBuffers()
+{
+	SDL_mutexP(FrameBufferMutex);
+
+	/* buffers hold the 640x256 picture exactly as it will appear on the
+	overlay or, with lines doubled, on the frame buffer */
+	BackPitch = Overlay ? 1280 : FrameBuffer->format->BytesPerPixel*640;
+	BackHeight = Overlay ? 256 : 512;
+
+	for(int c = 0; c < 3; c++)
+	{
+		delete[] FrameBuffers[c];
+		FrameBuffers[c] = new Uint8[BackPitch*BackHeight];
+		FrameValid[c] = false;
+	}
+
+	DrawBuffer = 0;
+	ReadyBuffer = 1;
+	ShowBuffer = 2;
+	ScreenValid = false;
+
+	SDL_mutexV(FrameBufferMutex);
+}
+
+void CDisplay::FreeFrameBuffers()
+{
+	SDL_mutexP(FrameBufferMutex);
+	for(int c = 0; c < 3; c++)
+	{
+		delete[] FrameBuffers[c];
+		FrameBuffers[c] = NULL;
+	}
+	SDL_mutexV(FrameBufferMutex);
+}
+
 void CDisplay::FreeSurface()
 {
+	FreeFrameBuffers();
 	if(Overlay) { SDL_FreeYUVOverlay(Overlay); Overlay = NULL; }
 	delete[] DisplayTables; DisplayTables = NULL;
 	delete[] MultiDisplayTables; MultiDisplayTables = NULL;
@@ -485,9 +505,15 @@ void CDisplay::AttachTo(CProcessPool &pool, Uint32 id)
 //	printf("Gathersource: %d\nGathertarget: %d\n", (int)AddrSource, (int)VideoBuffer32); fflush(stdout);
 	((C6502 *)PPPtr->GetWellDefinedComponent(COMPONENT_CPU))->SetGathering(AddrSource, VideoBuffer32);
 	StartAddr = BackupStartAddr = FrameStartAddr = 0;
+	GatherLowAddr = 0;
 
 	memset(AddrSource, 0, sizeof(Uint16)*39936);
 	memset(VideoOffsets8, 0, sizeof(Uint16)*39936);
+	for(int y = 0; y < 256; y++)
+	{
+		MarkLine(y);
+		LineSources[y] = 0xffffffff;
+	}
 
 	GetSurface();
 }
@@ -496,6 +522,10 @@ void CDisplay::FillAddressTable(Uint8 Mode, int index)
 {
 	int startx, starty;
 	Uint16 Addr, LineAddr;
+	C6502 *CPU = (C6502 *)PPPtr->GetWellDefinedComponent(COMPONENT_CPU);
+
+	/* gathering is lazy, so get it up to date before the table changes under it */
+	CPU->FlushGathering();
 
 	/* determine start address if not at top of display - FIX ME */
 	if(index > DISPLAY_START)
@@ -533,6 +563,27 @@ void CDisplay::FillAddressTable(Uint8 Mode, int index)
 	int BaseIndex;
 	BaseIndex = ((starty+56) << 7) + PIXELS_OFFSET;
 
+	/* work out the lowest address this mode can fetch from, and tell the CPU */
+	Uint16 LowAddr;
+	switch(Mode)
+	{
+		default:
+		case 0 :
+		case 1 :
+		case 2 : LowAddr = 0x3000; break;
+		case 3 : LowAddr = 0x4000; break;
+		case 4 :
+		case 5 : LowAddr = 0x5800; break;
+		case 6 : LowAddr = 0x6000; break;
+	}
+	if(Addr && Addr < LowAddr) LowAddr = Addr;
+	if(LineAddr && LineAddr < LowAddr) LowAddr = LineAddr;
+
+	/* a change part way down the display still has the earlier part to account for */
+	if(index > DISPLAY_START && GatherLowAddr < LowAddr) LowAddr = GatherLowAddr;
+	GatherLowAddr = LowAddr;
+	CPU->SetGatherWindow(LowAddr);
+
 	/* EVOLVE ADDRESS FROM CURRENT POINT TO END OF FRAME BUFFER */
 	switch(Mode)
 	{
@@ -654,7 +705,55 @@ void CDisplay::FillAddressTable(Uint8 Mode, int index)
 			}
 		} break;
 	}
-	fflush(stdout);
+
+	MapLinePages(starty, index > DISPLAY_START);
+}
+
+/* works out which RAM pages each line from starty onward now reads, and
+marks any line that is showing something different from before. If Partial
+then starty keeps its earlier addresses up to the point of change */
+void CDisplay::MapLinePages(int starty, bool Partial)
+{
+	int Step = (AddrMode >= 4) ? 2 : 1;
+
+	for(int y = starty; y < 256; y++)
+	{
+		Uint16 *Offsets = &VideoOffsets8[((y+56) << 7) + PIXELS_OFFSET];
+		Uint32 Source = EmptyLine[y] ? 0x80000000 : (Offsets[0] | (AddrMode << 16));
+
+		if(Partial && (y == starty))
+			MarkLine(y);
+		else
+		{
+			if(Source != LineSources[y])
+				MarkLine(y);
+			LinePages[y][0] = LinePages[y][1] = LinePages[y][2] = LinePages[y][3] = 0;
+		}
+		LineSources[y] = Source;
+
+		if(!EmptyLine[y])
+			for(int x = 0; x < 80; x += Step)
+			{
+				int Page = (Offsets[x] >> 8)&127;
+				LinePages[y][Page >> 5] |= (Uint32)1 << (Page&31);
+			}
+	}
+}
+
+void CDisplay::MarkLine(int y)
+{
+	LineStamps[y] = ++NextStamp;
+}
+
+void CDisplay::SetLineState(int y, Uint32 State0, Uint32 State1, Uint32 State2)
+{
+	if((LineStates[y][0] != State0) || (LineStates[y][1] != State1) || (LineStates[y][2] != State2))
+	{
+		LineStates[y][0] = State0;
+		LineStates[y][1] = State1;
+		LineStates[y][2] = State2;
+		MarkLine(y);
+	}
 }
 
 void CDisplay::SetMode(Uint32 TimeStamp, Uint8 Mode)
@@ -3,10 +3,14 @@
 
 #include "ComponentBase.h"
 #include "ULA.h"
+#include "Scaler.h"
 
 /* could see one change per 4 cycles, => 9984 changes per frame, but this needs to be a power of 2 */
 #define CDISPLAY_VIDEOEVENT_LENGTH	16384
 
+/* flags a completed frame that hasn't yet been presented */
+#define CDISPLAY_FRAMEFRESH		4
+
 #define CDF_FULLSCREEN	1
 #define CDF_OVERLAY		2
 #define CDF_MULTIPLEXED	4
@@ -34,6 +38,16 @@ Burst 10 +- 1 cycles
 #define FRAME_TIME			(128*312)
 #define CLOCK_INTERRUPT		(155 << 7)
 
+/*
+	In PAL terms, 52us of scanline time is visible, for 288 lines.
+	
+	Elk uses 256/288 lines, which is 8/9ths of total.
+	It also uses 40/52 us, which is 10/13ths of the total.
+
+	=> 9/8*10/13 = 45/52 of width should be used if display is full height
+*/
+#define CORRECT_W(w)	(w*45)/52
+
 class CDisplay : public CComponentBase
 {
 	public:
@@ -64,10 +78,42 @@ class CDisplay : public CComponentBase
 
 		SDL_Surface * GetBufferCopy();
 
+		/* copies the most recently completed frame to the screen - for the
+		host thread to call upon receipt of PPDEBUG_FRAMEREADY */
+		void Present();
+
 	private:
-		/* for GUI */
+		/* for GUI and presentation - the emulation thread takes this only
+		to change surface, never to draw */
 		SDL_mutex *FrameBufferMutex;
 
+		/*
+
+			frames are drawn into three private buffers. The emulation
+			thread owns DrawBuffer, the host thread owns ShowBuffer and
+			ReadyBuffer holds the most recently completed frame, with
+			CDISPLAY_FRAMEFRESH set until the host has taken it. Each side swaps
+			its buffer with ReadyBuffer, so neither ever waits for the other
+
+		*/
+		Uint8 *FrameBuffers[3];
+		Uint32 FrameStamps[3][256];
+		bool FrameValid[3];
+		int BackPitch, BackHeight;
+		Uint32 DrawBuffer, ShowBuffer;
+		volatile Uint32 ReadyBuffer;
+		SDL_mutex *ExchangeMutex;
+		Uint32 ExchangeReady(Uint32 Buffer);
+		void AllocateFrameBuffers();
+		void FreeFrameBuffers();
+
+		/* stamps of the lines currently on screen */
+		Uint32 ScreenStamps[256];
+		volatile bool ScreenValid;
+
+		/* for screenshots and the GUI backdrop */
+		CScaler Scaler;
+
 		/* memory collection related */
 		Uint16 AddrSource[39936];
 		Uint16 VideoOffsets8[39936];
@@ -83,6 +129,17 @@ class CDisplay : public CComponentBase
 		int XOffset, YOffset;
 		int TableShift, TableEntryLength;
 
+		/* scanline drawing - the bytes for the current line are unscrambled
+		into LineBytes once, then turned into pixels by whichever DrawSpan
+		suits the surface, as chosen when the surface is created */
+		Uint8 LineBytes[80];
+		void (CDisplay::*DrawSpan)(Uint8 *&dptr1, Uint8 *&dptr2, int Index, Uint32 Count, int &lowpart);
+		void DrawSpan8(Uint8 *&dptr1, Uint8 *&dptr2, int Index, Uint32 Count, int &lowpart);
+		void DrawSpan16(Uint8 *&dptr1, Uint8 *&dptr2, int Index, Uint32 Count, int &lowpart);
+		void DrawSpan24(Uint8 *&dptr1, Uint8 *&dptr2, int Index, Uint32 Count, int &lowpart);
+		void DrawSpan32(Uint8 *&dptr1, Uint8 *&dptr2, int Index, Uint32 Count, int &lowpart);
+		void DrawSpanOverlay(Uint8 *&dptr1, Uint8 *&dptr2, int Index, Uint32 Count, int &lowpart);
+
 		/* Electron graphics mode related */
 		bool Icon;
 		void UpdateDisplay(bool Catchup);
@@ -137,13 +194,28 @@ class CDisplay : public CComponentBase
 
 		bool EmptyLine[256];
 
-		/* CRC related */
-		static Uint32 CRCTable[256];
-		Uint32 CRCBuffer[256];
-		void SetupCRCTable();
+		/*
+
+			dirty line tracking. Each line has a stamp that changes
+			whenever it may look different - because RAM it shows has
+			been written, because it now shows different RAM, because
+			the mode or palette it is drawn with has changed or because
+			events fall within it. Buffers and the screen remember the
+			stamp of each line they hold and only lines with a different
+			stamp are drawn or copied
+
+		*/
+		Uint32 LineStamps[256], NextStamp;
+		Uint32 LinePages[256][4], PreviousDirtyPages[4];
+		Uint32 LineSources[256];
+		Uint32 LineStates[256][3];
+		void MarkLine(int y);
+		void SetLineState(int y, Uint32 State0, Uint32 State1, Uint32 State2);
+		void MapLinePages(int starty, bool Partial);
 
 		/* start address */
 		Uint16 StartAddr, BackupStartAddr, FrameStartAddr;
+		Uint16 GatherLowAddr;
 
 		/* ULA */
 		CULA *ULA;
@@ -17,6 +17,10 @@
 #include "6502.h"
 #include <memory.h>
 
+#if !defined(__GNUC__) && defined(WIN32)
+#include <windows.h>
+#endif
+
 SDL_Surface *CDisplay::GetFrontBuffer()
 {
 	SDL_mutexP(FrameBufferMutex);
@@ -28,6 +32,140 @@ void CDisplay::ReleaseFrontBuffer()
 	SDL_mutexV(FrameBufferMutex);
 }
 
+/* swaps Buffer into ReadyBuffer, returning whatever was there before */
+Uint32 CDisplay::ExchangeReady(Uint32 Buffer)
+{
+#if defined(__GNUC__)
+	Uint32 Previous;
+	do
+		Previous = ReadyBuffer;
+	while(__sync_val_compare_and_swap(&ReadyBuffer, Previous, Buffer) != Previous);
+	return Previous;
+#elif defined(WIN32)
+	return (Uint32)InterlockedExchange((LONG *)&ReadyBuffer, (LONG)Buffer);
+#else
+	/* no atomic exchange to hand, but the lock is only ever held for this long */
+	SDL_mutexP(ExchangeMutex);
+		Uint32 Previous = ReadyBuffer;
+		ReadyBuffer = Buffer;
+	SDL_mutexV(ExchangeMutex);
+	return Previous;
+#endif
+}
+
+void CDisplay::Present()
+{
+	SDL_mutexP(FrameBufferMutex);
+
+	if(Icon || !FrameBuffers[0])
+	{
+		SDL_mutexV(FrameBufferMutex);
+		return;
+	}
+
+	/* a full redraw is needed after the screen has been disturbed */
+	bool Full = !ScreenValid;
+	ScreenValid = true;
+
+	if(ReadyBuffer&CDISPLAY_FRAMEFRESH)
+		ShowBuffer = ExchangeReady(ShowBuffer)&3;
+	else
+		if(!Full)
+		{
+			SDL_mutexV(FrameBufferMutex);
+			return;
+		}
+
+	if(!FrameValid[ShowBuffer])
+	{
+		/* nothing drawn yet - try again when the next frame arrives */
+		ScreenValid = false;
+		SDL_mutexV(FrameBufferMutex);
+		return;
+	}
+
+	/* work out which lines differ from those on screen */
+	Uint8 *Source = FrameBuffers[ShowBuffer];
+	Uint32 *Stamps = FrameStamps[ShowBuffer];
+	bool Dirty[257];
+
+	for(int y = 0; y < 256; y++)
+	{
+		Dirty[y] = Full || (Stamps[y] != ScreenStamps[y]);
+		ScreenStamps[y] = Stamps[y];
+	}
+	Dirty[256] = false;
+
+	if(Overlay)
+	{
+		if(!SDL_LockYUVOverlay(Overlay))
+		{
+			for(int y = 0; y < 256; y++)
+				if(Dirty[y])
+					memcpy((Uint8 *)Overlay->pixels[0] + y*Overlay->pitches[0], &Source[y*BackPitch], BackPitch);
+
+			SDL_UnlockYUVOverlay(Overlay);
+			SDL_DisplayYUVOverlay(Overlay, &ScaleTarget);
+		}
+		else
+			ScreenValid = false;
+	}
+	else
+	{
+		if(Full)
+			SDL_FillRect(FrameBuffer, NULL, SDL_MapRGB(FrameBuffer->format, 0, 0, 0));
+
+		if(!SDL_LockSurface(FrameBuffer))
+		{
+			Uint8 *Target = (Uint8 *)FrameBuffer->pixels + YOffset*FrameBuffer->pitch + XOffset*FrameBuffer->format->BytesPerPixel;
+
+			for(int y = 0; y < 256; y++)
+			{
+				if(Dirty[y])
+				{
+					memcpy(Target, &Source[(y << 1)*BackPitch], BackPitch);
+					memcpy(Target + FrameBuffer->pitch, &Source[((y << 1)+1)*BackPitch], BackPitch);
+				}
+				Target += FrameBuffer->pitch << 1;
+			}
+
+			SDL_UnlockSurface(FrameBuffer);
+
+			if(Full)
+				SDL_UpdateRect(FrameBuffer, 0, 0, 0, 0);
+			else
+			{
+				/* and now the runs of changed scanlines need to appear on display */
+				SDL_Rect Rects[128];
+				int NumRects = 0;
+				int StartY = 0, EndY = 0;
+				while(EndY < 512)
+				{
+					StartY = EndY;
+					while(!Dirty[StartY >> 1] && (StartY < 512)) StartY+=2;
+					if(StartY == 512) break;
+
+					EndY = StartY;
+					while(Dirty[EndY >> 1] && (EndY < 512)) EndY+=2;
+
+					Rects[NumRects].x = XOffset;
+					Rects[NumRects].y = YOffset+StartY;
+					Rects[NumRects].w = 640;
+					Rects[NumRects].h = EndY-StartY;
+					NumRects++;
+				}
+
+				if(NumRects)
+					SDL_UpdateRects(FrameBuffer, NumRects, Rects);
+			}
+		}
+		else
+			ScreenValid = false;
+	}
+
+	SDL_mutexV(FrameBufferMutex);
+}
+
 /*void CDisplay::RestrictDisplay(SDL_Rect targ)
 {
 	Restricted = true;
@@ -114,168 +252,139 @@ Uint32 CDisplay::Update(Uint32 CycleCount, bool Catchup)
 		return (312 << 7) - IScanline;
 }
 
-#define AddValueCRC(CRC, v) CRC = ((CRC << 8) | (v)) ^ CRCTable[CRC >> 24]
-#define AddValue32CRC(CRC, v)\
-	AddValueCRC(CRC, (v)&0xff);\
-	AddValueCRC(CRC, ((v) >> 8)&0xff);\
-	AddValueCRC(CRC, ((v) >> 16)&0xff);\
-	AddValueCRC(CRC, (v) >> 24)
-
 void CDisplay::NonAffectingDraw(SDL_Surface *Target)
 {
-	SDL_Surface *BackBuffer = NULL;
-	if((Target->w != 640) || (Target->h != 256))
-	{
-		BackBuffer = SDL_CreateRGBSurface(SDL_SWSURFACE, 640, 256, Target->format->BitsPerPixel, Target->format->Rmask, Target->format->Gmask, Target->format->Bmask, Target->format->Amask);
-	}
-	else
-		BackBuffer = Target;
-
-	/* now draw to BackBuffer */
-	SDL_LockSurface(BackBuffer);
-//	Uint8 *PelPtr = (Uint8 *)BackBuffer->pixels;
-	for(int y = 0; y < 256; y++)
-	{
-		for(int x = 0; x < 640; x++)
-		{
-			/* something */
-		}
-	}
+	/* scale the frame currently on screen to fit Target as it fits the
+	screen; overlay frames are YUV so there's nothing sensible to offer */
+	SDL_mutexP(FrameBufferMutex);
 
-	/* software scale from BackBuffer to Target */
-	if(BackBuffer != Target)
+	if(!Overlay && FrameBuffers[0] && FrameValid[ShowBuffer])
 	{
-		SDL_LockSurface(Target);
-
-		int SrcY = 0;
-		int AddX, AddY;
-
-		AddX = (BackBuffer->w << 16) / ScaleTarget.w;
-		AddY = (BackBuffer->h << 16) / ScaleTarget.h;
+		SDL_Rect Area;
+		Area.y = 0;
+		Area.h = Target->h;
+		Area.w = CORRECT_W(Target->w);
+		Area.x = (Target->w >> 1) - (Area.w >> 1);
 
-		switch(Target->format->BytesPerPixel)
-		{
-			case 1:{
-				Uint8 *PelLine = &((Uint8 *)Target->pixels)[ScaleTarget.y*Target->pitch + ScaleTarget.x];
-
-				int y = ScaleTarget.h;
-				while(y--)
-				{
-					Uint8 *SrcLine = &((Uint8 *)BackBuffer->pixels)[(SrcY >> 16) * BackBuffer->pitch];
-					int SrcX = 0;
-
-					int x = ScaleTarget.w;
-					while(x--)
-					{
-						*PelLine++ = SrcLine[SrcX >> 16];
-						SrcX += AddX;
-					}
-					PelLine += Target->pitch - ScaleTarget.w;
-					SrcY += AddY;
-				}
-			}break;
-
-			case 2:{
-				Uint16 *PelLine = (Uint16 *)&((Uint8 *)Target->pixels)[ScaleTarget.y*Target->pitch + (ScaleTarget.x << 1)];
-
-				int y = ScaleTarget.h;
-				while(y--)
-				{
-					Uint16 *SrcLine = (Uint16 *)&((Uint8 *)BackBuffer->pixels)[(SrcY >> 16) * BackBuffer->pitch];
-					int SrcX = 0;
+		Scaler.Draw(FrameBuffers[ShowBuffer], BackPitch, 640, BackHeight, FrameBuffer->format, Target, &Area);
+	}
 
-					int x = ScaleTarget.w;
-					while(x--)
-					{
-						*PelLine++ = SrcLine[SrcX >> 16];
-						SrcX += AddX;
-					}
-					PelLine = (Uint16 *)( (Uint8 *)PelLine + Target->pitch - (ScaleTarget.w << 1));
-					SrcY += AddY;
-				}
-			}break;
+	SDL_mutexV(FrameBufferMutex);
+}
 
-			case 3:{
-				Uint8 *PelLine = &((Uint8 *)Target->pixels)[ScaleTarget.y*Target->pitch + ScaleTarget.x*3];
+#define AccessVideo8(addr) ((Uint8 *)(VideoBuffer32))[((addr) << 2) + (VideoOffsets8[addr]&3)]
 
-				int y = ScaleTarget.h;
-				while(y--)
-				{
-					Uint8 *SrcLine = &((Uint8 *)BackBuffer->pixels)[(SrcY >> 16) * BackBuffer->pitch];
-					int SrcX = 0;
+/*
 
-					int x = ScaleTarget.w;
-					while(x--)
-					{
-						PelLine[0] = SrcLine[(SrcX >> 16)*3 + 0];
-						PelLine[1] = SrcLine[(SrcX >> 16)*3 + 1];
-						PelLine[2] = SrcLine[(SrcX >> 16)*3 + 2];
-						PelLine += 3;
-						SrcX += AddX;
-					}
-					PelLine += Target->pitch - (ScaleTarget.w*3);
-					SrcY += AddY;
-				}
-			}break;
+	span kernels for the non-multiplexed display. Each cycle is 8 output
+	pixels, i.e. TableEntryLength bytes of DisplayTables, and is written
+	to both output lines other than for an overlay. Index is the position
+	within LineBytes of the first cycle, so in the 40 byte modes ByteMask
+	causes each byte to be used twice and lowpart selects which half of
+	its table entry is wanted.
 
-			case 4:{
-				Uint32 *PelLine = (Uint32 *)&((Uint8 *)Target->pixels)[ScaleTarget.y*Target->pitch + (ScaleTarget.x << 2)];
+	Nothing here is vectorised as such - the tables have already done the
+	expansion to pixels, so all that is left is a copy per cycle. Copy16
+	just moves those 16 bytes with a single unaligned SSE2 load and store
+	where available
 
-				int y = ScaleTarget.h;
-				while(y--)
-				{
-					Uint32 *SrcLine = (Uint32 *)&((Uint8 *)BackBuffer->pixels)[(SrcY >> 16) * BackBuffer->pitch];
-					int SrcX = 0;
+*/
+#define Copy8(d, s)	((Uint32 *)(d))[0] = (s)[0]; ((Uint32 *)(d))[1] = (s)[1]
 
-					int x = ScaleTarget.w;
-					while(x--)
-					{
-						*PelLine++ = SrcLine[SrcX >> 16];
-						SrcX += AddX;
-					}
-					PelLine = (Uint32 *)( (Uint8 *)PelLine + Target->pitch - (ScaleTarget.w << 2));
-					SrcY += AddY;
-				}
-			}break;
-		}
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define Copy16(d, s)	_mm_storeu_si128((__m128i *)(d), _mm_loadu_si128((const __m128i *)(s)))
+#else
+#define Copy16(d, s)	Copy8(d, s); Copy8((d)+8, (s)+2)
+#endif
 
-		SDL_UnlockSurface(Target);
-		SDL_UnlockSurface(BackBuffer);
-		SDL_FreeSurface(BackBuffer);
-	}
-	else
-		SDL_UnlockSurface(BackBuffer);
+#define SpanKernel(name, Plot)\
+void CDisplay::name(Uint8 *&dptr1, Uint8 *&dptr2, int Index, Uint32 Count, int &lowpart)\
+{\
+	int lowmask = 1 << (TableShift-1);\
+	Uint8 *d1 = dptr1, *d2 = dptr2;\
+\
+	while(Count--)\
+	{\
+		const Uint32 *BasePtr = &DisplayTables[lowpart | (LineBytes[Index&ByteMask] << TableShift)];\
+		Plot;\
+		Index++;\
+		lowpart ^= lowmask;\
+	}\
+\
+	dptr1 = d1; dptr2 = d2;\
 }
 
-#define AccessVideo8(addr) ((Uint8 *)(VideoBuffer32))[((addr) << 2) + (VideoOffsets8[addr]&3)]
+SpanKernel(DrawSpan8,
+	Copy8(d1, BasePtr);
+	Copy8(d2, BasePtr);
+	d1 += 8; d2 += 8
+);
+
+SpanKernel(DrawSpan16,
+	Copy16(d1, BasePtr);
+	Copy16(d2, BasePtr);
+	d1 += 16; d2 += 16
+);
+
+SpanKernel(DrawSpan24,
+	Copy16(d1, BasePtr);
+	Copy16(d2, BasePtr);
+	Copy8(d1+16, BasePtr+4);
+	Copy8(d2+16, BasePtr+4);
+	d1 += 24; d2 += 24
+);
+
+SpanKernel(DrawSpan32,
+	Copy16(d1, BasePtr);
+	Copy16(d1+16, BasePtr+4);
+	Copy16(d2, BasePtr);
+	Copy16(d2+16, BasePtr+4);
+	d1 += 32; d2 += 32
+);
+
+/* overlays are always 2 bytes per pixel, and only one line is drawn */
+SpanKernel(DrawSpanOverlay,
+	Copy16(d1, BasePtr);
+	d1 += 16
+);
 
 void CDisplay::UpdateDisplay(bool Catchup)
 {
 	Uint8 *Pixels = NULL;
 	int Pitch = 0;
 
-	if(Icon || !FrameBuffer) Catchup = true;
+	if(Icon || !FrameBuffers[0]) Catchup = true;
 
 	if(!Catchup)
 	{
-		if(Overlay)
+		/* draw to the private buffer, only lines that differ from what it already holds */
+		Pixels = FrameBuffers[DrawBuffer];
+		Pitch = BackPitch;
+		Uint32 *Stamps = FrameStamps[DrawBuffer];
+		bool Redraw = !FrameValid[DrawBuffer];
+
+		/* anything showing RAM written this frame or last needs redrawing -
+		the latter because writes behind the raster only appear a frame later */
+		Uint32 DirtyPages[4];
+		((C6502 *)PPPtr->GetWellDefinedComponent(COMPONENT_CPU))->GetDirtyPages(DirtyPages);
+
+		int c = 4;
+		bool AnyDirty = false;
+		while(c--)
 		{
-			Catchup = SDL_LockYUVOverlay(Overlay) ? true : false;
-			Pixels = (Uint8 *)Overlay->pixels[0];
-			Pitch = Overlay->pitches[0];
+			Uint32 ThisFrame = DirtyPages[c];
+			DirtyPages[c] |= PreviousDirtyPages[c];
+			PreviousDirtyPages[c] = ThisFrame;
+			if(DirtyPages[c]) AnyDirty = true;
 		}
-		else
-		{
-			SDL_mutexP(FrameBufferMutex);
 
-			Catchup = SDL_LockSurface(FrameBuffer) ? true : false;
-			Pixels = (Uint8 *)FrameBuffer->pixels;
-			Pitch = FrameBuffer->pitch;
-		}
-	}
+		if(AnyDirty)
+			for(int y = 0; y < 256; y++)
+				if(	(LinePages[y][0]&DirtyPages[0]) | (LinePages[y][1]&DirtyPages[1]) |
+					(LinePages[y][2]&DirtyPages[2]) | (LinePages[y][3]&DirtyPages[3]))
+					MarkLine(y);
 
-	if(!Catchup)
-	{
 		/* enact all changes that occurred before pixels */
 		while(
 				(VideoWritePtr != VideoReadPtr) &&
@@ -287,12 +396,8 @@ void CDisplay::UpdateDisplay(bool Catchup)
 		FrameStart += DISPLAY_START;
 
 		Uint8 *bdptr1 = Pixels, *dptr1;
-
-		if(!Overlay) bdptr1 += YOffset*Pitch + XOffset;
-
 		Uint8 *bdptr2 = bdptr1 + Pitch, *dptr2;
 		int Addr;
-		bool Dirty[257];
 
 		for(int y = 0; y < 256; y++)
 		{
@@ -311,10 +416,11 @@ void CDisplay::UpdateDisplay(bool Catchup)
 				/* fill in empty line, but check here that the line is free of events! */
 				Uint32 Colour = EmptyLine[y] ? Black : BlankColour;
 
-				if(Colour != CRCBuffer[y])
+				SetLineState(y, 0x80000000, Colour, 0);
+
+				if(Redraw || (LineStamps[y] != Stamps[y]))
 				{	
-					CRCBuffer[y] = Colour;
-					Dirty[y] = true;
+					Stamps[y] = LineStamps[y];
 
 					if(Overlay)
 					{
@@ -376,8 +482,6 @@ void CDisplay::UpdateDisplay(bool Catchup)
 							}break;
 						}
 				}
-				else
-					Dirty[y] = false;
 
 				Addr += 128;
 
@@ -392,60 +496,24 @@ void CDisplay::UpdateDisplay(bool Catchup)
 			}
 			else
 			{
-				/* calculate CEC32 of palette + mode + bytes. Is it different? */
-				Uint32 NewCRC;
-				int c;
-
-				NewCRC = 0xffffffff;
-				AddValueCRC(NewCRC, CMode);
-
-				switch(CMode)
-				{
-					default:
-						AddValueCRC(NewCRC, PaletteBytes[0]);
-						AddValueCRC(NewCRC, PaletteBytes[1]);
-					break;
-
-					case 2 :
-						c = 8;
-						while(c--)
-							AddValueCRC(NewCRC, PaletteBytes[c]);
-					break;
-				}
-
-				c = 80;
-				if(DisplayMultiplexed)
-				{
-					while(c--)
-						AddValue32CRC(NewCRC, VideoBuffer32[c+Addr]);
-				}
-				else
+				/* has the mode or palette changed, or are there events within the line? */
+				SetLineState(y,
+					CMode | (DisplayMultiplexed ? 0x100 : 0),
+					PaletteBytes[0] | (PaletteBytes[1] << 8) | (PaletteBytes[2] << 16) | (PaletteBytes[3] << 24),
+					PaletteBytes[4] | (PaletteBytes[5] << 8) | (PaletteBytes[6] << 16) | (PaletteBytes[7] << 24));
+				if(EventThisLine)
+					MarkLine(y);
+
+				if(Redraw || (LineStamps[y] != Stamps[y]))
 				{
-					while(c--)
-						AddValueCRC(NewCRC, AccessVideo8(c+Addr));
-				}
+					Stamps[y] = LineStamps[y];
 
-				/* preview events */
-				Uint32 VideoPreviewPtr = VideoReadPtr;
-				while(	(VideoWritePtr != VideoPreviewPtr) &&
-						((Uint32)(VideoEventQueue[VideoPreviewPtr].TimeStamp - FrameStart) < 80)
-					)
-					{
-						AddValueCRC(NewCRC, (Uint32)(VideoEventQueue[VideoPreviewPtr].TimeStamp - FrameStart));
-						AddValueCRC(NewCRC, VideoEventQueue[VideoPreviewPtr].Value);
-						AddValueCRC(NewCRC, VideoEventQueue[VideoPreviewPtr].Address);
-						AddValueCRC(NewCRC, VideoEventQueue[VideoPreviewPtr].Type);
+					/* unscramble the line just once */
+					if(!DisplayMultiplexed)
+						for(int x = 0; x < 80; x++)
+							LineBytes[x] = AccessVideo8(x+Addr);
 
-						VideoPreviewPtr = (VideoPreviewPtr+1)&(CDISPLAY_VIDEOEVENT_LENGTH-1);
-					}
-
-				if(NewCRC != CRCBuffer[y])
-				{
-					Dirty[y] = true;
-					CRCBuffer[y] = NewCRC;
-
-					int lowpart, lowmask = (1 << (TableShift-1));
-					lowpart = 0;
+					int lowpart = 0;
 					Uint32 c = 80;
 					Uint32 CyclesToRun;
 
@@ -698,104 +766,8 @@ void CDisplay::UpdateDisplay(bool Catchup)
 						}
 						else
 						{
-							if(Overlay)
-							{
-								/* 2 bytes per pixel always... when on a machine that supports overlays check this! */
-								while(CyclesToRun--)
-								{
-									memcpy(dptr1, &DisplayTables[lowpart | (AccessVideo8(Addr&ByteMask) << TableShift)], TableEntryLength); dptr1 += TableEntryLength;
-									Addr++;
-									lowpart ^= lowmask;
-								}
-							}
-							else
-							{
-								/* TableEntryLength = bpp*8 */
-								switch(TableEntryLength)
-								{
-									default:
-										while(CyclesToRun--)
-										{
-											memcpy(dptr2, &DisplayTables[lowpart | (AccessVideo8(Addr&ByteMask) << TableShift)], TableEntryLength); dptr2 += TableEntryLength;
-											memcpy(dptr1, &DisplayTables[lowpart | (AccessVideo8(Addr&ByteMask) << TableShift)], TableEntryLength); dptr1 += TableEntryLength;
-											Addr++;
-											lowpart ^= lowmask;
-										}
-									break;
-
-									case 8:
-										while(CyclesToRun--)
-										{
-											Uint32 *BasePtr = &DisplayTables[lowpart | (AccessVideo8(Addr&ByteMask) << TableShift)];
-											((Uint32 *)dptr1)[0] = ((Uint32 *)dptr2)[0] = BasePtr[0];
-											((Uint32 *)dptr1)[1] = ((Uint32 *)dptr2)[1] = BasePtr[1];
-											dptr2 += 8;
-											dptr1 += 8;
-											Addr++;
-											lowpart ^= lowmask;
-										}
-									break;
-
-									case 16:
-										while(CyclesToRun--)
-										{
-											Uint32 *BasePtr = &DisplayTables[lowpart | (AccessVideo8(Addr&ByteMask) << TableShift)];
-											((Uint32 *)dptr1)[0] = ((Uint32 *)dptr2)[0] = BasePtr[0];
-											((Uint32 *)dptr1)[1] = ((Uint32 *)dptr2)[1] = BasePtr[1];
-											((Uint32 *)dptr1)[2] = ((Uint32 *)dptr2)[2] = BasePtr[2];
-											((Uint32 *)dptr1)[3] = ((Uint32 *)dptr2)[3] = BasePtr[3];
-											dptr2 += 16;
-											dptr1 += 16;
-											Addr++;
-											lowpart ^= lowmask;
-										}
-									break;
-
-									case 24:
-										while(CyclesToRun--)
-										{
-											Uint32 *BasePtr = &DisplayTables[lowpart | (AccessVideo8(Addr&ByteMask) << TableShift)];
-											((Uint32 *)dptr1)[0] = ((Uint32 *)dptr2)[0] = BasePtr[0];
-											((Uint32 *)dptr1)[1] = ((Uint32 *)dptr2)[1] = BasePtr[1];
-											((Uint32 *)dptr1)[2] = ((Uint32 *)dptr2)[2] = BasePtr[2];
-											((Uint32 *)dptr1)[3] = ((Uint32 *)dptr2)[3] = BasePtr[3];
-											((Uint32 *)dptr1)[4] = ((Uint32 *)dptr2)[4] = BasePtr[4];
-											((Uint32 *)dptr1)[5] = ((Uint32 *)dptr2)[5] = BasePtr[5];
-											dptr2 += 24;
-											dptr1 += 24;
-											Addr++;
-											lowpart ^= lowmask;
-										}
-									break;
-
-									case 32:
-										while(CyclesToRun--)
-										{
-											Uint32 *BasePtr = &DisplayTables[lowpart | (AccessVideo8(Addr&ByteMask) << TableShift)];
-											Addr++;
-											lowpart ^= lowmask;
-											((Uint32 *)dptr1)[0] = BasePtr[0];
-											((Uint32 *)dptr1)[1] = BasePtr[1];
-											((Uint32 *)dptr1)[2] = BasePtr[2];
-											((Uint32 *)dptr1)[3] = BasePtr[3];
-											((Uint32 *)dptr1)[4] = BasePtr[4];
-											((Uint32 *)dptr1)[5] = BasePtr[5];
-											((Uint32 *)dptr1)[6] = BasePtr[6];
-											((Uint32 *)dptr1)[7] = BasePtr[7];
-											dptr1 += 32;
-											((Uint32 *)dptr2)[0] = BasePtr[0];
-											((Uint32 *)dptr2)[1] = BasePtr[1];
-											((Uint32 *)dptr2)[2] = BasePtr[2];
-											((Uint32 *)dptr2)[3] = BasePtr[3];
-											((Uint32 *)dptr2)[4] = BasePtr[4];
-											((Uint32 *)dptr2)[5] = BasePtr[5];
-											((Uint32 *)dptr2)[6] = BasePtr[6];
-											((Uint32 *)dptr2)[7] = BasePtr[7];
-											dptr2 += 32;
-										}
-									break;
-								}
-							}
+							(this->*DrawSpan)(dptr1, dptr2, Addr&127, CyclesToRun, lowpart);
+							Addr += CyclesToRun;
 						}
 					}
 
@@ -812,8 +784,6 @@ void CDisplay::UpdateDisplay(bool Catchup)
 				}
 				else
 				{
-					Dirty[y] = false;
-
 					/* enact scanline events */
 					while( 
 							(VideoWritePtr != VideoReadPtr) &&
@@ -837,173 +807,21 @@ void CDisplay::UpdateDisplay(bool Catchup)
 			}
 		}
 
-		if(Overlay)
-		{
-			SDL_UnlockYUVOverlay(Overlay);
-			SDL_DisplayYUVOverlay(Overlay, &ScaleTarget);
-		}
-		else
-		{
-/*			if(BackBuffer)
-			{
-				SDL_LockSurface(FrameBuffer);
-
-				int SrcY = 0;
-				int AddX, AddY;
-
-				AddX = (BackBuffer->w << 16) / ScaleTarget.w;
-				AddY = (BackBuffer->h << 16) / ScaleTarget.h;
-
-				switch(FrameBuffer->format->BytesPerPixel)
-				{
-					case 1:{
-						Uint8 *PelLine = &((Uint8 *)FrameBuffer->pixels)[ScaleTarget.y*FrameBuffer->pitch + ScaleTarget.x];
-
-						int y = ScaleTarget.h;
-						while(y--)
-						{
-							Uint8 *SrcLine = &((Uint8 *)BackBuffer->pixels)[(SrcY >> 16) * BackBuffer->pitch];
-							int SrcX = 0;
-
-							int x = ScaleTarget.w;
-							while(x--)
-							{
-								*PelLine++ = SrcLine[SrcX >> 16];
-								SrcX += AddX;
-							}
-							PelLine += FrameBuffer->pitch - ScaleTarget.w;
-							SrcY += AddY;
-						}
-					}break;
-
-					case 2:{
-						Uint16 *PelLine = (Uint16 *)&((Uint8 *)FrameBuffer->pixels)[ScaleTarget.y*FrameBuffer->pitch + (ScaleTarget.x << 1)];
-
-						int y = ScaleTarget.h;
-						while(y--)
-						{
-							Uint16 *SrcLine = (Uint16 *)&((Uint8 *)BackBuffer->pixels)[(SrcY >> 16) * BackBuffer->pitch];
-							int SrcX = 0;
-
-							int x = ScaleTarget.w;
-							while(x--)
-							{
-								*PelLine++ = SrcLine[SrcX >> 16];
-								SrcX += AddX;
-							}
-							PelLine = (Uint16 *)( (Uint8 *)PelLine + FrameBuffer->pitch - (ScaleTarget.w << 1));
-							SrcY += AddY;
-						}
-					}break;
-
-					case 3:{
-						Uint8 *PelLine = &((Uint8 *)FrameBuffer->pixels)[ScaleTarget.y*FrameBuffer->pitch + ScaleTarget.x*3];
-
-						int y = ScaleTarget.h;
-						while(y--)
-						{
-							Uint8 *SrcLine = &((Uint8 *)BackBuffer->pixels)[(SrcY >> 16) * BackBuffer->pitch];
-							int SrcX = 0;
-
-							int x = ScaleTarget.w;
-							while(x--)
-							{
-								PelLine[0] = SrcLine[(SrcX >> 16)*3 + 0];
-								PelLine[1] = SrcLine[(SrcX >> 16)*3 + 1];
-								PelLine[2] = SrcLine[(SrcX >> 16)*3 + 2];
-								PelLine += 3;
-								SrcX += AddX;
-							}
-							PelLine += FrameBuffer->pitch - (ScaleTarget.w*3);
-							SrcY += AddY;
-						}
-					}break;
-
-					case 4:{
-						Uint32 *PelLine = (Uint32 *)&((Uint8 *)FrameBuffer->pixels)[ScaleTarget.y*FrameBuffer->pitch + (ScaleTarget.x << 2)];
-
-						int y = ScaleTarget.h;
-						while(y--)
-						{
-							Uint32 *SrcLine = (Uint32 *)&((Uint8 *)BackBuffer->pixels)[(SrcY >> 16) * BackBuffer->pitch];
-							int SrcX = 0;
-
-							int x = ScaleTarget.w;
-							while(x--)
-							{
-								*PelLine++ = SrcLine[SrcX >> 16];
-								SrcX += AddX;
-							}
-							PelLine = (Uint32 *)( (Uint8 *)PelLine + FrameBuffer->pitch - (ScaleTarget.w << 2));
-							SrcY += AddY;
-						}
-					}break;
-				}
-
-				SDL_UnlockSurface(FrameBuffer);
-				SDL_UpdateRect(FrameBuffer, 0, 0, 0, 0);
-				SDL_UnlockSurface(BackBuffer);
-				SDL_mutexV(FrameBufferMutex);
-			}
-			else
-			{*/
-
-				SDL_UnlockSurface(FrameBuffer);
+		/* publish the frame, taking whichever buffer was last published
+		in exchange. If that one was never presented then the host has yet
+		to respond to the previous notification, so needn't get another */
+		FrameValid[DrawBuffer] = true;
+		Uint32 Previous = ExchangeReady(DrawBuffer | CDISPLAY_FRAMEFRESH);
+		DrawBuffer = Previous&3;
 
-				/* and now UpdateRect calls are necessary to make sure all scanlines appear on
-				display */
-				int StartY = 0, EndY = 0;
-				while(EndY < 512)
-				{
-					StartY = EndY;
-					while(!Dirty[StartY >> 1] && (StartY < 512)) StartY+=2;
-					if(StartY == 512) break;
-
-					EndY = StartY;
-					while(Dirty[EndY >> 1] && (EndY < 512)) EndY+=2;
-
-					SDL_UpdateRect(FrameBuffer, XOffset, YOffset+StartY, 640, EndY-StartY);
-				}
-				SDL_mutexV(FrameBufferMutex);
-			//}
-		}
+		if(!(Previous&CDISPLAY_FRAMEFRESH))
+			PPPtr->DebugMessage(PPDEBUG_FRAMEREADY);
 	}
 	else
 	{
-		/* can't lock buffer - probably minimised or something. Just enact events for later */
+		/* no buffers - probably minimised or something. Just enact events for later */
 		while(VideoReadPtr != VideoWritePtr)
 			EnactEvent();
 		SumEvents();
 	}
 }
-
-/* CRC stuff */
-
-/* build CRCTable */
-Uint32 CDisplay::CRCTable[256];
-void CDisplay::SetupCRCTable()
-{
-	int bc;
-	Uint32 crctemp;
-
-	int c = 256;
-	while(c--)
-	{
-		crctemp = c << 24;
-		bc = 8;
-
-		while(bc--)
-		{
-			if(crctemp&0x80000000)
-			{
-				crctemp = (crctemp << 1) ^ 0x04c11db7; /*CRC 32 polynomial */
-			}
-			else
-			{
-				crctemp <<= 1;
-			}
-		}
-
-		CRCTable[c] = crctemp;
-	}
-}
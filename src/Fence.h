@@ -0,0 +1,39 @@
+#ifndef __FENCE_H
+#define __FENCE_H
+
+/*
+
+	Helpers for the single reader, single writer rings that pass things
+	between threads (key events, audio events). The writer fills in a slot
+	and only then publishes it by moving its index on with ReleaseStore;
+	the reader takes the index with AcquireLoad before looking at any slot
+	it covers. volatile alone stops the compiler caching the indices, but
+	says nothing about the order in which another processor sees the writes
+
+*/
+
+#include "SDL.h"
+
+#if defined(__GNUC__)
+#define MemoryFence()	__sync_synchronize()
+#elif defined(WIN32)
+#include <windows.h>
+#define MemoryFence()	{ LONG Fence; InterlockedExchange(&Fence, 0); }
+#else
+#error "No memory fence known for this compiler"
+#endif
+
+inline Uint32 AcquireLoad(volatile Uint32 &Index)
+{
+	Uint32 Value = Index;
+	MemoryFence();
+	return Value;
+}
+
+inline void ReleaseStore(volatile Uint32 &Index, Uint32 Value)
+{
+	MemoryFence();
+	Index = Value;
+}
+
+#endif
@@ -568,6 +568,16 @@ bool CGUI::Go()
 	/* get screen dimensions, generate two intermediate buffers */
 	int ScrW, ScrH;
 
+	/* keep the emulated display as a backdrop, before the page flipping mode loses it */
+	Front = Disp->GetFrontBuffer();
+	SDL_Surface *Backdrop = SDL_CreateRGBSurface(SDL_SWSURFACE, Front->w, Front->h, 32, 0xff0000, 0xff00, 0xff, 0);
+	Disp->ReleaseFrontBuffer();
+	if(Backdrop)
+	{
+		SDL_FillRect(Backdrop, NULL, 0);
+		Disp->IOCtl(DISPIOCTL_GETSCREEN, Backdrop, 0);
+	}
+
 	Disp->IOCtl(DISPIOCTL_GETDBUF, this, 0);
 
 	Front = Disp->GetFrontBuffer();
@@ -576,6 +586,11 @@ bool CGUI::Go()
 	Disp->ReleaseFrontBuffer();
 
 	StaticBuffer = OptimalSurface(ScrW, ScrH);
+	if(Backdrop)
+	{
+		SDL_BlitSurface(Backdrop, NULL, StaticBuffer, NULL);
+		SDL_FreeSurface(Backdrop);
+	}
 
 	MapResources();
 
@@ -643,16 +658,13 @@ bool CGUI::Go()
 		Disp->ReleaseFrontBuffer();
 		Disp->IOCtl(DISPIOCTL_FLIP, NULL, 0);
 
-		// pump events
-		SDL_PumpEvents();
-
 		// post any pending messages
 		while(MessagesPending--)
 			GUIObject->Message(&MessageQueue[MessagesPending]);
 		MessagesPending = 0;
 
 		// get latest interesting keys, etc
-		((CULA *)(PPool->GetWellDefinedComponent(COMPONENT_ULA)))->UpdateKeyTable();
+		((CULA *)(PPool->GetWellDefinedComponent(COMPONENT_ULA)))->UpdateKeyTable(true);
 
 		SDL_Event ev;
 		while(SDL_PollEvent(&ev))
@@ -675,6 +687,11 @@ bool CGUI::Go()
 			case SDL_APPMOUSEFOCUS:
 				HaveMouse = ev.active.gain ? true : false;
 			break;
+
+			case SDL_KEYDOWN:
+			case SDL_KEYUP:
+				((CULA *)(PPool->GetWellDefinedComponent(COMPONENT_ULA)))->PostKeyEvent(ev.key.keysym.sym, ev.type == SDL_KEYDOWN);
+			break;
 		}
 	}
 
@@ -0,0 +1,129 @@
+/*
+ *  HeadlessHostMachine.cpp
+ *  ElectrEm
+ *
+ *  A host with no user interface whatsoever - errors go to stderr, there
+ *  are no folder listings and configuration is never persisted. Used by
+ *  the benchmark build.
+ *
+ */
+#include "HostMachine.h"
+#include "../Configuration/ConfigurationStore.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "HeadlessHostMachine.h"
+
+static HeadlessHostMachine myHost;
+
+HostMachine * GetHost()
+{
+	return &myHost;
+}
+
+HeadlessHostMachine::HeadlessHostMachine()
+{
+}
+
+HeadlessHostMachine::~HeadlessHostMachine()
+{
+}
+
+char HeadlessHostMachine::DirectorySeparatorChar() const
+{
+#ifdef WIN32
+	return '\\';
+#else
+	return '/';
+#endif
+}
+
+int HeadlessHostMachine::MaxPathLength() const
+{
+	return 1024;
+}
+
+void HeadlessHostMachine::DisplayError(char *fmt, ...)
+{
+	va_list Arguments;
+
+	va_start(Arguments, fmt);
+	fputs("Error: ", stderr);
+	vfprintf(stderr, fmt, Arguments);
+	va_end(Arguments);
+	fputc('\n', stderr);
+}
+
+void HeadlessHostMachine::DisplayWarning(char *fmt, ...)
+{
+	va_list Arguments;
+
+	va_start(Arguments, fmt);
+	fputs("Warning: ", stderr);
+	vfprintf(stderr, fmt, Arguments);
+	va_end(Arguments);
+	fputc('\n', stderr);
+}
+
+FileDesc * HeadlessHostMachine::GetFolderContents(const char *)
+{
+	/* nobody is going to browse anything */
+	return NULL;
+}
+
+FileSpecs HeadlessHostMachine::GetSpecs(const char *name)
+{
+	FileSpecs spec;
+	struct stat fstats;
+
+	spec.Size = 0;
+	spec.Stats = FS_READONLY;
+	if(!stat(name, &fstats))
+	{
+		spec.Size = fstats.st_size;
+		spec.Stats = (fstats.st_mode&S_IWRITE) ? 0 : FS_READONLY;
+	}
+
+	return spec;
+}
+
+// Utility Functions
+void HeadlessHostMachine::RegisterArgs(int, char * argv[])
+{
+	/* GetExecutablePath trims back to the last separator, so make sure there is one */
+	static char RelativePath[] = "./electrem";
+	ExecutablePath = strchr(argv[0], '/') ? argv[0] : RelativePath;
+}
+
+#ifndef HOSTMACHINE_FILEONLY
+class NullConfigurationStore : public BasicConfigurationStore
+{
+public:
+	virtual bool ReadBool( const char *, bool defaultValue )	{ return defaultValue; }
+	virtual void WriteBool( const char *, bool )				{}
+
+	virtual int ReadInt( const char *, int defaultValue )		{ return defaultValue; }
+	virtual void WriteInt( const char *, int )					{}
+
+	virtual char * ReadString( const char *, const char * defaultValue )
+	{
+		return defaultValue ? strdup(defaultValue) : NULL;
+	}
+	virtual void WriteString( const char *, const char * )		{}
+
+	virtual void Flush()										{}
+};
+
+BasicConfigurationStore * HeadlessHostMachine::OpenConfigurationStore( const char * )
+{
+	return new NullConfigurationStore;
+}
+
+void HeadlessHostMachine::CloseConfigurationStore( BasicConfigurationStore * store )
+{
+	delete store;
+}
+#endif
@@ -0,0 +1,34 @@
+/*
+ *  HeadlessHostMachine.h
+ *  ElectrEm
+ *
+ *  A host with no user interface whatsoever - errors go to stderr, there
+ *  are no folder listings and configuration is never persisted. Used by
+ *  the benchmark build.
+ *
+ */
+
+class HeadlessHostMachine : public HostMachine
+{
+public:
+	HeadlessHostMachine();
+	virtual ~HeadlessHostMachine();
+
+	// File Wrangling
+	virtual FileDesc *GetFolderContents(const char *name);
+
+	// Utility Functions
+	virtual void RegisterArgs(int, char *[]);
+	virtual void DisplayError(char *fmt, ...);
+	virtual void DisplayWarning(char *fmt, ...);
+
+	virtual int MaxPathLength() const;
+	virtual char DirectorySeparatorChar() const;
+	virtual FileSpecs GetSpecs(const char *name);
+
+#ifndef HOSTMACHINE_FILEONLY
+	// Return a configuration store for the host machine. All settings read back as their defaults.
+	virtual BasicConfigurationStore * OpenConfigurationStore( const char * name );
+	virtual void CloseConfigurationStore( BasicConfigurationStore * store );
+#endif
+};
@@ -15,6 +15,7 @@
 */
 
 #include "ULA.h"
+#include "Fence.h"
 #include "zlib.h"
 #include "ProcessPool.h"
 #include <memory.h>
@@ -161,8 +162,10 @@ void CULA::SetDefaultKeyMap()
 		SetKey(SDLK_RALT, 0, 0);
 		SetKey(SDLK_ESCAPE, 13, 1);
 
-		/* reset & GUI */
+		/* reset, GUI, turbo & rewind */
 		SetKey(SDLK_F12, 15, 1);
+		SetKey(SDLK_F9, 14, 16);
+		SetKey(SDLK_F8, 14, 32);
 		#if !defined( MAC )
 			SetKey(SDLK_F10, 15, 1);
 			SetKey(SDLK_F11, 14, 2);
@@ -412,16 +415,131 @@ void CULA::EndKeySequence()
 {
 }
 
-void CULA::UpdateKeyTable()
+void CULA::PostKeyEvent(SDLKey Key, bool Down)
+{
+	if((Uint32)Key >= SDLK_LAST) return;
+
+	/* only releases of keys that went in as pressed are needed, and repeated presses add nothing */
+	Uint8 Bit = 1 << (Key&7);
+	if(Down == ((PostedKeys[Key >> 3]&Bit) ? true : false)) return;
+
+	/* a press is only queued if that leaves a free slot for every key that is
+	down, this one included, so that no release ever has to be dropped. If the
+	ULA has fallen this far behind then dropping a press is the least of
+	anyone's worries */
+	Uint32 Free = (AcquireLoad(KeyEventReadPtr) - KeyEventWritePtr - 1)&(CULA_KEYEVENT_LENGTH-1);
+	if(Down && Free <= NumPostedKeys+1) return;
+
+	/* the event takes effect a fixed number of emulated cycles after the
+	ULA's latest update, by which time the ULA will have been updated again */
+	KeyEvents[KeyEventWritePtr].Time = AcquireLoad(KeyTime) + CULA_KEYLATENCY;
+	KeyEvents[KeyEventWritePtr].Key = (Uint16)Key;
+	KeyEvents[KeyEventWritePtr].Down = Down;
+	ReleaseStore(KeyEventWritePtr, (KeyEventWritePtr+1)&(CULA_KEYEVENT_LENGTH-1));
+
+	PostedKeys[Key >> 3] ^= Bit;
+	if(Down) NumPostedKeys++; else NumPostedKeys--;
+}
+
+bool CULA::KeyHeld(Uint16 Key)
+{
+	int c = NumHeldKeys;
+	while(c--)
+		if(HeldKeys[c] == Key) return true;
+	return false;
+}
+
+/* returns true if the set of held keys has changed */
+bool CULA::ReadKeyEvents(bool AllEvents)
+{
+	bool Changed = false;
+
+	while(KeyEventReadPtr != AcquireLoad(KeyEventWritePtr))
+	{
+		KeyEvent &Event = KeyEvents[KeyEventReadPtr];
+
+		/* stop at the first event that isn't due yet - anything stamped further
+		off than the latency allows predates TotalTime restarting, so is due */
+		Uint32 Wait = Event.Time - TotalTime;
+		if(!AllEvents && (Sint32)Wait > 0 && Wait <= CULA_KEYLATENCY) break;
+
+		if(Event.Key < SDLK_LAST)
+		{
+			int c = NumHeldKeys;
+			while(c--)
+				if(HeldKeys[c] == Event.Key) break;
+
+			if(Event.Down)
+			{
+				if(c < 0 && NumHeldKeys < CULA_MAXHELDKEYS)
+				{
+					HeldKeys[NumHeldKeys++] = Event.Key;
+					Changed = true;
+				}
+			}
+			else
+			{
+				if(c >= 0)
+				{
+					HeldKeys[c] = HeldKeys[--NumHeldKeys];
+					Changed = true;
+				}
+			}
+		}
+
+		ReleaseStore(KeyEventReadPtr, (KeyEventReadPtr+1)&(CULA_KEYEVENT_LENGTH-1));
+	}
+
+	return Changed;
+}
+
+/* returns the number of cycles until the next queued key event is due */
+Uint32 CULA::NextKeyEvent()
+{
+	if(KeyEventReadPtr == AcquireLoad(KeyEventWritePtr))
+		return CYCLENO_ANY;
+
+	Uint32 Wait = KeyEvents[KeyEventReadPtr].Time - TotalTime;
+	return ((Sint32)Wait > 0 && Wait <= CULA_KEYLATENCY) ? Wait : 1;
+}
+
+/* rebuilds KeyboardState from the held PC keys */
+void CULA::MapHeldKeys()
+{
+	memset(KeyboardState, 0, 16);
+
+#if defined( MAC )
+	/* OS X: ignore anything done with the command key pressed */
+	if(KeyHeld(SDLK_LMETA) || KeyHeld(SDLK_RMETA)) return;
+#endif
+
+	/* first of all determine which modifiers are depressed */
+	Uint8 Modifiers = 0;
+	int c = NumHeldKeys;
+	while(c--)
+	{
+		if(KeyTables[0][HeldKeys[c]].Shift&0xf0)
+			Modifiers |= KeyTables[0][HeldKeys[c]].Shift >> 4;
+	}
+
+	/* now adjust KeyboardState */
+	c = NumHeldKeys;
+	while(c--)
+	{
+		KeyboardState[ KeyTables[ Modifiers ][HeldKeys[c]].Line ] |= KeyTables[ Modifiers ][HeldKeys[c]].Mask;
+		KeyboardState[ 13 ] |= KeyTables[ Modifiers ][HeldKeys[c]].Shift;
+	}
+}
+
+void CULA::UpdateKeyTable(bool AllEvents)
 {
 	Uint8 OldLine14 = KeyboardState[14];
-	SDL_PumpEvents();
-	Uint8 *KeyArray = SDL_GetKeyState(NULL);
+	bool HeldKeysChanged = ReadKeyEvents(AllEvents);
 
 	if(KeyProgram)
 	{
 		/* do an early quit if the user has Escape pressed */
-		if(KeyArray[SDLK_ESCAPE])
+		if(KeyHeld(SDLK_ESCAPE))
 		{
 			while(KeyProgram)
 			{
@@ -455,37 +573,14 @@ void CULA::UpdateKeyTable()
 				if(!KeyProgram) break;
 			}
 		}
-	}
-	else
-	{
-		memset(KeyboardState, 0, 16);
-
-#if defined( MAC )
-		/* OS X: ignore anything done with the command key pressed */
-		if(KeyArray[SDLK_LMETA] || KeyArray[SDLK_RMETA]) return;
-#endif
-
-		/* first of all determine which modifiers are depressed */
-		Uint8 Modifiers = 0;
-		int c = SDLK_LAST;
-		while(c--)
-		{
-			if(KeyArray[c] && KeyTables[0][c].Shift&0xf0)
-				Modifiers |= KeyTables[0][c].Shift >> 4;
-		}
 
-		/* now adjust KeyboardState */
-		c = SDLK_LAST;
-		while(c--)
-		{
-			if(KeyArray[c])
-			{
-				KeyboardState[ KeyTables[ Modifiers ][c].Line ] |= KeyTables[ Modifiers ][c].Mask;
-				KeyboardState[ 13 ] |= KeyTables[ Modifiers ][c].Shift;
-			}
-		}
+		/* hand the keyboard back to the user once the program is done */
+		if(!KeyProgram) HeldKeysChanged = true;
 	}
 
+	if(!KeyProgram && HeldKeysChanged)
+		MapHeldKeys();
+
 	/* check if any special key is being pressed */
 	if(KeyboardState[14]&1)
 		PPPtr->Message(PPM_QUIT); //quit
@@ -495,6 +590,10 @@ void CULA::UpdateKeyTable()
 		PPPtr->Message(PPM_FSTOGGLE); //fullscreen toggle (happens when key pressed)
 	if((OldLine14^KeyboardState[14])&KeyboardState[14]&2)
 		PPPtr->Message(PPM_GUI); //gui (happens when key pressed)
+	if((OldLine14^KeyboardState[14])&KeyboardState[14]&16)
+		PPPtr->Message(PPM_TURBOTOGGLE); //turbo toggle (happens when key pressed)
+	if((OldLine14^KeyboardState[14])&KeyboardState[14]&32)
+		PPPtr->Message(PPM_REWIND); //step back (happens when key pressed)
 
 	PPPtr->IOCtl(IOCTL_SETRST, (KeyboardState[15]&1) ? this : NULL, TotalTime); //reset
 }
@@ -31,6 +31,7 @@
 #include "Tape/Tape.h"
 
 #include <string.h>
+#include <stdlib.h>
 #include <malloc.h>
 
 #define GetBasicMemBase(v)\
@@ -119,10 +120,18 @@ int main(int argc, char *argv[])
 					Base.FastTape = true;
 				if(!strcmp(argv[iptr], "-slowtape"))
 					Base.FastTape = false;
+				if(!strcmp(argv[iptr], "-fastdisc"))
+					Base.Plus3.FastDisc = true;
+				if(!strcmp(argv[iptr], "-slowdisc"))
+					Base.Plus3.FastDisc = false;
 				if(!strcmp(argv[iptr], "-autoload"))
 					Base.Autoload = true;
 				if(!strcmp(argv[iptr], "-autoconfigure"))
 					Base.Autoconfigure = true;
+				if(!strcmp(argv[iptr], "-speed") && (iptr+1 < argc))
+					Base.Speed.Normal = atoi(argv[++iptr]);
+				if(!strcmp(argv[iptr], "-turbospeed") && (iptr+1 < argc))
+					Base.Speed.Turbo = atoi(argv[++iptr]);
 			}
 			iptr++;
 		}
@@ -137,7 +146,7 @@ int main(int argc, char *argv[])
 	CGUI *GUI;
 #endif	
 
-	PPool->SetDebugFlags(PPDEBUG_SCREENFAILED | PPDEBUG_GUI | PPDEBUG_FSTOGGLE | PPDEBUG_OSFAILED | PPDEBUG_BASICFAILED | PPDEBUG_KILLINSTR | PPDEBUG_UNKNOWNOP);
+	PPool->SetDebugFlags(PPDEBUG_SCREENFAILED | PPDEBUG_GUI | PPDEBUG_FSTOGGLE | PPDEBUG_OSFAILED | PPDEBUG_BASICFAILED | PPDEBUG_KILLINSTR | PPDEBUG_UNKNOWNOP | PPDEBUG_FRAMEREADY | PPDEBUG_SAVEFAILED);
 	PPool->IOCtl(IOCTL_SUPERRESET, NULL, 0);
 	/* parse all non-arguments (consider loading stuff) */
 	if(argc > 1)
@@ -199,6 +208,12 @@ int main(int argc, char *argv[])
 				Quit = true; 
 				break;
 
+			// key transitions are passed to the ULA as they happen
+			case SDL_KEYDOWN:
+			case SDL_KEYUP:
+				((CULA *)PPool->GetWellDefinedComponent(COMPONENT_ULA))->PostKeyEvent(ev.key.keysym.sym, ev.type == SDL_KEYDOWN);
+				break;
+
 			// this is the conduit through which information is passed back here from the
 			// emulation thread and through which the GUI invokes actions in the emulator
 			case SDL_USEREVENT:
@@ -239,57 +254,32 @@ int main(int argc, char *argv[])
 					// eject a Disc
 					case GUIEVT_EJECTDISC0:
 					case GUIEVT_EJECTDISC1:
-					{
-						PPool->Stop();
-						CWD1770 *Plus3 = (CWD1770 *)PPool->GetWellDefinedComponent(COMPONENT_PLUS3);
-						Plus3->Close(ev.user.code - GUIEVT_EJECTDISC0);
-						PPool->Go();
-					}
+						PPool->Command(PPCMD_EJECTDISC, NULL, ev.user.code - GUIEVT_EJECTDISC0);
 					break;
 
 					// insert a Disc - never autoloads!
 					case GUIEVT_INSERTDISC0:
 					case GUIEVT_INSERTDISC1:
-					{
-						PPool->Stop();
-						CWD1770 *Plus3 = (CWD1770 *)PPool->GetWellDefinedComponent(COMPONENT_PLUS3);
-						if(Plus3->Open((char *)ev.user.data1, ev.user.code - GUIEVT_INSERTDISC0) == WDOPEN_FAIL)
+						if(!PPool->Command(PPCMD_INSERTDISC, ev.user.data1, ev.user.code - GUIEVT_INSERTDISC0))
 							GetHost()->DisplayError("Unable to open disc image.");
 						free(ev.user.data1); ev.user.data1 = NULL;
-						PPool->Go();
-					}
 					break;
 
 					// insert Tape 
 					case GUIEVT_INSERTTAPE:
-					{
-						PPool->Stop();
-						CTape *Tape = (CTape *)PPool->GetWellDefinedComponent(COMPONENT_TAPE);
-						if(!Tape->Open((char *)ev.user.data1))
+						if(!PPool->Command(PPCMD_INSERTTAPE, ev.user.data1))
 							GetHost()->DisplayError("Unable to open tape image.");
 						free(ev.user.data1); ev.user.data1 = NULL;
-						PPool->Go();
-					}
 					break;
 
 					// eject Tape
 					case GUIEVT_EJECTTAPE:
-					{
-						PPool->Stop();
-						CTape *Tape = (CTape *)PPool->GetWellDefinedComponent(COMPONENT_TAPE);
-						Tape->Close();
-						PPool->Go();
-					}
+						PPool->Command(PPCMD_EJECTTAPE);
 					break;
 
 					// rewind Tape
 					case GUIEVT_REWINDTAPE:
-					{
-						PPool->Stop();
-						CTape *Tape = (CTape *)PPool->GetWellDefinedComponent(COMPONENT_TAPE);
-						Tape->IOCtl(TAPEIOCTL_REWIND);
-						PPool->Go();
-					}
+						PPool->Command(PPCMD_REWINDTAPE);
 					break;
 
 					// at the minute the only thing this is used for is squirting BASIC
@@ -311,7 +301,8 @@ int main(int argc, char *argv[])
 
 					// Save state
 					case GUIEVT_SAVESTATE:
-						PPool->SaveState( (char *)ev.user.data1 );
+						if(!PPool->SaveState( (char *)ev.user.data1 ))
+							GetHost() -> DisplayError("Unable to save state.");
 						free(ev.user.data1); ev.user.data1 = NULL;
 					break;
 
@@ -389,6 +380,11 @@ int main(int argc, char *argv[])
 						delete (ElectronConfiguration *)ev.user.data1; ev.user.data1 = NULL;
 					break;
 
+					// the emulation thread has finished a frame
+					case PPDEBUG_FRAMEREADY:
+						PPool->Display()->Present();
+					break;
+
 					// Quit the emulator
 					case PPDEBUG_USERQUIT: 
 						Quit = true; 
@@ -423,6 +419,11 @@ int main(int argc, char *argv[])
 						PPool->IOCtl(IOCTL_SUPERRESET);
 					break;
 
+					// Error event - a saved state couldn't be written
+					case PPDEBUG_SAVEFAILED:
+						GetHost() -> DisplayError("Unable to save state.");
+					break;
+
 #if !defined( USE_NATIVE_GUI ) && !defined(NO_GUI)
 					// Keypress actions
 					case PPDEBUG_GUI:
@@ -455,7 +456,10 @@ int main(int argc, char *argv[])
 
 	/* check for persistent state, attempt to save state if so... */
 	if(Base.PersistentState)
-		PPool->SaveState( "%HOMEPATH%/%DOT%electremstate.uef" );
+	{
+		if(!PPool->SaveState( "%HOMEPATH%/%DOT%electremstate.uef" ) || !PPool->StateSaved())
+			GetHost() -> DisplayError("Unable to save state.");
+	}
 
 	// stop emulation thread
 	PPool->Stop();
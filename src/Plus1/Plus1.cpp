@@ -23,7 +23,7 @@ CPlus1::CPlus1()
 	SDL_mutexP(PrinterFileMutex);
 	SDL_mutexV(PrinterFileMutex);
 	PrinterBufferPointer = 0;
-	ADCCyclesLeft = 0;
+	ADCReadyTime = 0;
 	ADCValue = 128;
 }
 
@@ -77,7 +77,7 @@ bool CPlus1::Write(Uint16 Addr, Uint32 TimeStamp, Uint8 Data8, Uint32 Data32)
 			}
 			
 			/* actually won't be ready for 40 us... which is 80 cycles on the 2 Mhz bus*/
-			ADCCyclesLeft = 80;
+			ADCReadyTime = TimeStamp + 80;
 		return true;
 	}
 
@@ -94,13 +94,10 @@ Uint8 CPlus1::GetADCButtons()
 	return 0x30;	/* active low! */
 }
 
-Uint32 CPlus1::Update(Uint32 TotalCycles, bool Catchup)
+Uint32 CPlus1::Update(Uint32, bool)
 {
-	if(ADCCyclesLeft > TotalCycles)
-		ADCCyclesLeft -= TotalCycles;
-	else
-		ADCCyclesLeft = 0;
-
+	/* the ADC is timed against the TimeStamps of reads and writes, so
+	there's nothing to do here */
 	return CYCLENO_ANY;
 }
 
@@ -110,7 +107,7 @@ bool CPlus1::Read(Uint16 Addr, Uint32 TimeStamp, Uint8 &Data8, Uint32 &Data32)
 	{
 		case 0xfc72:
 			/* status register */
-			Data8 = 0x3f | (ADCCyclesLeft ? 0x40 : 0);	/* printer is free, no fire buttons pressed, check ADC */
+			Data8 = 0x3f | (((Sint32)(ADCReadyTime - TimeStamp) > 0) ? 0x40 : 0);	/* printer is free, no fire buttons pressed, check ADC */
 		return true;
 		case 0xfc70:
 			Data8 = ADCValue;
@@ -37,7 +37,7 @@ class CPlus1: public CComponentBase
 		SDL_mutex *PrinterFileMutex;
 
 		/* ADC internal stuff */
-		Uint32 ADCCyclesLeft;
+		Uint32 ADCReadyTime;
 		Uint8 ADCValue;
 		Uint8 GetADCChannel(int channel);
 		Uint8 GetADCButtons();
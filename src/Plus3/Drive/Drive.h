@@ -5,6 +5,8 @@
 #include "../Helper/Helper.h"
 #include "fdi2raw/fdi2raw.h"
 
+class CUEFChunk;
+
 struct DriveEvent
 {
 	enum { INDEXHOLE, SECTOR } Type;
@@ -73,7 +75,24 @@ class CDrive
 		virtual void PutTrack(DriveTrack *);
 		virtual int GetTrackLength() = 0;
 
+		/* snapshot support - head position and rotation, followed by any
+		sectors modified since the disc was opened. Those are restored only
+		to the same disc, and on a write protected drive never make it back
+		to the image file. LocateEvent refills the data pointers, track and
+		side of a sector event on the current track, returning false if this
+		disc has no such sector */
+		void GetState(CUEFChunk *);
+		void SetState(CUEFChunk *, bool WriteProtected);
+		virtual bool LocateEvent(DriveEvent *);
+
 	protected:
+		/* dirty sectors are stored as 4 bytes identifying the disc they
+		belong to, a 2 byte count, then per sector a 2 byte index, 2 bytes
+		of length and the data itself. The identifier and index mean
+		whatever the subclass wants them to */
+		virtual void PutDirtySectors(CUEFChunk *);
+		virtual void GetDirtySectors(CUEFChunk *, bool WriteProtected);
+
 		bool IndexHoleFlag, DDen;
 		int IndexHoleCount;
 		Uint32 TrackOffset, CyclesPerRevolution;
@@ -103,14 +122,27 @@ class CDriveADF : public CDrive
 		/* type II interface */
 		void GetEvent(DriveEvent *);
 		void SetEventDirty();
+		bool LocateEvent(DriveEvent *);
 
 		/* type III interface, as far as ADF cares */
 		int GetTrackLength();
 
+	protected:
+		void PutDirtySectors(CUEFChunk *);
+		void GetDirtySectors(CUEFChunk *, bool WriteProtected);
+
 	private:
 		char *FName;
+
+		/* CRC of the image as opened, to recognise it in snapshots */
+		Uint32 DiscCRC;
 		bool gzip;
 		Uint8 Data[80*256*16*2];
+
+		/* one flag per 256 byte sector, and the sector most recently
+		returned by GetEvent, so that SetEventDirty knows which to mark */
+		bool SectorDirty[80*16*2];
+		Uint8 *EventData;
 		
 		unsigned int Sides, Sectors, DataLen, SectorLength, SectorLengthExponent;
 		bool Dirty, ReadOnly, DoubleDensity;
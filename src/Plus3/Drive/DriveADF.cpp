@@ -1,5 +1,6 @@
 #include "Drive.h"
 #include "../../HostMachine/HostMachine.h"
+#include "../../UEF.h"
 #include <memory.h>
 #include <malloc.h>
 
@@ -64,6 +65,8 @@
 CDriveADF::CDriveADF()
 {
 	FName = NULL;
+	EventData = NULL;
+	memset(SectorDirty, 0, sizeof(SectorDirty));
 }
 
 CDriveADF::~CDriveADF()
@@ -105,9 +108,12 @@ bool CDriveADF::Open(char *name)
 
 	TrackOffset = Track = 0;
 	Dirty = false;
+	memset(SectorDirty, 0, sizeof(SectorDirty));
+	EventData = NULL;
 
 	DataLen = gzread(Image, Data, 80*256*16*2);
 	gzclose(Image);
+	DiscCRC = crc32(crc32(0L, Z_NULL, 0), Data, DataLen);
 
 	/* now determine whether was gzip'd, and readonly state */
 	FileSpecs FS = GetHost() -> GetSpecs(FName);
@@ -203,7 +209,7 @@ void CDriveADF::GetEvent(DriveEvent *Ev)
 
 			Ev->CyclesToStart = ((DDEN_TRACKHEADER + DDEN_DATAOFFSET + (Ev->Sector*DDEN_SECTORLEN)) << 6) - TrackOffset;
 			Ev->CycleLength = SectorLength << 6;
-			Ev->Data8 = DataPtr8(Ev->Sector);
+			Ev->Data8 = EventData = DataPtr8(Ev->Sector);
 
 			Ev->CyclesPerByte = 64;
 		}
@@ -235,7 +241,7 @@ void CDriveADF::GetEvent(DriveEvent *Ev)
 
 			Ev->CyclesToStart = ((SDEN_TRACKHEADER + SDEN_DATAOFFSET + (Ev->Sector*SDEN_SECTORLEN)) << 7) - TrackOffset;
 			Ev->CycleLength = SectorLength << 7;
-			Ev->Data8 = DataPtr8(Ev->Sector);
+			Ev->Data8 = EventData = DataPtr8(Ev->Sector);
 
 			Ev->CyclesPerByte = 128;
 		}
@@ -254,6 +260,62 @@ void CDriveADF::GetEvent(DriveEvent *Ev)
 void CDriveADF::SetEventDirty()
 {
 	Dirty = true;
+	if(EventData)
+		SectorDirty[(EventData - Data) / SectorLength] = true;
+}
+
+bool CDriveADF::LocateEvent(DriveEvent *Ev)
+{
+	if(DDen != DoubleDensity || Ev->Sector >= Sectors || Ev->DataLength != SectorLength)
+		return false;
+
+	Ev->Track = Track;
+	Ev->Side = Side;
+	Ev->Data8 = EventData = DataPtr8(Ev->Sector);
+	return true;
+}
+
+void CDriveADF::PutDirtySectors(CUEFChunk *cnk)
+{
+	int Count = 0, c;
+	for(c = 0; c < 80*16*2; c++)
+		if(SectorDirty[c]) Count++;
+
+	cnk->Put32(DiscCRC);
+	cnk->Put16(Count);
+	for(c = 0; c < 80*16*2; c++)
+		if(SectorDirty[c])
+		{
+			cnk->Put16(c);
+			cnk->Put16(SectorLength);
+			cnk->Write(&Data[c*SectorLength], SectorLength);
+		}
+}
+
+void CDriveADF::GetDirtySectors(CUEFChunk *cnk, bool WriteProtected)
+{
+	/* sectors from some other disc are of no use to this one */
+	bool SameDisc = cnk->Get32() == DiscCRC;
+
+	int Count = cnk->Get16();
+	while(Count--)
+	{
+		unsigned int Index = cnk->Get16();
+		unsigned int Length = cnk->Get16();
+
+		if(SameDisc && Length == SectorLength && Index < 80*16*2)
+		{
+			cnk->Read(&Data[Index*SectorLength], SectorLength);
+			SectorDirty[Index] = true;
+
+			/* the emulated disc has them regardless, but the image file
+			is only rewritten if it could have been written to */
+			if(!WriteProtected && !ReadOnly)
+				Dirty = true;
+		}
+		else
+			cnk->ReadSeek(Length, SEEK_CUR);
+	}
 }
 
 int CDriveADF::GetLine(DriveLine d)
@@ -1,4 +1,5 @@
 #include "Drive.h"
+#include "../../UEF.h"
 
 /* Base Class */
 CDrive::~CDrive() {}
@@ -50,6 +51,56 @@ void CDrive::Update(Uint32 Cycles)
 void CDrive::PutEvent(DriveEvent *) {}
 bool CDrive::Open(char *) { return false; }
 
+void CDrive::GetState(CUEFChunk *cnk)
+{
+	cnk->PutC(Track);
+	cnk->PutC(TrackDir);
+	cnk->PutC(Side);
+	cnk->PutC((DDen ? 0x01 : 0) | (IndexHoleFlag ? 0x02 : 0));
+	cnk->Put32(IndexHoleCount);
+	cnk->Put32(TrackOffset);
+
+	PutDirtySectors(cnk);
+}
+
+void CDrive::SetState(CUEFChunk *cnk, bool WriteProtected)
+{
+	Track = cnk->GetC();
+	TrackDir = (Sint8)cnk->GetC();
+	Side = cnk->GetC();
+	int Flags = cnk->GetC();
+	DDen = (Flags&0x01) ? true : false;
+	IndexHoleFlag = (Flags&0x02) ? true : false;
+	IndexHoleCount = cnk->Get32();
+	TrackOffset = cnk->Get32();
+
+	/* the disc now in the drive needn't be the one that was there */
+	if(Track >= Tracks) Track = Tracks-1;
+	if(CyclesPerRevolution) TrackOffset %= CyclesPerRevolution;
+
+	GetDirtySectors(cnk, WriteProtected);
+}
+
+bool CDrive::LocateEvent(DriveEvent *) { return false; }
+
+void CDrive::PutDirtySectors(CUEFChunk *cnk)
+{
+	cnk->Put32(0);
+	cnk->Put16(0);
+}
+
+void CDrive::GetDirtySectors(CUEFChunk *cnk, bool)
+{
+	/* skip anything stored */
+	cnk->ReadSeek(4, SEEK_CUR);
+	int Count = cnk->Get16();
+	while(Count--)
+	{
+		cnk->ReadSeek(2, SEEK_CUR);
+		cnk->ReadSeek(cnk->Get16(), SEEK_CUR);
+	}
+}
+
 #define DDEN_IDAM		0x4489
 #define SDEN_HEADERMARK	0xf57e
 #define SDEN_DATAMARK	0xf56f
@@ -1,6 +1,10 @@
 #include "wd1770.h"
 #include "../ProcessPool.h"
+#include "../ULA.h"
+#include "../6502.h"
 #include "../HostMachine/HostMachine.h"
+#include "../UEF.h"
+#include <memory.h>
 
 #define ST_MOTORON		0x80
 #define ST_WPROTECT		0x40
@@ -13,6 +17,27 @@
 #define ST_DATAREQ		0x02
 #define ST_BUSY			0x01
 
+/*
+
+	Every wait within DoCommand is a point at which the controller stops
+	until enough time has passed. Each is named, the name is recorded in
+	Phase on the way in and a label is placed immediately after it, so that
+	UpdateTo can call back into DoCommand and have it pick up where it left
+	off. A restored snapshot resumes a command in just the same way
+
+*/
+enum
+{
+	WDPHASE_IDLE,
+
+	WDPHASE_T1START, WDPHASE_T1MOTOR, WDPHASE_T1SETUP, WDPHASE_T1SEEK,
+	WDPHASE_T1STEP, WDPHASE_T1VERIFY, WDPHASE_T1VERIFIED,
+
+	WDPHASE_T2START, WDPHASE_T2MOTOR, WDPHASE_T2SETTLE, WDPHASE_T2SEARCH,
+	WDPHASE_T2GAP, WDPHASE_T2DRQ, WDPHASE_T2PREAMBLE, WDPHASE_T2WRITE,
+	WDPHASE_T2READ
+};
+
 int CWD1770::Open(char *name, int drive)
 {
 	if(drive < 0 || drive > 1) return WDOPEN_FAIL;
@@ -45,11 +70,7 @@ int CWD1770::Open(char *name, int drive)
 	if(NewDrive)
 	{
 		/* ensure current disc is safely finished with! */
-		ForceInterrupt = true;
-		Update(1000, false);
-		CurrentTime -= 1000;
-		LastRun -= 1000;
-		ForceInterrupt = false;
+		Abort();
 
 		/* switch drives */
 		if(Drives[drive].Drive) delete Drives[drive].Drive;
@@ -76,44 +97,44 @@ bool CWD1770::IOCtl(Uint32 Control, void *Parameter, Uint32 TimeStamp)
 		default:
 		return CComponentBase::IOCtl(Control, Parameter, TimeStamp);
 		
+		case IOCTL_SETCONFIG_RESET:
 		case IOCTL_SETCONFIG:
 			Drives[0].ReadOnly = ((ElectronConfiguration *)Parameter)->Plus3.Drive1WriteProtect;
 			Drives[1].ReadOnly = ((ElectronConfiguration *)Parameter)->Plus3.Drive2WriteProtect;
+			UseFastDisc = ((ElectronConfiguration *)Parameter)->Plus3.FastDisc;
+			Shadow = ((ElectronConfiguration *)Parameter)->MRBMode == MRB_SHADOW;
+			SetTrapAddresses(UseFastDisc);
 		return false;
 	}
 }
 
 CWD1770::CWD1770(ElectronConfiguration &cfg)
 {
-	Quit = false;
-	GoSemaphore = SDL_CreateSemaphore(0);
-	StopSemaphore = SDL_CreateSemaphore(0);
-	MainEx = SDL_CreateThread(MainThreadHelper, this);
-	LastRun = CurrentTime = 0;
+	LastRun = 0;
 
 	CurrentDrive = &Drives[0];
 	Drives[0].Drive = new CDriveEmpty;
 	Drives[1].Drive = new CDriveEmpty;
 
 	NewCmmd = ForceInterrupt = IndexHoleInterrupt = false;
-	MotorOn = IdleTime = 0;
+	MotorOn = 0;
+
+	ActiveCommand = 0;
+	Phase = WDPHASE_IDLE;
+	IndexCount = BytePtr = WaitRemaining = 0;
+	memset(&CurSector, 0, sizeof(CurSector));
+	CurSector.Type = DriveEvent::INDEXHOLE;
 
 	Drives[0].ReadOnly = cfg.Plus3.Drive1WriteProtect;
 	Drives[1].ReadOnly = cfg.Plus3.Drive2WriteProtect;
+	UseFastDisc = cfg.Plus3.FastDisc;
+	Shadow = cfg.MRBMode == MRB_SHADOW;
 
 	Status = 0;
 }
 
 CWD1770::~CWD1770()
 {
-	Quit = true;
-	CyclesToRun = 1;
-
-	SDL_SemPost(GoSemaphore);
-	SDL_WaitThread(MainEx, NULL);
-	SDL_DestroySemaphore(GoSemaphore);
-	SDL_DestroySemaphore(StopSemaphore);
-
 	delete Drives[0].Drive;
 	delete Drives[1].Drive;
 }
@@ -127,6 +148,7 @@ void CWD1770::AttachTo(CProcessPool &pool, Uint32 id)
 	pool.ClaimTrapAddress(id, 0xfcc6, 0xffff);
 	pool.ClaimTrapAddress(id, 0xfcc7, 0xffff);
 	pool.ClaimTrapAddress(id, 0xfcc0, 0xffff);
+	SetTrapAddresses(UseFastDisc);
 
 	LastRun = 0;
 }
@@ -148,7 +170,8 @@ bool CWD1770::Write(Uint16 Addr, Uint32 TimeStamp, Uint8 D8, Uint32 D32)
 			}
 			else
 			{
-				Command = D8; NewCmmd = true;
+				Command = D8;
+				if(!FastSeek(D8)) NewCmmd = true;
 			}
 		break;
 		case 0xfcc5: if(!(Status&ST_BUSY)) Track = D8; break;
@@ -165,6 +188,17 @@ bool CWD1770::Write(Uint16 Addr, Uint32 TimeStamp, Uint8 D8, Uint32 D32)
 			CurrentDrive->Drive->SetLine(DL_DDEN, (Control&0x08)^0x08);
 			DDen = ((Control&0x08)^0x08) ? true : false;
 		break;
+
+		/* anything else is a fast disc trap address in paged ROM, which may be sideways RAM */
+		default:
+		{
+			C6502State CPUState;
+			C6502 *CPU = (C6502 *)PPPtr->GetWellDefinedComponent(COMPONENT_CPU);
+
+			CPU->GetState(CPUState);
+			CPU->WriteMem(CPUState.pc.a, Addr, D8, D32);
+		}
+		break;
 	}
 	return false;
 }
@@ -172,6 +206,20 @@ bool CWD1770::Write(Uint16 Addr, Uint32 TimeStamp, Uint8 D8, Uint32 D32)
 bool CWD1770::Read(Uint16 Addr, Uint32 TimeStamp, Uint8 &D8, Uint32 &D32)
 {
 //	fprintf(stderr, "w+ [%d/%d - %d]\n", TimeStamp, LastRun, TimeStamp-LastRun); fflush(stdout);
+	if(Addr < 0xfc00)
+	{
+		/* a fast disc trap address - the controller need only be consulted if this is an instruction fetch */
+		C6502State CPUState;
+		C6502 *CPU = (C6502 *)PPPtr->GetWellDefinedComponent(COMPONENT_CPU);
+
+		CPU->GetState(CPUState);
+		if(UseFastDisc && (CPUState.pc.a == Addr))
+			FastTransfer(Addr, TimeStamp);
+
+		CPU->ReadMem(CPUState.pc.a, Addr, D8, D32);
+		return false;
+	}
+
 	UpdateTo(TimeStamp);
 
 	switch(Addr)
@@ -193,63 +241,94 @@ bool CWD1770::Read(Uint16 Addr, Uint32 TimeStamp, Uint8 &D8, Uint32 &D32)
 	return false;
 }
 
-Uint32 CWD1770::Update(Uint32 TotalCycles, bool Catchup)
+Uint32 CWD1770::Update(Uint32, bool Catchup)
 {
-	CurrentTime += TotalCycles;
+	UpdateTo(((C6502 *)PPPtr->GetWellDefinedComponent(COMPONENT_CPU))->GetTotalCycles());
 	return CYCLENO_ANY;
 }
 
 void CWD1770::UpdateTo(Uint32 CycleTime)
 {
-	CyclesToRun = CycleTime - LastRun;
-	if(CyclesToRun >= IdleTime)
+	/* register accesses may already have brought things further than this */
+	if((Sint32)(CycleTime - LastRun) <= 0) return;
+
+	Uint32 CyclesToRun = CycleTime - LastRun;
+	LastRun = CycleTime;
+
+	while(1)
 	{
-//		fprintf(stderr, "To run: %d (to %d)\n", CyclesToRun, CycleTime); fflush(stderr);
-		LastRun = CycleTime;
-
-		/* signal main thread to continue for a bit */
-//		fprintf(stderr, "[updateto] semaphores: %08x %08x\npost go\n", GoSemaphore, StopSemaphore); fflush(stderr);
-		SDL_SemPost(GoSemaphore);
-		/* wait for it to finish */
-//		fprintf(stderr, "[updateto] wait stop\n"); fflush(stderr);
-		SDL_SemWait(StopSemaphore);
-//		fprintf(stderr, "[updateto] over\n"); fflush(stderr);
+		if(Phase != WDPHASE_IDLE)
+		{
+			/* a command is in flight - it continues once the wait it is in
+			has run its course, unless a force interrupt has ended it */
+			if(!ForceInterrupt)
+			{
+				if(WaitRemaining > CyclesToRun)
+				{
+					WaitRemaining -= CyclesToRun;
+					return;
+				}
+
+				CyclesToRun -= WaitRemaining;
+				WaitRemaining = 0;
+				if(DoCommand()) continue;
+			}
+			EndCommand();
+		}
+		else if(NewCmmd)
+		{
+//			fprintf(stderr, "[%d] WD go %02x d:%02x s:%02x t:%02x\n", LastRun, Command, Data8, Sector, Track);
+			ActiveCommand = Command;
+			ForceInterrupt = NewCmmd = false;
+			Status |= ST_BUSY;
+			if(!DoCommand()) EndCommand();
+		}
+		else
+		{
+			if(MotorOn)
+			{
+				Drives[0].Drive->Update(CyclesToRun);
+				Drives[1].Drive->Update(CyclesToRun);
+				MotorOn -= CurrentDrive->Drive->GetLine(DL_INDEXHOLECOUNT);
+				if(MotorOn < 0) MotorOn = 0;
+			}
+			return;
+		}
 	}
-//	else
-//	{
-//		if(!CyclesToRun)
-//			fprintf(stderr, "zero runner requested\n"); fflush(stderr);
-//	}
 }
 
-int CWD1770::MainThreadHelper(void *tptr)
+void CWD1770::EndCommand()
 {
-	return ((CWD1770 *)tptr)->MainThread();
+	Phase = WDPHASE_IDLE;
+	WaitRemaining = 0;
+	Status &= ~ST_BUSY;
+	CurrentDrive->Drive->SetLine(DL_INDEXHOLECOUNT, 0);
+//	fprintf(stderr, "[%d] WD done [st:%02x s:%02x t:%02x]\n", LastRun, Status, Sector, Track); fflush(stderr);
 }
 
 /* ACTUAL EMULATION FROM HERE DOWN */
-#define Break(mincycles)	\
-	IdleTime = mincycles;\
-	SDL_SemPost(StopSemaphore);\
-	SDL_SemWait(GoSemaphore);
-
-#define WaitCycles(n)	\
-if(!Quit && !ForceInterrupt)\
-{\
-	Drives[0].Drive->Update(n);\
-	Drives[1].Drive->Update(n);\
-	unsigned int nc = (n);\
-	while((nc > CyclesToRun) && !Quit && !ForceInterrupt)\
-	{\
-		nc -= CyclesToRun;\
-		Break(nc);\
-	}\
-	CyclesToRun -= nc;\
-	if(Quit || ForceInterrupt) return;\
-}
 
-#define WaitMs(n) WaitCycles(n*2)
-#define WaitBytes(n) WaitCycles(n << (DDen ? 6 : 7))
+/* DoCommand returns true when it has stopped to wait, leaving UpdateTo to
+call it again once WaitRemaining cycles have passed */
+#define WaitCycles(n, p)	\
+Phase = WDPHASE_##p;\
+if(ForceInterrupt) return false;\
+Drives[0].Drive->Update(n);\
+Drives[1].Drive->Update(n);\
+WaitRemaining = (n);\
+return true;\
+Resume_##p:
+
+#define ResumeAt(p)	case WDPHASE_##p: goto Resume_##p;
+
+#define WaitMs(n, p) WaitCycles(n*2, p)
+#define WaitBytes(n, p) WaitCycles(n << (DDen ? 6 : 7), p)
+
+/* GetSector is a macro rather than a function so that the wait it
+includes can return from DoCommand */
+#define GetSector(p)\
+	CurrentDrive->Drive->GetEvent(&CurSector);\
+	WaitCycles(CurSector.CyclesToStart, p)
 
 #define MOTOR_ON			0x08
 #define UPDATE_TRACK		0x10
@@ -268,72 +347,81 @@ if(!Quit && !ForceInterrupt)\
 /* TYPE II */
 #define WriteCommand(v)		((v)&0x20)
 
-#define CheckMotor()\
-	if((!(BCommand&MOTOR_ON)) && !MotorOn)\
+#define CheckMotor(p)\
+	if((!(ActiveCommand&MOTOR_ON)) && !MotorOn)\
 	{\
 		MotorOn = 9;\
-		int IndexCount = 0;\
-		while(!Quit && (IndexCount < 6))\
+		IndexCount = 0;\
+		while(IndexCount < 6)\
 		{\
-			GetSector();\
+			GetSector(p);\
 			if(CurSector.Type == DriveEvent::INDEXHOLE)\
 				IndexCount++;\
 		}\
 	}
 
-void CWD1770::GetSector()
+bool CWD1770::DoCommand()
 {
-	CurrentDrive->Drive->GetEvent(&CurSector);
-	WaitCycles(CurSector.CyclesToStart);
-}
+	int WaitTime;
+	switch(ActiveCommand&3)
+	{
+		default:
+		case 0: WaitTime = 6000; break;
+		case 1: WaitTime = 12000; break;
+		case 2: WaitTime = 20000; break;
+		case 3: WaitTime = 30000; break;
+	}
 
-void CWD1770::DoCommand()
-{
-	Uint8 BCommand = Command;
-	switch(BCommand >> 4)
+	if(Phase != WDPHASE_IDLE)
+	{
+		switch(Phase)
+		{
+			default: return false;
+
+			ResumeAt(T1START);	ResumeAt(T1MOTOR);	ResumeAt(T1SETUP);
+			ResumeAt(T1SEEK);	ResumeAt(T1STEP);	ResumeAt(T1VERIFY);
+			ResumeAt(T1VERIFIED);
+
+			ResumeAt(T2START);	ResumeAt(T2MOTOR);	ResumeAt(T2SETTLE);
+			ResumeAt(T2SEARCH);	ResumeAt(T2GAP);	ResumeAt(T2DRQ);
+			ResumeAt(T2PREAMBLE);	ResumeAt(T2WRITE);	ResumeAt(T2READ);
+		}
+	}
+
+	switch(ActiveCommand >> 4)
 	{
 		/* Type I commands */
 		case 0: case 1: case 2: case 3:
 		case 4: case 5: case 6: case 7:
 		{
-			int WaitTime;
-			switch(BCommand&3)
-			{
-				default:
-				case 0: WaitTime = 6000; break;
-				case 1: WaitTime = 12000; break;
-				case 2: WaitTime = 20000; break;
-				case 3: WaitTime = 30000; break;
-			}
-
 			/* set busy, reset crc, seek error, drq, intrq */
 			Status = (Status &~ (ST_CRCERROR | ST_NOTFOUND | ST_DATAREQ));
-			WaitCycles(16);
+			WaitCycles(16, T1START);
 
 			/* is h = 0? */
 			Status &= ~0x20;
-			CheckMotor();
+			CheckMotor(T1MOTOR);
 			Status |= 0x20;
 
 			/* if command is a step-in, set direction */
-			if(StepInCommand(BCommand))
+			if(StepInCommand(ActiveCommand))
 				CurrentDrive->Drive->SetLine(DL_DIRECTION, +1);
 
 			/* if command is a step-out, reset direction */
-			if(StepOutCommand(BCommand))
+			if(StepOutCommand(ActiveCommand))
 				CurrentDrive->Drive->SetLine(DL_DIRECTION, -1);
 
 			/* is command a restore? */
-			if(RestoreCommand(BCommand))
+			if(RestoreCommand(ActiveCommand))
 			{
 				Data8 = 0;
 				Track = 0xff;
 			}
 
-			WaitCycles(16);
+			WaitCycles(16, T1SETUP);
 
 			/* if a seek or restore, get looping */
-			if(SeekCommand(BCommand) || RestoreCommand(BCommand))
+			if(SeekCommand(ActiveCommand) || RestoreCommand(ActiveCommand))
 			{
 				while(1)
 				{
@@ -351,12 +439,12 @@ void CWD1770::DoCommand()
 					}
 
 					CurrentDrive->Drive->SetLine(DL_STEP, 1);
-					WaitCycles(WaitTime);
+					WaitCycles(WaitTime, T1SEEK);
 				}
 			}
 			else
 			{
-				if(BCommand&UPDATE_TRACK)
+				if(ActiveCommand&UPDATE_TRACK)
 					Track += CurrentDrive->Drive->GetLine(DL_DIRECTION);
 
 				if(CurrentDrive->Drive->GetLine(DL_TRACK0) && (CurrentDrive->Drive->GetLine(DL_DIRECTION) < 0))
@@ -364,16 +452,16 @@ void CWD1770::DoCommand()
 				else
 				{
 					CurrentDrive->Drive->SetLine(DL_STEP, 1);
-					WaitCycles(WaitTime);
+					WaitCycles(WaitTime, T1STEP);
 				}
 			}
 
-			if(BCommand&VERIFY)
+			if(ActiveCommand&VERIFY)
 			{
-				int IndexCount = 0;
+				IndexCount = 0;
 				while(IndexCount < 6)
 				{
-					GetSector();
+					GetSector(T1VERIFY);
 					if(CurSector.Type == DriveEvent::SECTOR)
 					{
 						if(CurSector.Track == Track)
@@ -393,7 +481,7 @@ void CWD1770::DoCommand()
 				else
 					Status |= ST_NOTFOUND;
 
-				WaitCycles(16);
+				WaitCycles(16, T1VERIFIED);
 			}
 
 			/* set track 0 flag if appropriate? */
@@ -405,83 +493,85 @@ void CWD1770::DoCommand()
 		case 8: case 9: case 10: case 11:
 		{
 			Status &= ~(ST_LOSTDATA | ST_NOTFOUND | 0x60);
-			WaitCycles(5);
+			WaitCycles(5, T2START);
 
 			/* is h = 0? */
-			CheckMotor();
+			CheckMotor(T2MOTOR);
 
 			/* check on e */
-			if(BCommand&SETTLING_DELAY)
-				WaitMs(30);
+			if(ActiveCommand&SETTLING_DELAY)
+			{
+				WaitMs(30, T2SETTLE);
+			}
 
 			/* loop: [4] */
-			int IndexHoles = 0;
-			while(!Quit)
+			IndexCount = 0;
+			while(1)
 			{
-				if(WriteCommand(BCommand))
+				if(WriteCommand(ActiveCommand))
 				{
 					/* check if write protect is on */
 					if(CurrentDrive->ReadOnly || CurrentDrive->Drive->GetLine(DL_WPROTECT))
 					{
 						Status |= ST_WPROTECT;
-						return;
+						return false;
 					}
 				}
 
 				/* [1] */
-				if(IndexHoles == 5)
+				if(IndexCount == 5)
 				{
 					Status |= ST_NOTFOUND;
-					return;
+					return false;
 				}
 
-				GetSector();
+				GetSector(T2SEARCH);
 				switch(CurSector.Type)
 				{
 					case DriveEvent::INDEXHOLE:
-						IndexHoles++;
-						if(IndexHoleInterrupt) return;
+						IndexCount++;
+						if(IndexHoleInterrupt) return false;
 					break;
 
 					case DriveEvent::SECTOR:
 						if((CurSector.Track == Track) && (CurSector.Sector == Sector))
 						{
-							unsigned int BytePtr = 0;
-
 							if(CurSector.HeadCRCCorrect)
 							{
 								Status &= ~ST_CRCERROR;
 
-								if(WriteCommand(BCommand))
+								if(WriteCommand(ActiveCommand))
 								{
 									// delay 2 bytes of gap
-									WaitBytes(2);
+									WaitBytes(2, T2GAP);
 
 									Status |= ST_DATAREQ;
 
-									WaitBytes(9);
+									WaitBytes(9, T2DRQ);
 
 									if(Status&ST_DATAREQ)
 									{
 										Status |= ST_LOSTDATA;
-										return;
+										return false;
 									}
 
 									/* combined stuff */
-									WaitBytes(DDen ? 24 : 7);
-
-									/* start CurSector filling */
-									CurSector.Deleted = (BCommand&WRITE_DELETED) ? true : false;
+									WaitBytes(DDen ? 24 : 7, T2PREAMBLE);
 
-									unsigned int WritePtr = 0;
+									/* start CurSector filling - the sector is marked dirty
+									up front so that a snapshot taken part way through
+									includes the bytes written so far */
+									CurSector.Deleted = (ActiveCommand&WRITE_DELETED) ? true : false;
+									CurrentDrive->Drive->SetEventDirty();
 
-									while(WritePtr < CurSector.DataLength)
+									BytePtr = 0;
+									while(BytePtr < CurSector.DataLength)
 									{
-										CurSector.Data8[WritePtr] = Data8;
-										WritePtr++;
+										CurSector.Data8[BytePtr] = Data8;
+										BytePtr++;
 										Status |= ST_DATAREQ;
 
-										WaitBytes(1);
+										WaitBytes(1, T2WRITE);
 
 										if(Status&ST_DATAREQ)
 										{
@@ -489,8 +579,6 @@ void CWD1770::DoCommand()
 											Data8 = 0;
 										}
 									}
-
-									CurrentDrive->Drive->SetEventDirty();
 								}
 								else
 								{
@@ -499,13 +587,14 @@ void CWD1770::DoCommand()
 									else
 										Status &= ~ST_DELRECORD;
 
+									BytePtr = 0;
 									while(BytePtr < CurSector.DataLength)
 									{
 										Data8 = CurSector.Data8[BytePtr];
 										BytePtr++;
 										Status |= ST_DATAREQ;
 
-										WaitCycles(CurSector.CyclesPerByte);
+										WaitCycles(CurSector.CyclesPerByte, T2READ);
 
 										if(Status&ST_DATAREQ)
 											Status |= ST_LOSTDATA;
@@ -514,7 +603,7 @@ void CWD1770::DoCommand()
 									if(!CurSector.DataCRCCorrect)
 									{
 										Status |= ST_CRCERROR;
-										return;
+										return false;
 									}
 								}
 							}
@@ -522,10 +611,10 @@ void CWD1770::DoCommand()
 								Status |= ST_CRCERROR;
 
 							/* [5] */
-							if(BCommand&MULTIPLE_SECTORS)
+							if(ActiveCommand&MULTIPLE_SECTORS)
 								Sector++;
 							else
-								return;
+								return false;
 						}
 					break;
 				}
@@ -538,42 +627,389 @@ void CWD1770::DoCommand()
 		case 12: case 14: case 15:
 		break;
 	}
+
+	return false;
 }
 
-int CWD1770::MainThread()
+/*
+
+	Snapshot support. Chunk &0402 holds, after the usual update byte:
+
+		status, track, sector, data, last command and drive control registers
+		the data shift register
+		flags: bit 0 = command pending, 1 = force interrupt, 2 = interrupt on index hole, 3 = double density
+		motor on count (index holes until the motor stops)
+
+	then the command in flight:
+
+		phase - which wait the controller is in, 0 if idle
+		command being executed
+		index hole count
+		2 bytes: byte pointer into the current sector
+		4 bytes: cycles the current wait has to run
+		4 bytes: cycles of it that have already run (always 0 as written
+		now, UpdateTo having been brought up to date first)
+
+		the most recent sector event: type, track, sector, side, flags (bit
+		0 = header CRC correct, 1 = data CRC correct, 2 = deleted data), 2
+		bytes of data length, the length exponent and 2 bytes of cycles per byte
+
+	and finally the state of each of the two drives, see CDrive::GetState
+
+*/
+void CWD1770::Abort()
 {
-	/* wait to be told to go for the first time */
-	SDL_SemWait(GoSemaphore);
+	/* drop any pending command and end any that is in the middle of happening */
+	NewCmmd = ForceInterrupt = false;
+	if(Phase != WDPHASE_IDLE) EndCommand();
+}
 
-	while(!Quit)
+void CWD1770::GetState(CUEFChunk *cnk, Uint32 TimeStamp)
+{
+	UpdateTo(TimeStamp);
+
+	cnk->PutC(0);			// 'update byte' - no updates!
+	cnk->PutC(Status);
+	cnk->PutC(Track);
+	cnk->PutC(Sector);
+	cnk->PutC(Data8);
+	cnk->PutC(Command);
+	cnk->PutC(Control);
+	cnk->PutC(DataShift8);
+	cnk->PutC(
+		(NewCmmd ? 0x01 : 0) |
+		(ForceInterrupt ? 0x02 : 0) |
+		(IndexHoleInterrupt ? 0x04 : 0) |
+		(DDen ? 0x08 : 0));
+	cnk->PutC(MotorOn);
+
+	/* command in flight */
+	cnk->PutC(Phase);
+	cnk->PutC(ActiveCommand);
+	cnk->PutC(IndexCount);
+	cnk->Put16(BytePtr);
+	cnk->Put32(WaitRemaining);
+	cnk->Put32(0);
+
+	cnk->PutC((CurSector.Type == DriveEvent::SECTOR) ? 1 : 0);
+	cnk->PutC(CurSector.Track);
+	cnk->PutC(CurSector.Sector);
+	cnk->PutC(CurSector.Side);
+	cnk->PutC(
+		(CurSector.HeadCRCCorrect ? 0x01 : 0) |
+		(CurSector.DataCRCCorrect ? 0x02 : 0) |
+		(CurSector.Deleted ? 0x04 : 0));
+	cnk->Put16(CurSector.DataLength);
+	cnk->PutC(CurSector.DataLengthExponent);
+	cnk->Put16(CurSector.CyclesPerByte);
+
+	/* drives */
+	Drives[0].Drive->GetState(cnk);
+	Drives[1].Drive->GetState(cnk);
+}
+
+void CWD1770::SetState(CUEFChunk *cnk, Uint32 TimeStamp)
+{
+	/* whatever was going on before is of no further interest */
+	Abort();
+
+	/* update byte */
+	cnk->ReadSeek(1, SEEK_CUR);
+
+	Status = cnk->GetC();
+	Track = cnk->GetC();
+	Sector = cnk->GetC();
+	Data8 = cnk->GetC();
+	Command = cnk->GetC();
+	Control = cnk->GetC();
+	DataShift8 = cnk->GetC();
+
+	Uint8 Flags = cnk->GetC();
+	bool PendingCmmd = (Flags&0x01) ? true : false;
+	ForceInterrupt = (Flags&0x02) ? true : false;
+	IndexHoleInterrupt = (Flags&0x04) ? true : false;
+	DDen = (Flags&0x08) ? true : false;
+	MotorOn = cnk->GetC();
+
+	CurrentDrive = (Control&0x02) ? &Drives[1] : &Drives[0];
+
+	/* command in flight */
+	int SavedPhase = cnk->GetC();
+	ActiveCommand = cnk->GetC();
+	IndexCount = cnk->GetC();
+	BytePtr = cnk->Get16();
+	Uint32 Wait = cnk->Get32();
+	Uint32 Elapsed = cnk->Get32();
+
+	CurSector.Type = cnk->GetC() ? DriveEvent::SECTOR : DriveEvent::INDEXHOLE;
+	CurSector.Track = cnk->GetC();
+	CurSector.Sector = cnk->GetC();
+	CurSector.Side = cnk->GetC();
+	Flags = cnk->GetC();
+	CurSector.HeadCRCCorrect = (Flags&0x01) ? true : false;
+	CurSector.DataCRCCorrect = (Flags&0x02) ? true : false;
+	CurSector.Deleted = (Flags&0x04) ? true : false;
+	CurSector.DataLength = cnk->Get16();
+	CurSector.DataLengthExponent = cnk->GetC();
+	CurSector.CyclesPerByte = cnk->Get16();
+	CurSector.Data8 = NULL;
+	CurSector.Data32 = NULL;
+
+	/* drives */
+	Drives[0].Drive->SetState(cnk, Drives[0].ReadOnly);
+	Drives[1].Drive->SetState(cnk, Drives[1].ReadOnly);
+
+	/* the sector contents come from whatever disc is now in the drive, so
+	if it can't supply them the command can only fail */
+	if(SavedPhase != WDPHASE_IDLE && CurSector.Type == DriveEvent::SECTOR)
 	{
-		if(NewCmmd)
+		if(!CurrentDrive->Drive->LocateEvent(&CurSector))
 		{
-//			fprintf(stderr, "[%d] WD go %02x d:%02x s:%02x t:%02x\n", LastRun, Command, Data8, Sector, Track);
-			ForceInterrupt = NewCmmd = false;
-			Status |= ST_BUSY;
-			DoCommand();
-			Status &= ~ST_BUSY;
-			CurrentDrive->Drive->SetLine(DL_INDEXHOLECOUNT, 0);
-//			fprintf(stderr, "[%d] WD done [st:%02x s:%02x t:%02x]\n", LastRun, Status, Sector, Track); fflush(stderr);
+			Status = (Status&~ST_BUSY) | ST_NOTFOUND;
+			SavedPhase = WDPHASE_IDLE;
 		}
-		else
+	}
+
+	/* the command picks up where it was once the outstanding part of its
+	wait has elapsed */
+	Phase = SavedPhase;
+	NewCmmd = PendingCmmd;
+	WaitRemaining = (Phase != WDPHASE_IDLE && Elapsed < Wait) ? Wait - Elapsed : 0;
+	LastRun = TimeStamp;
+}
+
+/*
+
+	Fast disc. Type I commands are carried out the moment they are written,
+	with no stepping or spin up time. Type II commands are left to the
+	controller, but a trap is placed at the top of each of the sector
+	transfer loops in the DFS and ADFS ROMs. If a single sector read or
+	write is about to begin when one of those is reached, the sector is
+	copied directly and the command ends at once, leaving the loop to see
+	a completed command on its next status read.
+
+	All of this happens only for discs that LocateEvent can find sectors on,
+	i.e. standard ADF/ADL/SSD/DSD images with the density the controller is
+	set to. Anything else, including copy protected FDIs, gets the real
+	controller.
+
+*/
+
+/* each loop begins by polling the status register. Signature is what should
+be found at Addr, to be sure that the expected ROM is paged in, Pointer is the
+zero page address the loop stores to or loads from with (zp),Y and, for ADFS,
+Handler is the byte handler it should be calling through &0D10. Partial loops
+move only the first X bytes of the sector, the rest being discarded on a read
+or zero on a write. NextPage loops increment the high byte of Pointer when Y
+wraps */
+static const struct FastDiscLoop
+{
+	Uint16 Addr;
+	bool Write, Partial, NextPage;
+	Uint8 Pointer;
+	Uint16 Handler;
+	Uint8 Signature[12];
+} FastDiscLoops[] =
+{
+	/* ADFS (E00) */
+	{0x83e5, false, false, false, 0xce, 0x8401, {0xad, 0xc4, 0xfc, 0x6a, 0x90, 0xf2, 0x6a, 0x90, 0xf7, 0xad, 0xc7, 0xfc}},
+	{0x83cb, true, false, false, 0xce, 0x8407, {0xad, 0xc4, 0xfc, 0x6a, 0x90, 0x0c, 0x6a, 0x90, 0xf7, 0x8e, 0xc7, 0xfc}},
+
+	/* DFS (E00, 2.20) */
+	{0x8f67, false, false, true, 0xb8, 0, {0xad, 0xc4, 0xfc, 0x6a, 0x90, 0x0f, 0x6a, 0x90, 0xf7, 0xad, 0xc7, 0xfc}},
+	{0x8f83, false, true, false, 0xb8, 0, {0xad, 0xc4, 0xfc, 0x6a, 0x90, 0xf3, 0x6a, 0x90, 0xf7, 0xad, 0xc7, 0xfc}},
+	{0x8fa7, true, false, true, 0xb8, 0, {0xad, 0xc4, 0xfc, 0x6a, 0x90, 0xcf, 0x6a, 0x90, 0xf7, 0xb1, 0xb8, 0x8d}},
+	{0x8fbc, true, true, false, 0xb8, 0, {0xad, 0xc4, 0xfc, 0x6a, 0x90, 0xba, 0x6a, 0x90, 0xf7, 0xb1, 0xb8, 0x8d}}
+};
+#define NUM_FASTDISCLOOPS	(sizeof(FastDiscLoops) / sizeof(FastDiscLoops[0]))
+
+void CWD1770::SetTrapAddresses(bool Enabled)
+{
+	unsigned int c;
+
+	/* unclaim all */
+	for(c = 0; c < NUM_FASTDISCLOOPS; c++)
+		PPPtr->ReleaseTrapAddress(PPNum, FastDiscLoops[c].Addr);
+
+	if(Enabled)
+	{
+		/* claim */
+		for(c = 0; c < NUM_FASTDISCLOOPS; c++)
+			PPPtr->ClaimTrapAddress(PPNum, FastDiscLoops[c].Addr);
+	}
+}
+
+bool CWD1770::FastSeek(Uint8 Cmmd)
+{
+	/* type I commands only, and only if nothing else is going on */
+	if(!UseFastDisc || (Cmmd&0x80) || (Status&ST_BUSY) || NewCmmd)
+		return false;
+
+	DriveEvent Probe;
+	Probe.Sector = 0;
+	Probe.DataLength = 256;
+	if(!CurrentDrive->Drive->LocateEvent(&Probe))
+		return false;
+
+	/* as per DoCommand, minus the waiting */
+	if(StepInCommand(Cmmd))
+		CurrentDrive->Drive->SetLine(DL_DIRECTION, +1);
+
+	if(StepOutCommand(Cmmd))
+		CurrentDrive->Drive->SetLine(DL_DIRECTION, -1);
+
+	if(RestoreCommand(Cmmd))
+	{
+		Data8 = 0;
+		Track = 0xff;
+	}
+
+	if(SeekCommand(Cmmd) || RestoreCommand(Cmmd))
+	{
+		DataShift8 = Data8;
+		while(Track != DataShift8)
 		{
-			if(MotorOn)
+			CurrentDrive->Drive->SetLine(DL_DIRECTION, (DataShift8 > Track) ? +1 : -1);
+			Track += CurrentDrive->Drive->GetLine(DL_DIRECTION);
+
+			if(CurrentDrive->Drive->GetLine(DL_TRACK0) && (CurrentDrive->Drive->GetLine(DL_DIRECTION) < 0))
 			{
-//				fprintf(stderr, "spindle %d\n", CyclesToRun);
-				Drives[0].Drive->Update(CyclesToRun);
-				Drives[1].Drive->Update(CyclesToRun);
-				MotorOn -= CurrentDrive->Drive->GetLine(DL_INDEXHOLECOUNT);
-				if(MotorOn < 0) MotorOn = 0;
-//				fprintf(stderr, "spindled\n");
+				Track = 0;
+				break;
 			}
-//			else
-//				fprintf(stderr, "idle %d\n", CyclesToRun);
-			Break(0);
+
+			CurrentDrive->Drive->SetLine(DL_STEP, 1);
 		}
 	}
+	else
+	{
+		if(Cmmd&UPDATE_TRACK)
+			Track += CurrentDrive->Drive->GetLine(DL_DIRECTION);
+
+		if(CurrentDrive->Drive->GetLine(DL_TRACK0) && (CurrentDrive->Drive->GetLine(DL_DIRECTION) < 0))
+			Track = 0;
+		else
+			CurrentDrive->Drive->SetLine(DL_STEP, 1);
+	}
+
+	Status = (Status &~ (ST_CRCERROR | ST_NOTFOUND | ST_DATAREQ)) | ST_SPINUP;
+
+	/* every sector on an image carries the physical track number */
+	if(Cmmd&VERIFY)
+	{
+		CurrentDrive->Drive->LocateEvent(&Probe);
+		if(Probe.Track != Track)
+			Status |= ST_NOTFOUND;
+	}
+
+	MotorOn = 9;
+	return true;
+}
+
+bool CWD1770::FastTransfer(Uint16 Addr, Uint32 TimeStamp)
+{
+	/* nothing to do unless a command is waiting or under way */
+	if(!NewCmmd && !(Status&ST_BUSY))
+		return false;
+
+	const FastDiscLoop *Loop = NULL;
+	unsigned int c;
+	for(c = 0; c < NUM_FASTDISCLOOPS; c++)
+		if(FastDiscLoops[c].Addr == Addr)
+			Loop = &FastDiscLoops[c];
+	if(!Loop)
+		return false;
+
+	/* check that this really is the expected loop in the expected ROM */
+	C6502State CPUState;
+	C6502 *CPU = (C6502 *)PPPtr->GetWellDefinedComponent(COMPONENT_CPU);
+	CPU->GetState(CPUState);
+
+	if(CPUState.y8 || (Loop->Partial && !CPUState.x8))
+		return false;
+
+	Uint8 Byte;
+	for(c = 0; c < 12; c++)
+	{
+		CPU->ReadMem(CPUState.pc.a, Addr+c, Byte);
+		if(Byte != Loop->Signature[c]) return false;
+	}
+
+	if(Loop->Handler)
+	{
+		Uint8 Low, High;
+		CPU->ReadMem(CPUState.pc.a, 0xd10, Low);
+		CPU->ReadMem(CPUState.pc.a, 0xd11, High);
+		if((Low | (High << 8)) != Loop->Handler) return false;
+	}
+
+	/* is a single sector read or write just about to start? */
+	UpdateTo(TimeStamp);
+
+	Uint8 Cmmd;
+	if(NewCmmd)
+		Cmmd = Command;
+	else
+	{
+		if(!(Status&ST_BUSY) || Phase < WDPHASE_T2START || Phase > WDPHASE_T2SEARCH)
+			return false;
+		Cmmd = ActiveCommand;
+	}
+	if((Cmmd >> 4) != (Loop->Write ? 10 : 8))
+		return false;
+
+	/* let the controller report any write protection */
+	if(Loop->Write && (CurrentDrive->ReadOnly || CurrentDrive->Drive->GetLine(DL_WPROTECT)))
+		return false;
+
+	DriveEvent Target;
+	Target.Sector = Sector;
+	Target.DataLength = 256;
+	if(!CurrentDrive->Drive->LocateEvent(&Target) || (Target.Track != Track))
+		return false;
+
+	/* this is now going to happen, so the controller can forget about the command */
+	Abort();
+
+	Uint8 Low, High;
+	CPU->ReadMem(CPUState.pc.a, Loop->Pointer, Low);
+	CPU->ReadMem(CPUState.pc.a, Loop->Pointer+1, High);
+	Uint16 Ptr = Low | (High << 8);
+	int Count = Loop->Partial ? CPUState.x8 : 256;
+
+	if(Loop->Write)
+	{
+		for(c = 0; c < (unsigned int)Count; c++)
+			CPU->ReadMem(CPUState.pc.a, (Uint16)(Ptr+c), Target.Data8[c]);
+		memset(&Target.Data8[Count], 0, 256 - Count);
+		CurrentDrive->Drive->SetEventDirty();
+	}
+	else
+	{
+		/* ordinary RAM can be written in one go, anything else goes through the current memory view */
+		if(!Shadow && (Ptr + Count <= 0x8000))
+			CPU->WriteMemoryBlock(((CULA *)PPPtr->GetWellDefinedComponent(COMPONENT_ULA))->GetMappedAddr(MEM_RAM), Ptr, Count, Target.Data8);
+		else
+		{
+			for(c = 0; c < (unsigned int)Count; c++)
+				CPU->WriteMem(CPUState.pc.a, (Uint16)(Ptr+c), Target.Data8[c]);
+		}
+		Data8 = Target.Data8[Count-1];
+	}
+
+	/* leave things as the loop would have */
+	Status &= ~(ST_BUSY | ST_DATAREQ | ST_LOSTDATA | ST_NOTFOUND | ST_CRCERROR | ST_DELRECORD);
+	MotorOn = 9;
+
+	if(Loop->NextPage)
+		CPU->WriteMem(CPUState.pc.a, Loop->Pointer+1, (Uint8)(High+1));
+
+	if(Loop->Partial)
+	{
+		CPUState.y8 = (Uint8)Count;
+		CPUState.x8 = 0;
+		CPU->SetState(CPUState);
+	}
 
-	SDL_SemPost(StopSemaphore);
-	return 0;
+	return true;
 }
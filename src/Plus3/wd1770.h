@@ -4,9 +4,10 @@
 #include "../ComponentBase.h"
 #include "../Configuration/ElectronConfiguration.h"
 #include "SDL.h"
-#include "SDL_thread.h"
 #include "Drive/Drive.h"
 
+class CUEFChunk;
+
 #define WDOPEN_FAIL	0
 #define WDOPEN_SDEN	1
 #define WDOPEN_DDEN	2
@@ -26,25 +27,38 @@ class CWD1770 : public CComponentBase
 		int Open(char *name, int drive = 0); /* returns one of the WDOPEN_????s, depending on the native density of track 0 of the media opened */
 		void Close(int drive = 0);
 
+		/* snapshot support - GetState brings the controller up to TimeStamp
+		and appends its state to the chunk, SetState reverses that,
+		putting back in flight any command that was in progress. As with
+		register accesses, TimeStamp is the CPU's cycle count */
+		void GetState(CUEFChunk *, Uint32 TimeStamp);
+		void SetState(CUEFChunk *, Uint32 TimeStamp);
+
 	private:
-		static int MainThreadHelper(void *tptr);
-		int MainThread();
+		/* runs the controller forward to CycleTime, which is always a CPU
+		cycle count - Update reads it from the CPU rather than adding up the
+		periods it is given, so that it can't drift from register accesses */
 		void UpdateTo(Uint32 CycleTime);
+		Uint32 LastRun;
 
-		volatile Uint32 CyclesToRun;
-		volatile Uint32 IdleTime;
-		Uint32 LastRun, CurrentTime;
-		SDL_sem *GoSemaphore, *StopSemaphore;
-		SDL_Thread *MainEx;
-		volatile bool Quit;
+		/* registers, etc */
+		Uint8 DataShift8, Data8;
+		Uint32 DataShift32, Data32;
+		Uint8 Track, Sector, Command, Status, Control;
+		bool NewCmmd;
+		bool ForceInterrupt, IndexHoleInterrupt;
+		bool DoCommand();
+		void EndCommand();
+		void Abort();
 
-		/* registers, etc - shared between threads, so... */
-		volatile Uint8 DataShift8, Data8;
-		volatile Uint32 DataShift32, Data32;
-		volatile Uint8 Track, Sector, Command, Status, Control;
-		volatile bool NewCmmd;
-		volatile bool ForceInterrupt, IndexHoleInterrupt;
-		void DoCommand();
+		/* progress through the command in flight - Phase records which wait
+		DoCommand is sitting in, WaitRemaining how many cycles are left of it.
+		DoCommand returns whenever it has to wait and UpdateTo calls it again,
+		to jump straight back to Phase, once that time has passed */
+		Uint8 ActiveCommand;
+		int Phase, IndexCount;
+		unsigned int BytePtr;
+		Uint32 WaitRemaining;
 
 		/* drive motors */
 		int MotorOn;
@@ -58,8 +72,15 @@ class CWD1770 : public CComponentBase
 		bool DDen;
 
 		/* type II helpers */
-		void GetSector();
 		DriveEvent CurSector;
+
+		/* fast disc - see the end of wd1770.cpp. Seeks complete as soon as they are
+		issued and, where the DFS or ADFS ROM is found sitting in one of its
+		sector transfer loops, the whole sector is moved in one go */
+		void SetTrapAddresses(bool Enabled);
+		bool FastSeek(Uint8 Cmmd);
+		bool FastTransfer(Uint16 Addr, Uint32 TimeStamp);
+		bool UseFastDisc, Shadow;
 };
 
 #endif
@@ -18,6 +18,7 @@
 
 #include "HostMachine/HostMachine.h"
 #include "ProcessPool.h"
+#include "Fence.h"
 #include "ComponentBase.h"
 
 #include "6502.h"
@@ -30,6 +31,28 @@
 #include <stdlib.h>
 #include "zlib.h"
 
+#ifdef PPOOL_STATISTICS
+#ifdef WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+/* charges time since the last mark to ConnectedDevices[c] */
+#define StatisticsMark(c)\
+	{\
+		Uint64 TimeNow = ReadTimer();\
+		Statistics.ComponentTime[c] += TimeNow - StatisticsTime;\
+		StatisticsTime = TimeNow;\
+		Statistics.ComponentUpdates[c]++;\
+	}
+/* discards time since the last mark, e.g. time spent processing IOCtls */
+#define StatisticsSkip()	StatisticsTime = ReadTimer()
+#else
+#define StatisticsMark(c)
+#define StatisticsSkip()
+#endif
+
 /* some default ROM slots */
 #define ADFS_SLOT1	4
 #define ADFS_SLOT2	5
@@ -45,7 +68,7 @@ void CProcessPool::TrapTable::Clear()
 		delete[] TrapAddrDevices[c];
 		TrapAddrDevices[c] = NULL;
 	}
-	memset(TrapAddrFlags, 0, sizeof(Uint32)*2048);
+	memset(&Flags, 0, sizeof(PPTrapFlags));
 }
 
 CProcessPool::TrapTable::TrapTable()
@@ -53,7 +76,26 @@ CProcessPool::TrapTable::TrapTable()
 	int c = 256;
 	while(c--)
 		TrapAddrDevices[c] = NULL;
-	memset(TrapAddrFlags, 0, sizeof(Uint32)*2048);
+	memset(&Flags, 0, sizeof(PPTrapFlags));
+}
+
+/* these two keep the per page counts in step with the address bits */
+void CProcessPool::TrapTable::SetFlag(Uint16 Addr)
+{
+	if(!(Flags.Addresses[Addr >> 5]&(1 << (Addr&31))))
+	{
+		Flags.Addresses[Addr >> 5] |= (1 << (Addr&31));
+		Flags.PageCounts[Addr >> 8]++;
+	}
+}
+
+void CProcessPool::TrapTable::ClearFlag(Uint16 Addr)
+{
+	if(Flags.Addresses[Addr >> 5]&(1 << (Addr&31)))
+	{
+		Flags.Addresses[Addr >> 5] &= ~(1 << (Addr&31));
+		Flags.PageCounts[Addr >> 8]--;
+	}
 }
 
 CProcessPool::TrapTable::~TrapTable()
@@ -63,13 +105,24 @@ CProcessPool::TrapTable::~TrapTable()
 		delete[] TrapAddrDevices[c];
 }
 
-CProcessPool::CProcessPool( ElectronConfiguration &cfg )
+CProcessPool::CProcessPool( ElectronConfiguration &cfg ) : StateWriter(this)
 {
 	AllTrapTables = NULL;
 	NumConnectedDevices = 0;
+	EventHeapSize = 0;
 	InTape = false; InTapeTransient = 0;
+	Turbo = false; Speed = 1;
+	RewindFields = 0; RewindPending = false;
+	RewindMemory = new Uint8[REWIND_MAXMEMORY];
 	CyclesToRun = 0;
 	TotalCycles = 0;
+
+	/* ROMs are loaded as part of the initial configuration below, so make
+	sure failures there get reported */
+	DebugMask = PPDEBUG_SCREENFAILED | PPDEBUG_OSFAILED | PPDEBUG_BASICFAILED | PPDEBUG_SAVEFAILED;
+#ifdef PPOOL_STATISTICS
+	ResetStatistics();
+#endif
 	
 	/* allocate things we'll definitely need here */
 	Disp = new CDisplay(cfg);
@@ -85,8 +138,9 @@ CProcessPool::CProcessPool( ElectronConfiguration &cfg )
 	/* initialise variables related to configuration changes */
 	RunningMutex = SDL_CreateMutex();
 	MainThreadRunning = false;
-	IOCtlMutex = SDL_CreateMutex();
-	IOCtlBufferRead = IOCtlBufferWrite = 0;
+	MainThreadID = SDL_ThreadID();
+	CommandMutex = SDL_CreateMutex();
+	CommandRead = CommandWrite = 0;
 	ConfigDirty = false;
 
 	/* store configuration for when it might next be useful */
@@ -101,11 +155,86 @@ void CProcessPool::SetCycleLimit(Uint32 t)
 	CyclesToRun = t;
 }
 
+#ifdef PPOOL_STATISTICS
+Uint64 CProcessPool::ReadTimer()
+{
+#ifdef WIN32
+	LARGE_INTEGER Count;
+	QueryPerformanceCounter(&Count);
+	return Count.QuadPart;
+#else
+	struct timespec Now;
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (Uint64)Now.tv_sec*1000000000 + Now.tv_nsec;
+#endif
+}
+
+void CProcessPool::ResetStatistics()
+{
+	memset(&Statistics, 0, sizeof(PPStatistics));
+#ifdef WIN32
+	LARGE_INTEGER Frequency;
+	QueryPerformanceFrequency(&Frequency);
+	Statistics.TimeUnitsPerSecond = Frequency.QuadPart;
+#else
+	Statistics.TimeUnitsPerSecond = 1000000000;
+#endif
+}
+
+void CProcessPool::GetStatistics(PPStatistics &Target)
+{
+	GetExclusivity();
+
+	Target = Statistics;
+	Target.NumComponents = NumConnectedDevices;
+	Uint32 c = NumConnectedDevices;
+	while(c--)
+		Target.Components[c] = ConnectedDevices[c].Component;
+
+	ReleaseExclusivity();
+}
+
+const char *CProcessPool::ComponentName(CComponentBase *Component)
+{
+	if(Component == CPU)	return "6502";
+	if(Component == ULA)	return "ULA";
+	if(Component == Disp)	return "Display";
+	if(Component == Tape)	return "Tape";
+	if(Component == Disc)	return "WD1770";
+	if(Component == Plus1)	return "Plus 1";
+	return "Other";
+}
+
+void CProcessPool::DumpStatistics(FILE *Target)
+{
+	PPStatistics Stats;
+	GetStatistics(Stats);
+
+	Uint64 TotalTime = 0;
+	Uint32 c;
+	for(c = 0; c < Stats.NumComponents; c++)
+		TotalTime += Stats.ComponentTime[c];
+	if(!TotalTime) TotalTime = 1;
+
+	fprintf(Target, "%u fields, %u in catch up mode, %u IOCtls\n", Stats.Frames, Stats.CatchupFrames, Stats.IOCtls);
+	fprintf(Target, "\t%-8s %12s %6s %10s %10s %10s\n", "", "ms", "%", "updates", "reads", "writes");
+	for(c = 0; c < Stats.NumComponents; c++)
+		fprintf(Target, "\t%-8s %12.3f %6.1f %10u %10u %10u\n",
+			ComponentName(Stats.Components[c]),
+			(double)Stats.ComponentTime[c] * 1000.0 / (double)Stats.TimeUnitsPerSecond,
+			(double)Stats.ComponentTime[c] * 100.0 / (double)TotalTime,
+			Stats.ComponentUpdates[c], Stats.TrapReads[c], Stats.TrapWrites[c]);
+}
+#endif
+
 CProcessPool::~CProcessPool()
 {
+#ifdef PPOOL_STATISTICS
+	DumpStatistics(stderr);
+#endif
 	Close((Uint32)-1);
 
-	SDL_DestroyMutex(IOCtlMutex);
+	SDL_DestroyMutex(CommandMutex);
 	SDL_DestroyMutex(RunningMutex);
 	delete CPU;
 	delete Disp;
@@ -114,6 +243,7 @@ CProcessPool::~CProcessPool()
 	delete Disc;
 	delete Plus1;
 	delete[] AllTrapTables;
+	delete[] RewindMemory;
 }
 
 int CProcessPool::UpdateHelper(void *t)
@@ -143,78 +273,100 @@ int CProcessPool::Update()
 
 	/* get on with it */
 	bool Catchup = false;
-	Uint32 Counter = 0, FrameStart = SDL_GetTicks(), FrameCounter = 0, NextCycles, SkippedFrames = 0;
-
-	NextCycles = 0;
+	Uint32 Counter = 0, FrameCounter = 0;
+#ifndef PROFILE
+	Uint32 FrameStart = SDL_GetTicks(), SkippedFrames = 0;
+	Uint32 PacedSpeed = Speed, SpeedFields = 0;
+#endif
 
 	/* this probable needn't go here, but... */
 	SendInitialIOCtls();
 	IOCtl(IOCTL_UNPAUSE, NULL, TotalCycles);
-	MainThreadRunning = true;
+
+	/* everything is due immediately, so that each component gets to
+	nominate its first deadline */
+	BuildSchedule();
 
 	while(!Quit)
 	{
-		if(IOCtlBufferWrite != IOCtlBufferRead)
-		{
-			SDL_mutexP(IOCtlMutex);
-			while(IOCtlBufferWrite != IOCtlBufferRead)
-			{
-				switch(IOCtlBuffer[IOCtlBufferRead].Control)
-				{
-					default:break;
-
-					case PPOOLIOCTL_MUTEXWAIT:
-						MainThreadRunning = false;
-						SDL_mutexP(RunningMutex);		/* grab running mutex */
-						SDL_mutexV(RunningMutex);		/* release running mutex  so anyone waiting on it can have a go */
-						MainThreadRunning = true;
-					break;
-
-					case PPOOLIOCTL_BREAK:
-						/* tell ULA to press break for 1/25 of a second */
-						ULA->BeginKeySequence();
-							ULA->PressKey(15, 1);
-							ULA->KeyWait(80000);
-							ULA->ReleaseKey(15, 1);
-						ULA->EndKeySequence();
-					break;
-				}
-				IOCtlBufferRead = (IOCtlBufferRead+1)&(IOCTLBUFFER_LENGTH-1);
-			}
-			SDL_mutexV(IOCtlMutex);
-		}
+		if(CommandWrite != CommandRead)
+			ApplyCommands(Catchup);
 
-		Uint32 NewCycles = NextCycles, Cyc;
+		/* run the CPU up to the next deadline */
+		Uint32 NewCycles = EventHeapSize ? Deadline[EventHeap[0]] - TotalCycles : CYCLENO_ANY;
 
 		if(CyclesToRun && NewCycles > CyclesToRun) NewCycles = CyclesToRun;
 
-		NextCycles = CPU->Update(NewCycles, Catchup);
+		StatisticsSkip();
+		CPU->Update(NewCycles, Catchup);
 		NewCycles = CPU->GetCyclesExecuted();
+		StatisticsMark(COMPONENT_CPU);
+		TotalCycles += NewCycles;
 
-		Uint32 c = 1;
-		while(c < NumConnectedDevices)
-		{
-			if(ConnectedDevices[c].Enabled)
-			{
-				if((Cyc = ConnectedDevices[c].Component->Update(NewCycles, Catchup)) < NextCycles) NextCycles = Cyc;
-			}
-
-			c++;
-		}
+		/* then bring up to date whatever is now due */
+		while(EventHeapSize && (Sint32)(Deadline[EventHeap[0]] - TotalCycles) <= 0)
+			UpdateComponent(EventHeap[0], Catchup);
 
 		Counter += NewCycles;
 		FrameCounter += NewCycles;
-		TotalCycles += NewCycles;
 
 		if(FrameCounter >= 39936) /* end of field - should be 20ms since last equivalent */
 		{
 			FrameCounter -= 39936;
+#ifdef PPOOL_STATISTICS
+			Statistics.Frames++;
+			if(Catchup) Statistics.CatchupFrames++;
+#endif
 
 			/* Difference = now - start of frame */
 #ifndef PROFILE
+			if(PacedSpeed != Speed)
+			{
+				/* start afresh rather than trying to make up for time spent at the old speed */
+				PacedSpeed = Speed;
+				FrameStart = SDL_GetTicks();
+				SkippedFrames = SpeedFields = 0;
+				Catchup = false;
+			}
+
 			Uint32 FrameTime = SDL_GetTicks() - FrameStart;
 
-			if(!InTape)
+			if(Speed != 1)
+			{
+				/* Speed fields go by every 20ms, or as many as possible if unlimited */
+				if(Speed)
+				{
+					SpeedFields++;
+					if(SpeedFields >= Speed)
+					{
+						SpeedFields = 0;
+						if(FrameTime <= 40)
+						{
+							if(FrameTime < 20)
+								SDL_Delay(20 - FrameTime);
+							FrameStart += 20;
+						}
+						else
+							FrameStart = SDL_GetTicks();
+					}
+				}
+
+				/* draw one field in every FrameSkip, or by default one per
+				Speed fields - so 50 a second - or one per 20ms if unlimited */
+				Uint32 Skip = CurrentConfig.Speed.FrameSkip ? CurrentConfig.Speed.FrameSkip : Speed;
+				if(Skip)
+				{
+					SkippedFrames++;
+					Catchup = SkippedFrames < Skip;
+					if(!Catchup) SkippedFrames = 0;
+				}
+				else
+				{
+					Catchup = FrameTime < 20;
+					if(!Catchup) FrameStart = SDL_GetTicks();
+				}
+			}
+			else if(!InTape)
 			{
 				if(FrameTime <= 40)
 				{
@@ -256,6 +408,23 @@ int CProcessPool::Update()
 			}
 #endif
 
+			/* rewind captures and restores happen only between fields */
+			if(RewindPending)
+			{
+				RewindPending = false;
+				RestoreRewindState();
+				RewindFields = 0;
+			}
+			else if(CurrentConfig.Rewind.Memory > 0 && CurrentConfig.Rewind.Interval > 0)
+			{
+				RewindFields++;
+				if(RewindFields >= (Uint32)CurrentConfig.Rewind.Interval)
+				{
+					RewindFields = 0;
+					CaptureRewindState();
+				}
+			}
+
 			/* make sure input continues working */
 //			SDL_PumpEvents();
 
@@ -274,12 +443,286 @@ int CProcessPool::Update()
 		}
 	}
 
+	SyncComponents(Catchup);
 	CyclesToRun = 0;
+
+	/* stop accepting commands. Anything posted from here on is carried out
+	by the poster, under CommandMutex */
+	SDL_mutexP(CommandMutex);
 	MainThreadRunning = false;
+	SDL_mutexV(CommandMutex);
+
+	/* then do whatever slipped in first. CommandMutex isn't held across a
+	PARK, since whoever asked for it may post further commands before
+	letting go, but is taken around everything else so as not to overlap
+	with commands being carried out by their posters */
+	while(CommandRead != AcquireLoad(CommandWrite))
+	{
+		PPCommandRecord Record = Commands[CommandRead];
+		ReleaseStore(CommandRead, (CommandRead+1)&(PPCOMMAND_LENGTH-1));
+
+		if(Record.Type == PPCMD_PARK)
+		{
+			ApplyCommand(Record);
+			continue;
+		}
+
+		SDL_mutexP(CommandMutex);
+		bool Result = ApplyCommand(Record);
+		SDL_mutexV(CommandMutex);
+		if(Record.Result) *Record.Result = Result;
+		if(Record.Done) SDL_SemPost(Record.Done);
+	}
 
 	return 0;
 }
 
+bool CProcessPool::Command(PPCommandType Type, void *Parameter, Uint32 Value, bool Wait)
+{
+	bool Result = true;
+	PPCommandRecord Record;
+	Record.Type = Type;
+	Record.Parameter = Parameter;
+	Record.Value = Value;
+	Record.Result = &Result;
+	Record.Done = NULL;
+
+	/* the emulation thread is by definition at a safe point whenever it posts */
+	if(MainThreadRunning && MainThreadID == SDL_ThreadID())
+	{
+		if(Type != PPCMD_PARK) ApplyCommand(Record);
+		return Result;
+	}
+
+	SDL_mutexP(CommandMutex);
+	while(MainThreadRunning && ((CommandWrite+1)&(PPCOMMAND_LENGTH-1)) == AcquireLoad(CommandRead))
+	{
+		SDL_mutexV(CommandMutex);
+		SDL_Delay(1);
+		SDL_mutexP(CommandMutex);
+	}
+
+	if(!MainThreadRunning)
+	{
+		/* there's nothing to hand the command to, so do it here and now */
+		if(Type != PPCMD_PARK) ApplyCommand(Record);
+		SDL_mutexV(CommandMutex);
+		return Result;
+	}
+
+	if(Wait)
+		Record.Done = SDL_CreateSemaphore(0);
+	else
+		Record.Result = NULL;
+
+	Commands[CommandWrite] = Record;
+	ReleaseStore(CommandWrite, (CommandWrite+1)&(PPCOMMAND_LENGTH-1));
+	SDL_mutexV(CommandMutex);
+
+	if(Wait)
+	{
+		SDL_SemWait(Record.Done);
+		SDL_DestroySemaphore(Record.Done);
+	}
+
+	return Result;
+}
+
+void CProcessPool::ApplyCommands(bool Catchup)
+{
+	/* commands may look at or alter any component, so bring them all up to date first */
+	SyncComponents(Catchup);
+
+	while(CommandRead != AcquireLoad(CommandWrite))
+	{
+		PPCommandRecord Record = Commands[CommandRead];
+		ReleaseStore(CommandRead, (CommandRead+1)&(PPCOMMAND_LENGTH-1));
+
+		bool Result = ApplyCommand(Record);
+		if(Record.Result) *Record.Result = Result;
+		if(Record.Done) SDL_SemPost(Record.Done);
+	}
+}
+
+bool CProcessPool::ApplyCommand(PPCommandRecord &Record)
+{
+	bool Result = true;
+
+	switch(Record.Type)
+	{
+		case PPCMD_PARK:
+			/* let the poster know that it has the machine, then wait for it to give it back */
+			if(Record.Done) SDL_SemPost(Record.Done);
+			Record.Done = NULL;
+			Record.Result = NULL;
+			SDL_mutexP(RunningMutex);		/* grab running mutex */
+			SDL_mutexV(RunningMutex);		/* release running mutex  so anyone waiting on it can have a go */
+		break;
+
+		case PPCMD_BREAK:
+			/* tell ULA to press break for 1/25 of a second */
+			ULA->BeginKeySequence();
+				ULA->PressKey(15, 1);
+				ULA->KeyWait(80000);
+				ULA->ReleaseKey(15, 1);
+			ULA->EndKeySequence();
+		break;
+
+		case PPCMD_SETCONFIG:
+		{
+			SetNonResetConfiguration((ElectronConfiguration *)Record.Parameter);
+			int c = NumConnectedDevices;
+			while(c--) ConfigDirty |= ConnectedDevices[c].Component->IOCtl(IOCTL_SETCONFIG, Record.Parameter, TotalCycles);
+		}
+		break;
+
+		case PPCMD_INSERTTAPE:	Result = Tape->Open((char *)Record.Parameter);	break;
+		case PPCMD_EJECTTAPE:	Tape->Close();									break;
+		case PPCMD_REWINDTAPE:	Tape->IOCtl(TAPEIOCTL_REWIND);					break;
+		case PPCMD_LOADTAPEFILE:	Result = Tape->IOCtl(TAPEIOCTL_LOADFILE, Record.Parameter, TotalCycles);	break;
+
+		case PPCMD_INSERTDISC:	Result = (Disc->Open((char *)Record.Parameter, Record.Value) != WDOPEN_FAIL);	break;
+		case PPCMD_EJECTDISC:	Disc->Close(Record.Value);														break;
+
+		case PPCMD_REWIND:		Result = !RewindBuffer.IsEmpty(); RewindPending = Result;						break;
+	}
+
+	/* captures refer to whatever media was inserted when they were made */
+	if(Record.Type >= PPCMD_INSERTTAPE && Record.Type <= PPCMD_EJECTDISC)
+		RewindBuffer.Clear();
+
+	/* whatever the tape now holds, it'll want to reconsider when it next needs attention */
+	if(Record.Type >= PPCMD_INSERTTAPE && Record.Type <= PPCMD_LOADTAPEFILE)
+		RequestUpdate(COMPONENT_TAPE);
+
+	return Result;
+}
+
+#define DeadlineBefore(a, b)	((Sint32)(Deadline[a] - Deadline[b]) < 0)
+
+void CProcessPool::BuildSchedule()
+{
+	EventHeapSize = 0;
+	Uint32 c = 16;
+	while(c--)
+		EventHeapPos[c] = 16;
+
+	c = 1;
+	while(c < NumConnectedDevices)
+	{
+		if(ConnectedDevices[c].Enabled)
+		{
+			/* all deadlines are equal, so any order is a valid heap */
+			Deadline[c] = LastUpdate[c] = TotalCycles;
+			EventHeap[EventHeapSize] = c;
+			EventHeapPos[c] = EventHeapSize;
+			EventHeapSize++;
+		}
+		c++;
+	}
+}
+
+bool CProcessPool::IsScheduled(Uint32 id)
+{
+	return (id < NumConnectedDevices) && (EventHeapPos[id] < EventHeapSize) && (EventHeap[EventHeapPos[id]] == id);
+}
+
+void CProcessPool::SiftUp(Uint32 pos)
+{
+	Uint32 id = EventHeap[pos];
+
+	while(pos)
+	{
+		Uint32 Parent = (pos-1) >> 1;
+		if(!DeadlineBefore(id, EventHeap[Parent])) break;
+
+		EventHeap[pos] = EventHeap[Parent];
+		EventHeapPos[EventHeap[pos]] = pos;
+		pos = Parent;
+	}
+
+	EventHeap[pos] = id;
+	EventHeapPos[id] = pos;
+}
+
+void CProcessPool::SiftDown(Uint32 pos)
+{
+	Uint32 id = EventHeap[pos];
+
+	while(1)
+	{
+		Uint32 Child = (pos << 1) + 1;
+		if(Child >= EventHeapSize) break;
+		if(Child+1 < EventHeapSize && DeadlineBefore(EventHeap[Child+1], EventHeap[Child])) Child++;
+		if(!DeadlineBefore(EventHeap[Child], id)) break;
+
+		EventHeap[pos] = EventHeap[Child];
+		EventHeapPos[EventHeap[pos]] = pos;
+		pos = Child;
+	}
+
+	EventHeap[pos] = id;
+	EventHeapPos[id] = pos;
+}
+
+void CProcessPool::UpdateComponent(Uint32 id, bool Catchup)
+{
+	Uint32 Cyc = ConnectedDevices[id].Component->Update(TotalCycles - LastUpdate[id], Catchup);
+	StatisticsMark(id);
+
+	/* a reset may have reconfigured the machine from within Update */
+	if(!IsScheduled(id)) return;
+
+	/* nobody goes unattended for more than a field, or waits for nothing */
+	if(Cyc > CYCLENO_ANY) Cyc = CYCLENO_ANY;
+	if(!Cyc) Cyc = 1;
+
+	LastUpdate[id] = TotalCycles;
+	Deadline[id] = TotalCycles + Cyc;
+	SiftDown(EventHeapPos[id]);
+}
+
+void CProcessPool::SyncComponents(bool Catchup)
+{
+	StatisticsSkip();
+	Uint32 c = 1;
+	while(c < NumConnectedDevices)
+	{
+		if(IsScheduled(c) && LastUpdate[c] != TotalCycles)
+			UpdateComponent(c, Catchup);
+		c++;
+	}
+}
+
+/* runs the CPU for just the cycles its last instruction still owes, so that
+the machine sits at the end of an opcode with every clock in agreement */
+void CProcessPool::FinishOpcode()
+{
+	Uint32 Debt = 0;
+	CPU->IOCtl(C6502IOCTL_FINISHOPCODE, &Debt);
+	if(!Debt) return;
+
+	/* a slice no longer than the debt is entirely taken up paying it off */
+	CPU->Update(Debt, false);
+	TotalCycles += CPU->GetCyclesExecuted();
+
+	while(EventHeapSize && (Sint32)(Deadline[EventHeap[0]] - TotalCycles) <= 0)
+		UpdateComponent(EventHeap[0], false);
+}
+
+void CProcessPool::RequestUpdate(Uint32 id)
+{
+	if(!IsScheduled(id)) return;
+
+	/* the CPU is already running to the current soonest deadline, so the
+	earliest this can take effect is the end of its slice */
+	if((Sint32)(Deadline[id] - TotalCycles) > 0)
+	{
+		Deadline[id] = TotalCycles;
+		SiftUp(EventHeapPos[id]);
+	}
+}
+
 void CProcessPool::Stop()
 {
 	Quit = true;
@@ -305,6 +748,13 @@ void CProcessPool::RemoveDebugFlags(Uint32 f)
 
 int CProcessPool::Go(bool halt)
 {
+	/* commands posted from now on are for the emulation thread, which
+	will fill in its ID once it exists */
+	SDL_mutexP(CommandMutex);
+	MainThreadID = 0;
+	MainThreadRunning = true;
+	SDL_mutexV(CommandMutex);
+
 	/* spawn emulation thread, return */
 	Quit = false;
 	if(halt)
@@ -319,13 +769,27 @@ int CProcessPool::Go(bool halt)
 
 bool CProcessPool::Write(Uint16 Addr, Uint32 TimeStamp, Uint8 Data8, Uint32 Data32)
 {
-	if(CurrentTrapTable->TrapAddrDevices[Addr >> 8])	return ConnectedDevices[CurrentTrapTable->TrapAddrDevices[Addr >> 8][Addr&0xff]].Component->Write(Addr, TimeStamp, Data8, Data32);
+	if(CurrentTrapTable->TrapAddrDevices[Addr >> 8])
+	{
+		Uint32 Device = CurrentTrapTable->TrapAddrDevices[Addr >> 8][Addr&0xff];
+#ifdef PPOOL_STATISTICS
+		Statistics.TrapWrites[Device]++;
+#endif
+		return ConnectedDevices[Device].Component->Write(Addr, TimeStamp, Data8, Data32);
+	}
 	return false;
 }
 
 bool CProcessPool::Read(Uint16 Addr, Uint32 TimeStamp, Uint8 &Data8, Uint32 &Data32)
 {
-	if(CurrentTrapTable->TrapAddrDevices[Addr >> 8])	return ConnectedDevices[CurrentTrapTable->TrapAddrDevices[Addr >> 8][Addr&0xff]].Component->Read(Addr, TimeStamp, Data8, Data32);
+	if(CurrentTrapTable->TrapAddrDevices[Addr >> 8])
+	{
+		Uint32 Device = CurrentTrapTable->TrapAddrDevices[Addr >> 8][Addr&0xff];
+#ifdef PPOOL_STATISTICS
+		Statistics.TrapReads[Device]++;
+#endif
+		return ConnectedDevices[Device].Component->Read(Addr, TimeStamp, Data8, Data32);
+	}
 	return false;
 }
 
@@ -393,6 +857,9 @@ bool CProcessPool::EffectChunk(CUEFChunk *cnk)
 			Uint8 MType = cnk->GetC();
 			if(MType == 1)
 				Disp->SetFlags( Disp->GetFlags() | CDF_MULTIPLEXED);
+
+			/* the CPU only needs to maintain the 32bit datapath if it'll be displayed */
+			CPU->SetMultiplexed((Disp->GetFlags()&CDF_MULTIPLEXED) ? true : false);
 		} break;
 
 		case 0x0007:{
@@ -467,11 +934,15 @@ bool CProcessPool::EffectChunk(CUEFChunk *cnk)
 			}
 		} break;
 
+		case 0x0402:	/* WD1770 and drive state */
+			Disc->SetState(cnk, CPU->GetTotalCycles());
+		break;
+
 		case 0x0400:{ /* 6502 standard state */
 
 			/* update byte */
 			cnk->ReadSeek(1, SEEK_CUR);
-			CPU->IOCtl(C6502IOCTL_FINISHOPCODE);
+			FinishOpcode();
 
 			C6502State st;
 			CPU->GetState(st);
@@ -579,6 +1050,9 @@ bool CProcessPool::EffectChunk(CUEFChunk *cnk)
 
 bool CProcessPool::Open(char *fname)
 {
+	/* a state still being saved may be the one about to be opened */
+	StateWriter.Wait();
+
 	GetExclusivity();	//can't do an open while the emulation is running
 
 	bool Used = false;
@@ -716,13 +1190,92 @@ bool CProcessPool::Open(char *fname)
 #undef RF_TAPE
 #undef RF_DISC
 
-bool CProcessPool::SaveState(char *fname)
+/* writes the CPU (0x0400), ULA (0x0401) or WD1770 (0x0402) state chunk, as
+read back by EffectChunk. The CPU should be at the end of an opcode */
+void CProcessPool::PutStateChunk(CUEFChunk *cnk, Uint16 Id)
 {
-	GetExclusivity();
+	cnk->SetId(Id);
 
-	/* advance CPU to end of opcode, so that state is meaningful */
-	CPU->IOCtl(C6502IOCTL_FINISHOPCODE);
+	switch(Id)
+	{
+		case 0x0400:{
+			/* get CPU state */
+			C6502State s;
+			CPU->GetState(s);
+
+			/* write CPU state */
+			cnk->PutC(0);			// 'update byte' - no updates!
+			cnk->PutC(s.a8);		// a register
+			cnk->PutC(s.p8);		// p (status) register
+			cnk->PutC(s.x8);		// x register
+			cnk->PutC(s.y8);		// y register
+			cnk->PutC(s.s);			// s (stack pointer) register
+			cnk->Put16(s.pc.a);		// program counter
+		}break;
 
+		case 0x0401:
+			/* write ULA state */
+			cnk->PutC(0);			// 'update byte' - no updates!
+			cnk->PutC( ULA->QueryRegister(ULAREG_INTCONTROL) );		// interrupt control
+			cnk->PutC( ULA->QueryRegister(ULAREG_INTSTATUS) );		// interrupt status
+			cnk->PutC( Disp->Read(0xfe02) );		// fe02 (scr addr low)
+			cnk->PutC( Disp->Read(0xfe03) );		// fe03 (scr addr high)
+			cnk->PutC(0);			// cassette shift register
+			cnk->PutC( ULA->QueryRegister(ULAREG_PAGEREGISTER) );		// last value written to fe05
+			cnk->PutC( ULA->QueryRegister(ULAREG_LASTPAGED) );		// currently paged ROM
+
+			/* sheila bytes fe06 -> fe0f */
+			cnk->PutC( ULA->QueryRegAddr(0xfe06) );		// fe06 (clock divider)
+			cnk->PutC( ULA->QueryRegAddr(0xfe07) );		// fe07 (misc control)
+
+			/* the rest are palette bytes */
+			for(int palcount = 0xfe08; palcount <= 0xfe0f; palcount++)
+				cnk->PutC( Disp->Read(palcount) );
+
+			/* 4 bytes: 16 Mhz cycles since end of display */
+			cnk->Put32(0);
+		break;
+
+		case 0x0402:
+			Disc->GetState(cnk, CPU->GetTotalCycles());
+		break;
+	}
+}
+
+/* joins chunks into a single blob, each as a 2 byte id and 4 byte length
+followed by the chunk contents, deleting them along the way. The blob is
+malloc'd */
+static Uint8 *FlattenChunks(CUEFChunk **Chunks, int NumChunks, Uint32 &StateLength)
+{
+	int c;
+
+	StateLength = 0;
+	for(c = 0; c < NumChunks; c++)
+		StateLength += 6 + Chunks[c]->GetLength();
+
+	Uint8 *State = (Uint8 *)malloc(StateLength), *Ptr = State;
+	for(c = 0; c < NumChunks; c++)
+	{
+		Uint32 Length = Chunks[c]->GetLength();
+		Ptr[0] = Chunks[c]->GetId()&0xff;
+		Ptr[1] = Chunks[c]->GetId() >> 8;
+		Ptr[2] = Length&0xff;
+		Ptr[3] = (Length >> 8)&0xff;
+		Ptr[4] = (Length >> 16)&0xff;
+		Ptr[5] = Length >> 24;
+
+		Chunks[c]->ReadSeek(0, SEEK_SET);
+		Chunks[c]->Read(&Ptr[6], Length);
+		Ptr += 6 + Length;
+
+		delete Chunks[c];
+	}
+
+	return State;
+}
+
+bool CProcessPool::SaveState(char *fname)
+{
 	/* check for .uef ending, add it if it is missing */
 	char *locname;
 	char *UEFExts[] = { "uef\a", NULL };
@@ -734,108 +1287,171 @@ bool CProcessPool::SaveState(char *fname)
 	else
 		locname = fname;
 
-	/* get a UEF selector, for writing data to */
-	CUEFChunkSelector *SaveFile = GetHost() -> GetUEFSelector(locname, 0x0006);//UEF_VERSION);
-	if(!SaveFile) return false;
+	char *ResolvedName = GetHost()->ResolveFileName(locname);
 
-	/* delete any state chunks */
-	SaveFile->ResetOverRan();
-	while(SaveFile->FindIdMajor(0x04))
-		SaveFile->RemoveCurrentChunk();
+	/* free locally allocated filename, if there is one */
+	if(locname != fname)
+		free(locname);
 
-	/* do save */
-		/* CPU  always needed */
-			SaveFile->EstablishChunk();
-			SaveFile->CurrentChunk()->SetId(0x0400);
+	if(!ResolvedName) return false;
 
-			/* get CPU state */
-			C6502State s;
-			CPU->GetState(s);
+	GetExclusivity();
 
-			/* write CPU state */
-			SaveFile->CurrentChunk()->PutC(0);			// 'update byte' - no updates!
-			SaveFile->CurrentChunk()->PutC(s.a8);		// a register
-			SaveFile->CurrentChunk()->PutC(s.p8);		// p (status) register
-			SaveFile->CurrentChunk()->PutC(s.x8);		// x register
-			SaveFile->CurrentChunk()->PutC(s.y8);		// y register
-			SaveFile->CurrentChunk()->PutC(s.s);		// s (stack pointer) register
-			SaveFile->CurrentChunk()->Put16(s.pc.a);	// program counter
-
-		/* ULA - always needed */
-			SaveFile->EstablishChunk();
-			SaveFile->CurrentChunk()->SetId(0x0401);
-			
-			/* write ULA state */
-			SaveFile->CurrentChunk()->PutC(0);			// 'update byte' - no updates!
-			SaveFile->CurrentChunk()->PutC( ULA->QueryRegister(ULAREG_INTCONTROL) );		// interrupt control
-			SaveFile->CurrentChunk()->PutC( ULA->QueryRegister(ULAREG_INTSTATUS) );		// interrupt status
-			SaveFile->CurrentChunk()->PutC( Disp->Read(0xfe02) );		// fe02 (scr addr low)
-			SaveFile->CurrentChunk()->PutC( Disp->Read(0xfe03) );		// fe03 (scr addr high)
-			SaveFile->CurrentChunk()->PutC(0);			// cassette shift register
-			SaveFile->CurrentChunk()->PutC( ULA->QueryRegister(ULAREG_PAGEREGISTER) );		// last value written to fe05
-			SaveFile->CurrentChunk()->PutC( ULA->QueryRegister(ULAREG_LASTPAGED) );		// currently paged ROM
-			
-			/* sheila bytes fe06 -> fe0f */
-			SaveFile->CurrentChunk()->PutC( ULA->QueryRegAddr(0xfe06) );		// fe06 (clock divider)
-			SaveFile->CurrentChunk()->PutC( ULA->QueryRegAddr(0xfe07) );		// fe07 (misc control)
-			
-			/* the rest are palette bytes */
-			for(int palcount = 0xfe08; palcount < 0xfe0f; palcount++)
-				SaveFile->CurrentChunk()->PutC( Disp->Read(palcount) );
+	/* advance CPU to end of opcode, so that state is meaningful */
+	FinishOpcode();
 
-			/* 4 bytes: 16 Mhz cycles since end of display */
-			SaveFile->CurrentChunk()->Put32(0);
+	CUEFChunk *Chunks[5];
+	int NumChunks = 0;
 
-		/* WD1770 - needed only if the Plus 3 is enabled */
-		if(CurrentConfig.Plus3.Enabled)
+	/* CPU - always needed */
+		Chunks[NumChunks] = new CUEFChunk(NULL, true);
+		PutStateChunk(Chunks[NumChunks++], 0x0400);
+
+	/* ULA - always needed */
+		Chunks[NumChunks] = new CUEFChunk(NULL, true);
+		PutStateChunk(Chunks[NumChunks++], 0x0401);
+
+	/* WD1770 - needed only if the Plus 3 is enabled */
+	if(CurrentConfig.Plus3.Enabled)
+	{
+		Chunks[NumChunks] = new CUEFChunk(NULL, true);
+		PutStateChunk(Chunks[NumChunks++], 0x0402);
+	}
+
+	/* memory - which parts to save depends on current memory configuration */
+		/* save normal 32 kB */
+		CUEFChunk *Memory = Chunks[NumChunks++] = new CUEFChunk(NULL, true);
+		Memory->SetId(0x0410);
+
+		Memory->PutC(0);			// 'update byte' - no updates!
+		Memory->PutC(0);			// standard RAM
+
+		/* ram data itself */
+		Uint8 MemoryBuffer[32768];
+		CPU->ReadMemoryBlock(ULA->GetMappedAddr(MEM_RAM), 0, 32768, MemoryBuffer);
+		Memory->Write(MemoryBuffer, 32768);
+
+		/* save shadow RAM if any is in use */
+		if(CurrentConfig.MRBMode == MRB_SHADOW)
 		{
+			/* save 64 kB */
+			CPU->ReadMemoryBlock(ULA->GetMappedAddr(MEM_SHADOW), 0, 32768, MemoryBuffer);
+			Memory->Write(MemoryBuffer, 32768);
 		}
-		
-		/* memory - which parts to save depends on current memory configuration */
-			/* save normal 32 kB */
-			SaveFile->EstablishChunk();
-			SaveFile->CurrentChunk()->SetId(0x0410);
 
-			SaveFile->CurrentChunk()->PutC(0);			// 'update byte' - no updates!
-			SaveFile->CurrentChunk()->PutC(0);			// standard RAM
+	/* put Slogger MRB mode */
+		CUEFChunk *MRB = Chunks[NumChunks++] = new CUEFChunk(NULL, true);
+		MRB->SetId(0x0420);
 
-			/* ram data itself */
-			Uint8 MemoryBuffer[32768];
-			CPU->ReadMemoryBlock(ULA->GetMappedAddr(MEM_RAM), 0, 32768, MemoryBuffer);
-			SaveFile->CurrentChunk()->Write(MemoryBuffer, 32768);
+		MRB->PutC(0);			// 'update byte' - no updates!
+		switch(CurrentConfig.MRBMode)
+		{
+			default:			MRB->PutC(0); break;
+			case MRB_TURBO:
+			case MRB_4Mhz:		MRB->PutC(1); break;
+			case MRB_SHADOW:	MRB->PutC(2); break;
+		}
 
-			/* save shadow RAM if any is in use */
-			if(CurrentConfig.MRBMode == MRB_SHADOW)
-			{
-				/* save 64 kB */
-				Uint8 MemoryBuffer[32768];
-				CPU->ReadMemoryBlock(ULA->GetMappedAddr(MEM_SHADOW), 0, 32768, MemoryBuffer);
-				SaveFile->CurrentChunk()->Write(MemoryBuffer, 32768);
-			}
-			
-		/* put Slogger MRB mode */
-			SaveFile->EstablishChunk();
-			SaveFile->CurrentChunk()->SetId(0x0420);
-			
-			SaveFile->CurrentChunk()->PutC(0);			// 'update byte' - no updates!
-			switch(CurrentConfig.MRBMode)
-			{
-				default:			SaveFile->CurrentChunk()->PutC(0); break;
-				case MRB_TURBO:
-				case MRB_4Mhz:		SaveFile->CurrentChunk()->PutC(1); break;
-				case MRB_SHADOW:	SaveFile->CurrentChunk()->PutC(2); break;
-			}
+	ReleaseExclusivity();
 
-	/* free UEF selector */
-	GetHost() -> ReleaseUEFSelector(SaveFile);
+	/* compression and the file itself are dealt with while emulation continues */
+	Uint32 StateLength;
+	Uint8 *State = FlattenChunks(Chunks, NumChunks, StateLength);
+	StateWriter.Queue(ResolvedName, 0x0006/*UEF_VERSION*/, State, StateLength, CurrentConfig.StateCompression);
+	delete[] ResolvedName;
 
-	/* free locally allocated filename, if there is one */
-	if(locname != fname)
-		free(locname);
+	return true;
+}
+
+bool CProcessPool::StateSaved()
+{
+	return StateWriter.Wait();
+}
+
+/*
+
+	rewind captures are the same CPU, ULA and WD1770 chunks a state save
+	would contain, plus the tape's state, each as a 2 byte id and 4 byte
+	length followed by the chunk contents. RAM goes alongside, to be delta
+	encoded by the rewind buffer
+
+*/
+#define REWINDCHUNK_TAPE	0xff00	/* never written to files */
+
+void CProcessPool::CaptureRewindState()
+{
+	/* this happens between slices, so the CPU is already at the end of an
+	opcode. Any cycles its last one still owes stay owed, to be paid off at
+	the start of the next slice as usual */
+	CUEFChunk *Chunks[4];
+	int NumChunks = 0;
+
+	Chunks[NumChunks] = new CUEFChunk(NULL, true);
+	PutStateChunk(Chunks[NumChunks++], 0x0400);
+	Chunks[NumChunks] = new CUEFChunk(NULL, true);
+	PutStateChunk(Chunks[NumChunks++], 0x0401);
+	if(CurrentConfig.Plus3.Enabled)
+	{
+		Chunks[NumChunks] = new CUEFChunk(NULL, true);
+		PutStateChunk(Chunks[NumChunks++], 0x0402);
+	}
+	Chunks[NumChunks] = new CUEFChunk(NULL, true);
+	Chunks[NumChunks]->SetId(REWINDCHUNK_TAPE);
+	Tape->GetState(Chunks[NumChunks++], TotalCycles);
+
+	Uint32 StateLength;
+	Uint8 *State = FlattenChunks(Chunks, NumChunks, StateLength);
+
+	/* and grab RAM */
+	Uint32 MemoryLength = 32768;
+	CPU->ReadMemoryBlock(ULA->GetMappedAddr(MEM_RAM), 0, 32768, RewindMemory);
+	if(CurrentConfig.MRBMode == MRB_SHADOW)
+	{
+		CPU->ReadMemoryBlock(ULA->GetMappedAddr(MEM_SHADOW), 0, 32768, &RewindMemory[32768]);
+		MemoryLength += 32768;
+	}
+
+	RewindBuffer.Push(State, StateLength, RewindMemory, MemoryLength);
+	free(State);
+}
+
+bool CProcessPool::RestoreRewindState()
+{
+	Uint8 *State;
+	Uint32 StateLength, MemoryLength;
+
+	if(!RewindBuffer.Pop(State, StateLength, RewindMemory, MemoryLength))
+		return false;
+
+	CPU->WriteMemoryBlock(ULA->GetMappedAddr(MEM_RAM), 0, 32768, RewindMemory);
+	if(MemoryLength > 32768)
+		CPU->WriteMemoryBlock(ULA->GetMappedAddr(MEM_SHADOW), 0, 32768, &RewindMemory[32768]);
+
+	Uint8 *Ptr = State;
+	while(Ptr + 6 <= State + StateLength)
+	{
+		Uint16 Id = Ptr[0] | (Ptr[1] << 8);
+		Uint32 Length = Ptr[2] | (Ptr[3] << 8) | (Ptr[4] << 16) | ((Uint32)Ptr[5] << 24);
+
+		CUEFChunk *Chunk = new CUEFChunk(NULL, true);
+		Chunk->SetId(Id);
+		Chunk->Write(&Ptr[6], Length);
+		Chunk->ReadSeek(0, SEEK_SET);
+
+		if(Id == REWINDCHUNK_TAPE)
+			Tape->SetState(Chunk, TotalCycles);
+		else
+			EffectChunk(Chunk);
+
+		delete Chunk;
+		Ptr += 6 + Length;
+	}
+	free(State);
+
+	/* the tape and disc will have different ideas about when they next want attention */
+	for(Uint32 c = 1; c < NumConnectedDevices; c++)
+		RequestUpdate(c);
 
-	fflush(stdout);
-	
-	ReleaseExclusivity();
 	return true;
 }
 
@@ -848,6 +1464,7 @@ bool CProcessPool::GetConfiguration(ElectronConfiguration &cfg)
 void CProcessPool::SetResetConfiguration()
 {
 	CurrentConfig = NextConfig;
+	RewindBuffer.Clear();
 
 	/* build component table. Always include CPU, display, ULA & tape */
 	NumConnectedDevices = 4;
@@ -878,6 +1495,7 @@ void CProcessPool::SetResetConfiguration()
 		ConnectedDevices[NumConnectedDevices].Component = Plus1;
 		NumConnectedDevices++;
 	}
+	BuildSchedule();
 
 	/* clear all trap addresses */
 	unsigned int c = NumTrapTables;
@@ -943,6 +1561,10 @@ void CProcessPool::SetNonResetConfiguration(ElectronConfiguration *NewCfg, bool
 	/* copy down the various things the ProcessPool can respond to right now */
 	CurrentConfig.Autoload = NewCfg->Autoload;
 	CurrentConfig.Autoconfigure = NewCfg->Autoconfigure;
+	CurrentConfig.Speed = NewCfg->Speed;
+	SetSpeed();
+	CurrentConfig.Rewind = NewCfg->Rewind;
+	RewindBuffer.SetLimit((CurrentConfig.Rewind.Memory > 0) ? (Uint32)CurrentConfig.Rewind.Memory << 10 : 0);
 
 	/* if state is out of sync, note so here so that it can be fixed on next reset */
 	if(
@@ -955,6 +1577,13 @@ void CProcessPool::SetNonResetConfiguration(ElectronConfiguration *NewCfg, bool
 	}
 }
 
+void CProcessPool::SetSpeed()
+{
+	int Multiple = Turbo ? CurrentConfig.Speed.Turbo : CurrentConfig.Speed.Normal;
+	Speed = (Multiple < 0) ? 1 : (Uint32)Multiple;
+	IOCtl(IOCTL_SETCLOCKRATE, &Speed, TotalCycles);
+}
+
 void CProcessPool::CreateTrapAddressSets(int num)
 {
 	delete[] AllTrapTables;
@@ -966,9 +1595,9 @@ void CProcessPool::SetTrapAddressSet(int num)
 
 	int c = NumConnectedDevices;
 	while(c--)
-		ConnectedDevices[c].Component->IOCtl(IOCTL_NEWTRAPFLAGS, (void *)CurrentTrapTable, TotalCycles);
+		ConnectedDevices[c].Component->IOCtl(IOCTL_NEWTRAPFLAGS, (void *)&CurrentTrapTable->Flags, TotalCycles);
 }
-bool CProcessPool::IsTrapAddress(Uint16 Addr) { return CurrentTrapTable->TrapAddrFlags[Addr >> 5]&(1 << (Addr&31)) ? true : false; }
+bool CProcessPool::IsTrapAddress(Uint16 Addr) { return CurrentTrapTable->Flags.Addresses[Addr >> 5]&(1 << (Addr&31)) ? true : false; }
 bool CProcessPool::ClaimTrapAddressSet(Uint32 id, Uint16 Value, Uint16 Mask)
 {
 	/* thick interpretation */
@@ -977,7 +1606,7 @@ bool CProcessPool::ClaimTrapAddressSet(Uint32 id, Uint16 Value, Uint16 Mask)
 	{
 		if((BC&Mask) == Value)
 		{
-			CurrentTrapTable->TrapAddrFlags[BC >> 5] |= (1 << (BC&31));
+			CurrentTrapTable->SetFlag(BC);
 			if(!CurrentTrapTable->TrapAddrDevices[BC >> 8])
 			{
 				CurrentTrapTable->TrapAddrDevices[BC >> 8] = new Uint32[256];
@@ -1002,7 +1631,7 @@ bool CProcessPool::ClaimTrapAddress(Uint32 id, Uint16 Value, Uint16 Mask)
 				int c = NumTrapTables;
 				while(c--)
 				{
-					AllTrapTables[c].TrapAddrFlags[BC >> 5] |= (1 << (BC&31));
+					AllTrapTables[c].SetFlag(BC);
 					if(!AllTrapTables[c].TrapAddrDevices[BC >> 8])
 						AllTrapTables[c].TrapAddrDevices[BC >> 8] = new Uint32[256];
 					AllTrapTables[c].TrapAddrDevices[BC >> 8][BC & 0xff] = id;
@@ -1015,7 +1644,7 @@ bool CProcessPool::ClaimTrapAddress(Uint32 id, Uint16 Value, Uint16 Mask)
 		int c = NumTrapTables;
 		while(c--)
 		{
-			AllTrapTables[c].TrapAddrFlags[Value >> 5] |= (1 << (Value&31));
+			AllTrapTables[c].SetFlag(Value);
 			if(!AllTrapTables[c].TrapAddrDevices[Value >> 8])
 				AllTrapTables[c].TrapAddrDevices[Value >> 8] = new Uint32[256];
 			AllTrapTables[c].TrapAddrDevices[Value >> 8][Value & 0xff] = id;
@@ -1037,7 +1666,7 @@ bool CProcessPool::ReleaseTrapAddress(Uint32 id, Uint16 Value, Uint16 Mask)
 			{
 				int c = NumTrapTables;
 				while(c--)
-					AllTrapTables[c].TrapAddrFlags[BC >> 5] &= ~(1 << (BC&31));
+					AllTrapTables[c].ClearFlag(BC);
 			}
 		}
 	}
@@ -1045,7 +1674,7 @@ bool CProcessPool::ReleaseTrapAddress(Uint32 id, Uint16 Value, Uint16 Mask)
 	{
 		int c = NumTrapTables;
 		while(c--)
-			AllTrapTables[c].TrapAddrFlags[Value >> 5] &= ~(1 << (Value&31));
+			AllTrapTables[c].ClearFlag(Value);
 	}
 
 	return true;
@@ -1091,6 +1720,8 @@ void CProcessPool::Message(PPMessage msg, void *parameter)
 			- CPU encountered an unknown operation
 			- tape data has started loading
 			- tape data has stopped loading
+			- one of the special keys has been pressed
+			- a saved state couldn't be written
 	*/
 
 	switch(msg)
@@ -1107,10 +1738,18 @@ void CProcessPool::Message(PPMessage msg, void *parameter)
 		case PPM_FSTOGGLE:
 			DebugMessage(PPDEBUG_FSTOGGLE);
 		break;
+		case PPM_TURBOTOGGLE:
+			Turbo = !Turbo;
+			SetSpeed();
+		break;
+		case PPM_REWIND:
+			RewindPending = !RewindBuffer.IsEmpty();
+		break;
 
 		case PPM_CPUDIED: DebugMessage(PPDEBUG_KILLINSTR); break;
 		case PPM_UNKNOWNOP: DebugMessage(PPDEBUG_UNKNOWNOP); break;
 		case PPM_GUI: DebugMessage(PPDEBUG_GUI); break;
+		case PPM_SAVEFAILED: DebugMessage(PPDEBUG_SAVEFAILED); break;
 
 		case PPM_HARDRESET:
 			IOCtl(IOCTL_SUPERRESET);
@@ -1122,6 +1761,10 @@ bool CProcessPool::IOCtl(Uint32 Control, void *Parameter, Uint32 TimeStamp)
 {
 	bool Handled = false;
 
+#ifdef PPOOL_STATISTICS
+	Statistics.IOCtls++;
+#endif
+
 	/* take any 'special' actions that flow from this IOCtl but don't affect how it is handled otherwise */
 	switch(Control)
 	{
@@ -1156,36 +1799,16 @@ bool CProcessPool::IOCtl(Uint32 Control, void *Parameter, Uint32 TimeStamp)
 	switch(Control)
 	{
 		case PPOOLIOCTL_MUTEXWAIT:
-		case PPOOLIOCTL_BREAK:
-			SDL_mutexP(IOCtlMutex);
-				IOCtlBuffer[IOCtlBufferWrite].Control = Control;
-				IOCtlBuffer[IOCtlBufferWrite].TimeStamp = TimeStamp;
-				IOCtlBuffer[IOCtlBufferWrite].Parameter = Parameter;
-
-				IOCtlBufferWrite = (IOCtlBufferWrite+1)&(IOCTLBUFFER_LENGTH-1);
+			SDL_mutexP(RunningMutex); //grab running mutex so that when the emulation thread parks, it stays parked
+			Command(PPCMD_PARK);
+		return true;
 
-				if(Control == PPOOLIOCTL_MUTEXWAIT)
-				{
-					SDL_mutexP(RunningMutex); //grab running mutex so that when this message is processed, emulation will pause
-				}
-			SDL_mutexV(IOCtlMutex);
-				if(Control == PPOOLIOCTL_MUTEXWAIT)
-				{
-					/* hang around for main thread to get to block */
-					while(MainThreadRunning)
-						SDL_Delay(10);
-				}
-			Handled = true;
-		break;
+		case PPOOLIOCTL_BREAK:
+			Command(PPCMD_BREAK, NULL, 0, false);
+		return true;
 
 		case IOCTL_SETCONFIG:
-		{
-			GetExclusivity();
-			SetNonResetConfiguration((ElectronConfiguration *)Parameter);
-			int c = NumConnectedDevices;
-			while(c--) ConfigDirty |= ConnectedDevices[c].Component->IOCtl(Control, Parameter, TimeStamp);
-			ReleaseExclusivity();
-		}
+			Command(PPCMD_SETCONFIG, Parameter);
 		return true;
 
 		case IOCTL_GETCONFIG:
@@ -1198,6 +1821,18 @@ bool CProcessPool::IOCtl(Uint32 Control, void *Parameter, Uint32 TimeStamp)
 			Handled = true;
 		return true;
 
+#ifdef PPOOL_STATISTICS
+		case PPOOLIOCTL_GETSTATISTICS:
+			GetStatistics(*(PPStatistics *)Parameter);
+		return true;
+
+		case PPOOLIOCTL_RESETSTATISTICS:
+			GetExclusivity();
+			ResetStatistics();
+			ReleaseExclusivity();
+		return true;
+#endif
+
 		default:
 		{
 			int c = NumConnectedDevices;
@@ -1214,5 +1849,5 @@ void CProcessPool::SendInitialIOCtls()
 	IOCtl(IOCTL_SETRST, NULL, TotalCycles);
 	IOCtl(IOCTL_SETNMI, NULL, TotalCycles);
 	IOCtl(IOCTL_SETIRQ, NULL, TotalCycles);
-	IOCtl(IOCTL_NEWTRAPFLAGS, (void *)CurrentTrapTable, TotalCycles);
+	IOCtl(IOCTL_NEWTRAPFLAGS, (void *)&CurrentTrapTable->Flags, TotalCycles);
 }
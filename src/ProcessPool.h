@@ -3,6 +3,9 @@
 
 #include "SDL.h"
 #include "SDL_thread.h"
+#include "Rewind.h"
+#include "StateWriter.h"
+#include <stdio.h>
 
 class CComponentBase;
 class CUEFChunk;
@@ -19,7 +22,7 @@ enum PPMessage
 {
 	PPM_CPUDIED, PPM_TAPEDATA_START, PPM_TAPEDATA_STOP, PPM_UNKNOWNOP,
 	PPM_QUIT, PPM_HARDRESET, PPM_FSTOGGLE, PPM_ICONIFY, PPM_GUI,
-	PPM_TAPEDATA_TRANSIENT
+	PPM_TAPEDATA_TRANSIENT, PPM_TURBOTOGGLE, PPM_REWIND, PPM_SAVEFAILED
 };
 
 class CDisplay;
@@ -45,13 +48,58 @@ class CPlus1;
 #define ROMTYPE_FS			0x04
 #define ROMTYPE_LANGUAGE	0x05
 
-#define IOCTLBUFFER_LENGTH	32
+#define PPCOMMAND_LENGTH	32
 
 #define PPOOLIOCTL_BREAK		0x400
 #define PPOOLIOCTL_MUTEXWAIT	0x401
+#define PPOOLIOCTL_GETSTATISTICS	0x402	/* Parameter is a PPStatistics *, only if built with PPOOL_STATISTICS */
+#define PPOOLIOCTL_RESETSTATISTICS	0x403
 
 #include "Configuration/ElectronConfiguration.h"
 
+/* commands for CProcessPool::Command */
+enum PPCommandType
+{
+	PPCMD_BREAK,		/* presses break for 1/25 of a second */
+	PPCMD_PARK,			/* holds the emulation thread - see GetExclusivity */
+	PPCMD_SETCONFIG,	/* Parameter is an ElectronConfiguration *, as per IOCTL_SETCONFIG */
+	PPCMD_INSERTTAPE,	/* Parameter is a filename, result is whether it opened */
+	PPCMD_EJECTTAPE,
+	PPCMD_REWINDTAPE,
+	PPCMD_LOADTAPEFILE,	/* Parameter is a TapeFileLoad *, result is whether the file was found and loaded */
+	PPCMD_INSERTDISC,	/* Parameter is a filename, Value the drive, result is whether it opened */
+	PPCMD_EJECTDISC,	/* Value is the drive */
+	PPCMD_REWIND		/* steps back to the most recent rewind capture at the end of the current field */
+};
+
+/* what IOCTL_NEWTRAPFLAGS points to - one bit per address, plus a count of
+trapped addresses within each page so that pages with none can skip the
+bit test entirely */
+struct PPTrapFlags
+{
+	Uint32 Addresses[2048];
+	Uint16 PageCounts[256];
+};
+
+#ifdef PPOOL_STATISTICS
+/* where the time went. Per component arrays are indexed as per the
+connected device list - so the CPU is always entry 0. Wall time spent in
+trapped reads and writes is counted against the CPU */
+struct PPStatistics
+{
+	Uint32 NumComponents;
+	CComponentBase *Components[16];
+
+	Uint64 ComponentTime[16];		/* wall time inside Update, in TimeUnitsPerSecond units */
+	Uint32 ComponentUpdates[16];	/* number of calls to Update */
+	Uint32 TrapReads[16], TrapWrites[16];	/* trapped accesses dispatched to each component */
+	Uint64 TimeUnitsPerSecond;
+
+	Uint32 IOCtls;					/* calls to CProcessPool::IOCtl */
+	Uint32 Frames, CatchupFrames;	/* fields run, and how many of them were in catch up mode */
+};
+#endif
+
 class CProcessPool
 {
 	public:
@@ -69,8 +117,11 @@ class CProcessPool
 			bool Open(char *name);
 			void Close(Uint32);
 
-			/* save state */
+			/* save state - the file is written in the background, a
+			failure to do so being reported as PPDEBUG_SAVEFAILED. StateSaved
+			waits for the last save and returns whether it was written */
 			bool SaveState(char *name);
+			bool StateSaved();
 
 			/* retrieves machine type */
 			bool GetConfiguration(ElectronConfiguration &);
@@ -90,6 +141,15 @@ class CProcessPool
 			/* stops emulation, but preserves machine state */
 			void Stop();
 
+			/* performs a command at the next boundary between emulation
+			slices, so without having to Stop first. Any number of threads
+			may post commands. If Wait is true then this doesn't return
+			until the command is done, and returns its result; otherwise
+			Parameter must remain valid until then. Commands are performed
+			immediately if emulation isn't running. Don't post a command
+			with Wait set while holding exclusivity */
+			bool Command(PPCommandType, void *Parameter = NULL, Uint32 Value = 0, bool Wait = true);
+
 			/* if a read or write is attempted to a monitor address,
 			Go returns */
 			void SetDebugAddress(Uint16);
@@ -99,6 +159,13 @@ class CProcessPool
 			/* sets execution limits */
 			void SetCycleLimit(Uint32);
 
+#ifdef PPOOL_STATISTICS
+			/* prints the statistics gathered so far - they can also be
+			obtained via PPOOLIOCTL_GETSTATISTICS. Also happens automatically
+			on destruction */
+			void DumpStatistics(FILE *);
+#endif
+
 			/* takes a combination of PPDEBUG_??? flags in order to
 			determine what elmulation events to debug */
 			void SetDebugFlags(Uint32);
@@ -111,6 +178,14 @@ class CProcessPool
 			void SuspendComponent(Uint32 id);
 			void ResumeComponent(Uint32 id);
 
+			/* components otherwise have Update called only once the
+			number of cycles they last returned from it has elapsed. This
+			asks for component id to be brought up to date at the end of
+			the current slice, e.g. because something it was told by a
+			Write means that it now wants attention sooner. For the
+			emulation thread only */
+			void RequestUpdate(Uint32 id);
+
 		/* this lot are for connected Components to call */
 			bool IOCtl(Uint32 Control, void *Parameter = NULL, Uint32 TimeStamp = 0);
 			bool Write(Uint16 Addr, Uint32 TimeStamp, Uint8 Data8, Uint32 Data32);
@@ -145,7 +220,9 @@ class CProcessPool
 				TrapTable();
 				~TrapTable();
 				void Clear();
-				Uint32 TrapAddrFlags[2048];
+				void SetFlag(Uint16 Addr);
+				void ClearFlag(Uint16 Addr);
+				PPTrapFlags Flags;
 				Uint32 *TrapAddrDevices[256];
 		} *CurrentTrapTable, *AllTrapTables;
 		Uint32 NumTrapTables;
@@ -159,6 +236,26 @@ class CProcessPool
 		} ConnectedDevices[16];
 		Uint32 NumConnectedDevices;
 
+		/*
+
+			scheduling - every enabled component other than the CPU has a
+			Deadline, being the absolute cycle at which it next wants
+			Update called. EventHeap is a binary heap of component numbers
+			ordered by Deadline, and the CPU is run straight to whichever
+			is soonest. LastUpdate is the cycle each component was last
+			brought up to date at
+
+		*/
+		Uint32 Deadline[16], LastUpdate[16];
+		Uint32 EventHeap[16], EventHeapPos[16], EventHeapSize;
+		void BuildSchedule();
+		bool IsScheduled(Uint32 id);
+		void SiftUp(Uint32 pos);
+		void SiftDown(Uint32 pos);
+		void UpdateComponent(Uint32 id, bool Catchup);
+		void SyncComponents(bool Catchup);
+		void FinishOpcode();
+
 		/* blah */
 		CDisplay *Disp;
 		C6502 *CPU;
@@ -171,6 +268,31 @@ class CProcessPool
 		bool InTape;
 		volatile unsigned int InTapeTransient;
 
+		/* speed control - Speed is the current multiple of real time, 0
+		for unlimited, being either the normal or the turbo speed from the
+		configuration. At 1x pacing is as it always was, otherwise all but
+		one in every FrameSkip fields is run in catch up mode */
+		bool Turbo;
+		Uint32 Speed;
+		void SetSpeed();
+
+		/* rewinding - every Rewind.Interval fields the machine state goes
+		into RewindBuffer, and a request to step back is acted upon at the
+		end of the field it arrives in. The buffer is emptied whenever
+		media or the machine configuration changes. RewindMemory is where
+		RAM is gathered on its way in and out, REWIND_MAXMEMORY bytes */
+		CRewindBuffer RewindBuffer;
+		Uint8 *RewindMemory;
+		Uint32 RewindFields;
+		volatile bool RewindPending;
+		void CaptureRewindState();
+		bool RestoreRewindState();
+		void PutStateChunk(CUEFChunk *, Uint16 Id);
+
+		/* saved states are captured into memory under exclusivity, and
+		written out by StateWriter once the emulation is going again */
+		CStateWriter StateWriter;
+
 		/* thread related */
 		SDL_Thread *UpdateThread;
 		static int UpdateHelper(void *);
@@ -183,6 +305,15 @@ class CProcessPool
 		Uint32 MainThreadID;
 
 		volatile bool Quit;
+
+#ifdef PPOOL_STATISTICS
+		PPStatistics Statistics;
+		Uint64 StatisticsTime;
+		static Uint64 ReadTimer();
+		void GetStatistics(PPStatistics &);
+		void ResetStatistics();
+		const char *ComponentName(CComponentBase *);
+#endif
 		
 		/* things to debug on */
 		Uint32 DebugMask;
@@ -194,15 +325,24 @@ class CProcessPool
 		void SetNonResetConfiguration(ElectronConfiguration *NewCfg, bool force = false);
 		void SetResetConfiguration(void);
 
-		/* IOCtl buffer, for thread communications */
-		struct IOCtlRecord
+		/* command queue, for thread communications. Posting threads take
+		CommandMutex between themselves, so that checking MainThreadRunning
+		and queueing happen as one; the emulation thread reads the queue
+		without it and takes it only to stop accepting commands and around
+		any it then finds left over. MainThreadRunning is true for as long
+		as it accepts them */
+		struct PPCommandRecord
 		{
-			Uint32 Control;
+			PPCommandType Type;
 			void *Parameter;
-			Uint32 TimeStamp;
-		} IOCtlBuffer[IOCTLBUFFER_LENGTH];
-		unsigned int IOCtlBufferRead, IOCtlBufferWrite;
-		SDL_mutex *IOCtlMutex, *RunningMutex;
+			Uint32 Value;
+			bool *Result;
+			SDL_sem *Done;
+		} Commands[PPCOMMAND_LENGTH];
+		volatile Uint32 CommandRead, CommandWrite;
+		SDL_mutex *CommandMutex, *RunningMutex;
+		void ApplyCommands(bool Catchup);
+		bool ApplyCommand(PPCommandRecord &);
 		volatile bool MainThreadRunning;
 };
 
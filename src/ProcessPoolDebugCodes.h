@@ -23,6 +23,8 @@
 #define PPDEBUG_UNKNOWNOP		0x101
 #define PPDEBUG_OSFAILED		0x200
 #define PPDEBUG_BASICFAILED		0x400
+#define PPDEBUG_FRAMEREADY		0x800
+#define PPDEBUG_SAVEFAILED		0x1000
 
 #define PPDEBUG_GUISTART		0x500
 
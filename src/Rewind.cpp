@@ -0,0 +1,189 @@
+/*
+
+	ElectrEm (c) 2000-6 Thomas Harte - an Acorn Electron Emulator
+
+	This is open software, distributed under the GPL 2, see 'Copying' for
+	details
+
+	Rewind.cpp
+	==========
+
+	The in-memory ring of recent machine states that rewinding steps
+	back through
+
+*/
+
+#include "Rewind.h"
+#include "zlib.h"
+#include <stdlib.h>
+#include <memory.h>
+
+#define Newest()	Records[(Oldest + Count - 1)%REWIND_MAXRECORDS]
+
+CRewindBuffer::CRewindBuffer()
+{
+	Oldest = Count = 0;
+	CurrentLength = Limit = Used = 0;
+	Current = new Uint8[REWIND_MAXMEMORY];
+	Scratch = new Uint8[compressBound(REWIND_MAXMEMORY)];
+}
+
+CRewindBuffer::~CRewindBuffer()
+{
+	Clear();
+	delete[] Current;
+	delete[] Scratch;
+}
+
+void CRewindBuffer::SetLimit(Uint32 Bytes)
+{
+	Limit = Bytes;
+	while(Count && (Used + CurrentLength > Limit))
+		DropOldest();
+}
+
+void CRewindBuffer::FreeRecord(Record &R)
+{
+	Used -= R.StateLength + R.DeltaLength;
+	free(R.State);
+	free(R.Delta);
+	R.State = R.Delta = NULL;
+	R.StateLength = R.DeltaLength = 0;
+}
+
+void CRewindBuffer::DropOldest()
+{
+	FreeRecord(Records[Oldest]);
+	Oldest = (Oldest+1)%REWIND_MAXRECORDS;
+	Count--;
+	if(!Count) CurrentLength = 0;
+}
+
+void CRewindBuffer::Clear()
+{
+	while(Count)
+		DropOldest();
+	Oldest = 0;
+}
+
+bool CRewindBuffer::IsEmpty()
+{
+	return !Count;
+}
+
+void CRewindBuffer::Push(Uint8 *State, Uint32 StateLength, Uint8 *Memory, Uint32 MemoryLength)
+{
+	if(!Limit || MemoryLength > REWIND_MAXMEMORY) return;
+
+	/* captures of different amounts of memory can't be built from one another */
+	if(Count && MemoryLength != CurrentLength)
+		Clear();
+
+	if(Count)
+	{
+		/* keep the pages of the previous capture that this one has
+		changed, so that it can be rebuilt from this one later. They're
+		packed down within Current, which is about to be replaced anyway */
+		Record &Previous = Newest();
+		Uint32 Length = 0;
+
+		memset(Previous.Pages, 0, sizeof(Previous.Pages));
+		for(Uint32 Page = 0; Page < (MemoryLength >> 8); Page++)
+		{
+			if(memcmp(&Current[Page << 8], &Memory[Page << 8], 256))
+			{
+				Previous.Pages[Page >> 5] |= (Uint32)1 << (Page&31);
+				memmove(&Current[Length], &Current[Page << 8], 256);
+				Length += 256;
+			}
+		}
+
+		if(Length)
+		{
+			uLongf Compressed = compressBound(Length);
+			if(compress2(Scratch, &Compressed, Current, Length, Z_BEST_SPEED) != Z_OK)
+			{
+				/* without a delta the previous capture is lost, and so is everything older */
+				Clear();
+			}
+			else
+			{
+				Previous.Delta = (Uint8 *)malloc(Compressed);
+				memcpy(Previous.Delta, Scratch, Compressed);
+				Previous.DeltaLength = (Uint32)Compressed;
+				Used += Previous.DeltaLength;
+			}
+		}
+	}
+
+	/* a full ring loses its oldest capture */
+	if(Count == REWIND_MAXRECORDS)
+		DropOldest();
+
+	Count++;
+	Record &New = Newest();
+	New.State = (Uint8 *)malloc(StateLength);
+	memcpy(New.State, State, StateLength);
+	New.StateLength = StateLength;
+	New.Delta = NULL;
+	New.DeltaLength = 0;
+	Used += StateLength;
+
+	memcpy(Current, Memory, MemoryLength);
+	CurrentLength = MemoryLength;
+
+	while(Count > 1 && (Used + CurrentLength > Limit))
+		DropOldest();
+}
+
+bool CRewindBuffer::Pop(Uint8 *&State, Uint32 &StateLength, Uint8 *Memory, Uint32 &MemoryLength)
+{
+	if(!Count) return false;
+
+	/* the newest capture is whatever is in Current */
+	Record &Popped = Newest();
+	State = Popped.State;
+	StateLength = Popped.StateLength;
+	Used -= Popped.StateLength;
+	Popped.State = NULL;
+	Popped.StateLength = 0;
+
+	memcpy(Memory, Current, CurrentLength);
+	MemoryLength = CurrentLength;
+	Count--;
+
+	if(!Count)
+	{
+		CurrentLength = 0;
+		return true;
+	}
+
+	/* then put the pages the one before it differed in back into Current */
+	Record &Previous = Newest();
+	if(Previous.Delta)
+	{
+		uLongf Length = REWIND_MAXMEMORY;
+		if(uncompress(Scratch, &Length, Previous.Delta, Previous.DeltaLength) != Z_OK)
+		{
+			Clear();
+			return true;
+		}
+
+		Uint8 *Page = Scratch;
+		for(Uint32 c = 0; c < (CurrentLength >> 8); c++)
+		{
+			if(Previous.Pages[c >> 5] & ((Uint32)1 << (c&31)))
+			{
+				memcpy(&Current[c << 8], Page, 256);
+				Page += 256;
+			}
+		}
+
+		Used -= Previous.DeltaLength;
+		free(Previous.Delta);
+		Previous.Delta = NULL;
+		Previous.DeltaLength = 0;
+	}
+
+	return true;
+}
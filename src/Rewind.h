@@ -0,0 +1,60 @@
+#ifndef __REWIND_H
+#define __REWIND_H
+
+#include "SDL.h"
+
+#define REWIND_MAXRECORDS	256
+#define REWIND_MAXMEMORY	65536
+
+/*
+
+	A ring of machine states for stepping backwards through. Each capture
+	is a blob of component state plus up to 64 kB of RAM. Only the most
+	recent capture's RAM is kept whole - every older capture keeps just
+	the 256 byte pages that differ from the one after it, compressed. So
+	captures are rebuilt newest first, which is the only order rewinding
+	needs.
+
+	Once the total kept exceeds the limit, the oldest captures are dropped
+
+*/
+class CRewindBuffer
+{
+	public:
+		CRewindBuffer();
+		~CRewindBuffer();
+
+		/* sets the most memory, in bytes, that captures may use. 0 disables capturing */
+		void SetLimit(Uint32 Bytes);
+		void Clear();
+		bool IsEmpty();
+
+		/* adds a capture. MemoryLength should be a multiple of 256 */
+		void Push(Uint8 *State, Uint32 StateLength, Uint8 *Memory, Uint32 MemoryLength);
+
+		/* removes the most recent capture, copying its RAM to Memory, which
+		must have room for REWIND_MAXMEMORY bytes. State is malloc'd, and
+		becomes the caller's to free */
+		bool Pop(Uint8 *&State, Uint32 &StateLength, Uint8 *Memory, Uint32 &MemoryLength);
+
+	private:
+		struct Record
+		{
+			Uint8 *State;
+			Uint32 StateLength;
+
+			/* which pages Delta holds, in order, and its compressed length */
+			Uint32 Pages[REWIND_MAXMEMORY >> 13];
+			Uint8 *Delta;
+			Uint32 DeltaLength;
+		} Records[REWIND_MAXRECORDS];
+		Uint32 Oldest, Count;
+
+		Uint8 *Current, *Scratch;
+		Uint32 CurrentLength, Limit, Used;
+
+		void DropOldest();
+		void FreeRecord(Record &);
+};
+
+#endif
@@ -0,0 +1,255 @@
+/*
+
+	ElectrEm (c) 2000-6 Thomas Harte - an Acorn Electron Emulator
+
+	This is open software, distributed under the GPL 2, see 'Copying' for
+	details
+
+	Scaler.cpp
+	==========
+
+	Software scaling for screenshots, the GUI backdrop and anything else
+	that needs the emulated display at a size other than the one it was
+	drawn at
+
+*/
+
+#include "Scaler.h"
+#include <memory.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define SCALER_SSE2
+#endif
+
+CScaler::CScaler()
+{
+	Intermediate = NULL;
+	Columns = NULL;
+	ColumnsSourceW = ColumnsTargetW = ColumnsBytesPerPixel = 0;
+}
+
+CScaler::~CScaler()
+{
+	if(Intermediate) SDL_FreeSurface(Intermediate);
+	delete[] Columns;
+}
+
+#define Replicate(type, n)\
+{\
+	type *Src = (type *)Source, *Dst = (type *)Target;\
+	int x = SourceW;\
+	while(x--)\
+	{\
+		type Pixel = *Src++;\
+		int c = n;\
+		while(c--)\
+			*Dst++ = Pixel;\
+	}\
+}
+
+void CScaler::ScaleLine(Uint8 *Source, int SourceW, Uint8 *Target, int TargetW, int BytesPerPixel)
+{
+	int Ratio = TargetW / SourceW;
+	if(Ratio*SourceW != TargetW) Ratio = 0;
+
+	switch(Ratio)
+	{
+		case 1:
+			memcpy(Target, Source, TargetW*BytesPerPixel);
+		return;
+
+		case 2:
+		case 3:
+#ifdef SCALER_SSE2
+			/* pixel doubling at 16 and 32bpp is just an interleave of each group with itself */
+			if(Ratio == 2 && (BytesPerPixel == 2 || BytesPerPixel == 4))
+			{
+				int Groups = (SourceW*BytesPerPixel) >> 4;
+				SourceW -= (Groups << 4) / BytesPerPixel;
+
+				while(Groups--)
+				{
+					__m128i Pixels = _mm_loadu_si128((__m128i *)Source);
+
+					if(BytesPerPixel == 2)
+					{
+						_mm_storeu_si128((__m128i *)Target, _mm_unpacklo_epi16(Pixels, Pixels));
+						_mm_storeu_si128((__m128i *)(Target+16), _mm_unpackhi_epi16(Pixels, Pixels));
+					}
+					else
+					{
+						_mm_storeu_si128((__m128i *)Target, _mm_unpacklo_epi32(Pixels, Pixels));
+						_mm_storeu_si128((__m128i *)(Target+16), _mm_unpackhi_epi32(Pixels, Pixels));
+					}
+
+					Source += 16;
+					Target += 32;
+				}
+			}
+#endif
+			switch(BytesPerPixel)
+			{
+				case 1: Replicate(Uint8, Ratio);	break;
+				case 2: Replicate(Uint16, Ratio);	break;
+				case 4: Replicate(Uint32, Ratio);	break;
+
+				case 3:
+				{
+					int x = SourceW;
+					while(x--)
+					{
+						int c = Ratio;
+						while(c--)
+						{
+							Target[0] = Source[0];
+							Target[1] = Source[1];
+							Target[2] = Source[2];
+							Target += 3;
+						}
+						Source += 3;
+					}
+				}
+				break;
+			}
+		return;
+	}
+
+	/* no whole number ratio, so step through the table of columns */
+	if(!Columns || (ColumnsSourceW != SourceW) || (ColumnsTargetW != TargetW) || (ColumnsBytesPerPixel != BytesPerPixel))
+	{
+		delete[] Columns;
+		Columns = new int[TargetW];
+		for(int x = 0; x < TargetW; x++)
+			Columns[x] = (int)(((Uint32)x * (Uint32)SourceW) / (Uint32)TargetW) * BytesPerPixel;
+
+		ColumnsSourceW = SourceW;
+		ColumnsTargetW = TargetW;
+		ColumnsBytesPerPixel = BytesPerPixel;
+	}
+
+	int x;
+	switch(BytesPerPixel)
+	{
+		case 1:
+			for(x = 0; x < TargetW; x++)
+				Target[x] = Source[Columns[x]];
+		break;
+
+		case 2:
+			for(x = 0; x < TargetW; x++)
+				((Uint16 *)Target)[x] = *(Uint16 *)&Source[Columns[x]];
+		break;
+
+		case 3:
+			for(x = 0; x < TargetW; x++)
+			{
+				Target[0] = Source[Columns[x]+0];
+				Target[1] = Source[Columns[x]+1];
+				Target[2] = Source[Columns[x]+2];
+				Target += 3;
+			}
+		break;
+
+		case 4:
+			for(x = 0; x < TargetW; x++)
+				((Uint32 *)Target)[x] = *(Uint32 *)&Source[Columns[x]];
+		break;
+	}
+}
+
+void CScaler::Scale(Uint8 *Source, int SourcePitch, int SourceW, int SourceH, Uint8 *Target, int TargetPitch, int TargetW, int TargetH, int BytesPerPixel)
+{
+	if(SourceW <= 0 || SourceH <= 0 || TargetW <= 0 || TargetH <= 0) return;
+
+	int LineLength = TargetW*BytesPerPixel;
+	int LastSourceY = -1;
+	Uint8 *LastTarget = NULL;
+
+	for(int y = 0; y < TargetH; y++)
+	{
+		int SourceY = (int)(((Uint32)y * (Uint32)SourceH) / (Uint32)TargetH);
+
+		if(SourceY == LastSourceY)
+			memcpy(Target, LastTarget, LineLength);
+		else
+			ScaleLine(&Source[SourceY*SourcePitch], SourceW, Target, TargetW, BytesPerPixel);
+
+		LastSourceY = SourceY;
+		LastTarget = Target;
+		Target += TargetPitch;
+	}
+}
+
+SDL_Surface *CScaler::GetIntermediate(int w, int h, SDL_PixelFormat *Format)
+{
+	if(	!Intermediate ||
+		(Intermediate->w != w) || (Intermediate->h != h) ||
+		(Intermediate->format->BitsPerPixel != Format->BitsPerPixel) ||
+		(Intermediate->format->Rmask != Format->Rmask) ||
+		(Intermediate->format->Gmask != Format->Gmask) ||
+		(Intermediate->format->Bmask != Format->Bmask))
+	{
+		if(Intermediate) SDL_FreeSurface(Intermediate);
+		Intermediate = SDL_CreateRGBSurface(SDL_SWSURFACE, w, h, Format->BitsPerPixel, Format->Rmask, Format->Gmask, Format->Bmask, Format->Amask);
+	}
+
+	/* palettes may change without anything else doing so */
+	if(Intermediate && Format->palette)
+		SDL_SetColors(Intermediate, Format->palette->colors, 0, Format->palette->ncolors);
+
+	return Intermediate;
+}
+
+void CScaler::Draw(Uint8 *Source, int SourcePitch, int Width, int Height, SDL_PixelFormat *SourceFormat, SDL_Surface *Target, SDL_Rect *Rect)
+{
+	SDL_Rect Area;
+	if(Rect)
+		Area = *Rect;
+	else
+	{
+		Area.x = Area.y = 0;
+		Area.w = Target->w;
+		Area.h = Target->h;
+	}
+
+	/* clip to the target */
+	if(Area.x >= Target->w || Area.y >= Target->h) return;
+	if(Area.x + Area.w > Target->w) Area.w = Target->w - Area.x;
+	if(Area.y + Area.h > Target->h) Area.h = Target->h - Area.y;
+	if(!Area.w || !Area.h) return;
+
+	SDL_PixelFormat *TargetFormat = Target->format;
+	bool SameFormat =
+		(TargetFormat->BitsPerPixel == SourceFormat->BitsPerPixel) &&
+		(TargetFormat->Rmask == SourceFormat->Rmask) &&
+		(TargetFormat->Gmask == SourceFormat->Gmask) &&
+		(TargetFormat->Bmask == SourceFormat->Bmask);
+
+	if(SameFormat && SourceFormat->palette)
+		SameFormat =
+			TargetFormat->palette &&
+			(TargetFormat->palette->ncolors == SourceFormat->palette->ncolors) &&
+			!memcmp(TargetFormat->palette->colors, SourceFormat->palette->colors, SourceFormat->palette->ncolors*sizeof(SDL_Color));
+
+	if(SameFormat)
+	{
+		if(SDL_LockSurface(Target)) return;
+		Scale(	Source, SourcePitch, Width, Height,
+				(Uint8 *)Target->pixels + Area.y*Target->pitch + Area.x*TargetFormat->BytesPerPixel, Target->pitch, Area.w, Area.h,
+				TargetFormat->BytesPerPixel);
+		SDL_UnlockSurface(Target);
+	}
+	else
+	{
+		/* scale in the source format, then let SDL convert */
+		SDL_Surface *Temp = GetIntermediate(Area.w, Area.h, SourceFormat);
+		if(!Temp || SDL_LockSurface(Temp)) return;
+		Scale(	Source, SourcePitch, Width, Height,
+				(Uint8 *)Temp->pixels, Temp->pitch, Area.w, Area.h,
+				SourceFormat->BytesPerPixel);
+		SDL_UnlockSurface(Temp);
+
+		SDL_BlitSurface(Temp, NULL, Target, &Area);
+	}
+}
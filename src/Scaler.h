@@ -0,0 +1,41 @@
+#ifndef __SCALER_H
+#define __SCALER_H
+
+#include "SDL.h"
+
+/*
+
+	Scales pictures between buffers or onto SDL surfaces. Whole number
+	horizontal ratios of up to 3 are done by replicating pixels, anything
+	else by stepping through a table of source columns that is kept
+	between calls. Target lines that come from the same source line as
+	the one above are copied rather than scaled again
+
+*/
+class CScaler
+{
+	public:
+		CScaler();
+		~CScaler();
+
+		/* scales the Width x Height picture at Source, which is in
+		SourceFormat, into Rect of Target (or all of Target if Rect is
+		NULL). If the formats differ then the picture goes via an
+		intermediate surface, which is kept for the next call */
+		void Draw(Uint8 *Source, int SourcePitch, int Width, int Height, SDL_PixelFormat *SourceFormat, SDL_Surface *Target, SDL_Rect *Rect = NULL);
+
+		/* scales between two buffers of the same pixel format */
+		void Scale(Uint8 *Source, int SourcePitch, int SourceW, int SourceH, Uint8 *Target, int TargetPitch, int TargetW, int TargetH, int BytesPerPixel);
+
+	private:
+		SDL_Surface *Intermediate;
+		SDL_Surface *GetIntermediate(int w, int h, SDL_PixelFormat *Format);
+
+		/* byte offsets of the source pixel for each target column */
+		int *Columns;
+		int ColumnsSourceW, ColumnsTargetW, ColumnsBytesPerPixel;
+
+		void ScaleLine(Uint8 *Source, int SourceW, Uint8 *Target, int TargetW, int BytesPerPixel);
+};
+
+#endif
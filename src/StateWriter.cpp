@@ -0,0 +1,116 @@
+/*
+
+	ElectrEm (c) 2000-6 Thomas Harte - an Acorn Electron Emulator
+
+	This is open software, distributed under the GPL 2, see 'Copying' for
+	details
+
+	StateWriter.cpp
+	===============
+
+	Background writing of saved states
+
+*/
+
+#include "StateWriter.h"
+#include "UEF.h"
+#include "ProcessPool.h"
+#include <stdlib.h>
+#include <string.h>
+
+CStateWriter::CStateWriter(CProcessPool *pool)
+{
+	PPPtr = pool;
+	Thread = NULL;
+	Written = true;
+	Name = NULL;
+	State = NULL;
+}
+
+CStateWriter::~CStateWriter()
+{
+	Wait();
+}
+
+void CStateWriter::Queue(const char *name, Uint16 version, Uint8 *state, Uint32 statelength, int level)
+{
+	Wait();
+
+	Name = strdup(name);
+	Version = version;
+	State = state;
+	StateLength = statelength;
+	Level = level;
+
+	if(!(Thread = SDL_CreateThread(WriteHelper, this)))
+		Write();
+}
+
+bool CStateWriter::Wait()
+{
+	if(Thread)
+	{
+		SDL_WaitThread(Thread, NULL);
+		Thread = NULL;
+	}
+
+	return Written;
+}
+
+int CStateWriter::WriteHelper(void *t)
+{
+	return ((CStateWriter *)t)->Write();
+}
+
+int CStateWriter::Write()
+{
+	CUEFFile File;
+	CUEFChunkSelector *Selector = NULL;
+	bool Saved = false;
+
+	File.SetCompression(Level);
+	if(File.Open(Name, Version, "rw") || File.Open(Name, Version, "w"))
+		Selector = File.GetSelectorPtr();
+
+	if(Selector)
+	{
+		/* delete any state chunks, restarting the search after each as
+		removal moves on to the next chunk without considering it */
+		while(Selector->FindIdMajor(0x04))
+		{
+			Selector->RemoveCurrentChunk();
+			Selector->Reset();
+		}
+
+		/* append the new ones */
+		Selector->Seek(0, SEEK_END);
+		Uint8 *Ptr = State;
+		while(Ptr + 6 <= State + StateLength)
+		{
+			Uint16 Id = Ptr[0] | (Ptr[1] << 8);
+			Uint32 Length = Ptr[2] | (Ptr[3] << 8) | (Ptr[4] << 16) | ((Uint32)Ptr[5] << 24);
+
+			CUEFChunk *Chunk = Selector->EstablishChunk();
+			Chunk->SetId(Id);
+			Chunk->Write(&Ptr[6], Length);
+
+			Ptr += 6 + Length;
+		}
+
+		File.ReleaseSelectorPtr(Selector);
+
+		/* only now is the file actually written, and renamed into place */
+		Saved = File.Close();
+	}
+
+	free(State);
+	free(Name);
+	State = NULL;
+	Name = NULL;
+
+	Written = Saved;
+	if(!Written)
+		PPPtr->Message(PPM_SAVEFAILED);
+
+	return Written ? 0 : -1;
+}
@@ -0,0 +1,53 @@
+#ifndef __STATEWRITER_H
+#define __STATEWRITER_H
+
+#include "SDL.h"
+#include "SDL_thread.h"
+
+/*
+
+	Writes saved states out on a thread of its own, so that the emulation
+	only has to stop for as long as it takes to copy the machine state into
+	memory.
+
+	A state is handed over as a blob of chunks, each a 2 byte id and 4 byte
+	length followed by the chunk contents. Those replace any 0x04xx chunks
+	already in the named file, everything else in it being kept. The file
+	is written in full to a temporary next to it and then renamed over it,
+	so an interrupted save never leaves a half written file behind. A save
+	that can't be written is reported to the owning process pool as
+	PPM_SAVEFAILED
+
+*/
+class CProcessPool;
+
+class CStateWriter
+{
+	public:
+		CStateWriter(CProcessPool *);
+		~CStateWriter();
+
+		/* queues a save. Name is a resolved file name, State is malloc'd
+		and becomes the writer's to free. Level is the zlib compression
+		level to use. Waits for any save still in progress first */
+		void Queue(const char *Name, Uint16 Version, Uint8 *State, Uint32 StateLength, int Level);
+
+		/* blocks until the last queued save has been written, returning
+		false if it couldn't be */
+		bool Wait();
+
+	private:
+		CProcessPool *PPPtr;
+		SDL_Thread *Thread;
+		static int WriteHelper(void *);
+		int Write();
+
+		char *Name;
+		Uint16 Version;
+		Uint8 *State;
+		Uint32 StateLength;
+		int Level;
+		bool Written;
+};
+
+#endif
@@ -48,6 +48,14 @@ that the tape and ROM filing system are intertwined.
 
 Under emulation I suppose you could easily feed the system
 'tape bytes' at the same hook points.
+
+The tape is no longer decoded as it is read. Open decodes it once into a
+catalogue of blocks and the service call is answered straight from that.
+F4DF (f50c on the 64 kB ROM) is where each byte is pushed through the CFS
+state machine held in &c2. Once the header is done and the data stage
+(&c2 = 4) begins, the whole block is dropped into memory at (&b0), the CRC
+in &be/&bf is brought up to date and the machine is left expecting the
+data CRC (&c2 = 5), exactly as if it had seen every byte.
 */
 
 #include "Tape.h"
@@ -55,11 +63,14 @@ Under emulation I suppose you could easily feed the system
 #include "../ProcessPool.h"
 #include "../6502.h"
 
+#include <stdlib.h>
 #include <string.h>
 #include <ctype.h>
 
-void CTape::SetTrapAddresses(bool Enabled, bool Slogger64)
+void CTape::SetTrapAddresses(bool Enabled, bool S64)
 {
+	Slogger64 = S64;
+
 	/* unclaim all */
 	
 		/* 32 kB ROM */
@@ -69,6 +80,7 @@ void CTape::SetTrapAddresses(bool Enabled, bool Slogger64)
 			PPPtr->ReleaseTrapAddress(PPNum, 0xfa51);	PPPtr->ReleaseTrapAddress(PPNum, 0xfa52);
 
 			PPPtr->ReleaseTrapAddress(PPNum, 0xf0a8);
+			PPPtr->ReleaseTrapAddress(PPNum, 0xf4df);
 
 		/* 64 kB ROM */
 			PPPtr->ReleaseTrapAddress(PPNum, 0xf512);	PPPtr->ReleaseTrapAddress(PPNum, 0xf513);
@@ -77,6 +89,7 @@ void CTape::SetTrapAddresses(bool Enabled, bool Slogger64)
 			PPPtr->ReleaseTrapAddress(PPNum, 0xfa79);	PPPtr->ReleaseTrapAddress(PPNum, 0xfa7a);
 
 			PPPtr->ReleaseTrapAddress(PPNum, 0xf091);
+			PPPtr->ReleaseTrapAddress(PPNum, 0xf50c);
 
 	if(Enabled)
 	{
@@ -89,6 +102,7 @@ void CTape::SetTrapAddresses(bool Enabled, bool Slogger64)
 			PPPtr->ClaimTrapAddress(PPNum, 0xfa79);		PPPtr->ClaimTrapAddress(PPNum, 0xfa7a);
 
 			PPPtr->ClaimTrapAddress(PPNum, 0xf091);
+			PPPtr->ClaimTrapAddress(PPNum, 0xf50c);
 		}
 		else
 		{
@@ -98,15 +112,16 @@ void CTape::SetTrapAddresses(bool Enabled, bool Slogger64)
 			PPPtr->ClaimTrapAddress(PPNum, 0xfa51);		PPPtr->ClaimTrapAddress(PPNum, 0xfa52);
 
 			PPPtr->ClaimTrapAddress(PPNum, 0xf0a8);
+			PPPtr->ClaimTrapAddress(PPNum, 0xf4df);
 		}
 	}
 }
 //#define DUMP_FASTACTION
 
-void CTape::TapeGetC(Uint8 &Data8, Uint32 &Data32)
+bool CTape::CatalogueGetC(Uint8 &Data8, Uint32 &Data32)
 {
 	int BitCount = 9;
-	while(1)
+	while(!Feeder->OverRan())
 	{
 		AdvanceBit();
 
@@ -122,102 +137,293 @@ void CTape::TapeGetC(Uint8 &Data8, Uint32 &Data32)
 				{
 					Data8 = (Uint8)(ScrollRegister8 >> 2);
 					Data32 = (Uint32)(ScrollRegister32 >> 8);
-					return;
+					return true;
 				}
 			}
 		}
 		else
 			BitCount = 9;
 	}
+
+	return false;
 }
 
-bool CTape::GetBlock(bool data)
+void CTape::FreeCatalogue()
 {
-	int Overruns = 0;
-	while((Overruns < 2))
+	if(Catalogue)
 	{
-		Feeder->ResetOverRan();
+		free(Catalogue);
+		Catalogue = NULL;
+	}
+	CatalogueLength = CurrentBlock = BlockPtr = 0;
+	TapeHasROMData = false;
+	LoadType = LT_UNKNOWN;
+}
+
+void CTape::BuildCatalogue()
+{
+	int Allocated = 0;
+
+	FreeCatalogue();
+	Feeder->Seek(StartPos);
+	Feeder->ResetOverRan();
 
+	while(!Feeder->OverRan())
+	{
 		/* seek high tone */
 		while(((ScrollRegister8&0x3ff) != 0x3ff) && !Feeder->OverRan()) AdvanceBit();
 
 		/* seek beyond high tone */
 		while(((ScrollRegister8&0x3ff) == 0x3ff) && !Feeder->OverRan()) AdvanceBit();
 
-		/* seek synchronisation byte, but quit early if new high tone appears */
+		/* seek synchronisation byte, but start again if new high tone appears */
 		while(((ScrollRegister8&0x3ff) != 0x3ff) && ((ScrollRegister8&0x3ff) != 0x0a9) && !Feeder->OverRan()) AdvanceBit();
+		if((ScrollRegister8&0x3ff) != 0x0a9)
+			continue;
 
-		/* found next block? */
-		if((ScrollRegister8&0x3ff) == 0x0a9)
-			break;
+		if(CatalogueLength == Allocated)
+		{
+			Allocated += 32;
+			Catalogue = (TapeCatalogueEntry *)realloc(Catalogue, sizeof(TapeCatalogueEntry)*Allocated);
+		}
+		TapeCatalogueEntry *Block = &Catalogue[CatalogueLength];
+
+		Block->Data8[0] = (Uint8)(ScrollRegister8 >> 2);
+		Block->Data32[0] = (Uint32)(ScrollRegister32 >> 8);
+		int Ptr = 1;
+		bool Complete = true;
+
+		/* name (including terminator) */
+		while(Ptr < 12)
+		{
+			if(!(Complete = CatalogueGetC(Block->Data8[Ptr], Block->Data32[Ptr]))) break;
+			if(!Block->Data8[Ptr++]) break;
+		}
+		if(!Complete) break;
+
+		memcpy(Block->Name, &Block->Data8[1], 10);
+		Block->Name[Ptr-2 < 10 ? Ptr-2 : 10] = '\0';
+
+		/* load and exec addresses, block number, block length, flags, four spare bytes and the header CRC */
+		int End = Ptr + 19;
+		while(Complete && Ptr < End)
+		{
+			Complete = CatalogueGetC(Block->Data8[Ptr], Block->Data32[Ptr]);
+			Ptr++;
+		}
+		if(!Complete) break;
+
+		Uint8 *Header = &Block->Data8[End - 19];
+		Block->LoadAddress = Header[0] | (Header[1] << 8) | (Header[2] << 16) | ((Uint32)Header[3] << 24);
+		Block->ExecAddress = Header[4] | (Header[5] << 8) | (Header[6] << 16) | ((Uint32)Header[7] << 24);
+		Block->BlockNo = Header[8] | (Header[9] << 8);
+		Block->BlockLength = Header[10] | (Header[11] << 8);
+		Block->Flags = Header[12];
+
+		/* the OS won't accept anything longer than a page either */
+		if(Block->BlockLength > 256)
+			continue;
+
+		/* block body and, if there is one, its CRC */
+		Block->DataStart = Ptr;
+		End = Ptr + Block->BlockLength + (Block->BlockLength ? 2 : 0);
+		while(Complete && Ptr < End)
+		{
+			Complete = CatalogueGetC(Block->Data8[Ptr], Block->Data32[Ptr]);
+			Ptr++;
+		}
+		if(!Complete) break;
+
+		Block->Length = Ptr;
+		Block->EndPos = Feeder->Tell();
+		CatalogueLength++;
+
+#ifdef DUMP_FASTACTION
+		fprintf(stderr, "block: %s %02x [l:%04x]\n", Block->Name, Block->BlockNo, Block->LoadAddress);
+#endif
+	}
+
+	if(TapeHasROMData = (CatalogueLength > 0))
+	{
+		LoadType = LT_CHAIN;
 
-		if(Feeder->OverRan())
+		// check if it looks like a BASIC program
+		int Length = Catalogue[0].BlockLength;
+		Uint8 *TPos = &Catalogue[0].Data8[Catalogue[0].DataStart];
+		while(Length > 4)
 		{
-			Overruns++;
-			if(Overruns == 2)
-				return false;
+			if(TPos[0] != 13) {LoadType = LT_RUN; break; }
+			if((TPos[1]&0x7f) == 0x7f) break;
+
+			Length -= TPos[3];
+			TPos += TPos[3];
 		}
 	}
 
-	/* read header */
-	Uint8 Byte;
-	Uint32 DWord;
-	int Ptr = 0;
+	Feeder->Seek(StartPos);
+	Feeder->ResetOverRan();
+}
+
+void CTape::NextBlock()
+{
+	/* keep the feeder in step, so that things carry on from the right place if the fast hack is switched off */
+	Feeder->Seek(Catalogue[CurrentBlock].EndPos);
+	CurrentBit = Feeder->ReadBit();
+
+	CurrentBlock = (CurrentBlock + 1) % CatalogueLength;
+	BlockPtr = 0;
+}
+
+void CTape::WriteBlock(Uint16 OpAddr, Uint16 Addr, TapeCatalogueEntry *Block)
+{
+	C6502 *CPU = (C6502 *)PPPtr->GetWellDefinedComponent(COMPONENT_CPU);
+	Uint8 *Data8 = &Block->Data8[Block->DataStart];
+	Uint32 *Data32 = &Block->Data32[Block->DataStart];
+
+	/* ordinary RAM can be written in one go, anything else goes through the current memory view */
+	if(!Slogger64 && (Addr + Block->BlockLength <= 0x8000))
+		CPU->WriteMemoryBlock(((CULA *)PPPtr->GetWellDefinedComponent(COMPONENT_ULA))->GetMappedAddr(MEM_RAM), Addr, Block->BlockLength, Data8, Data32);
+	else
+	{
+		for(int c = 0; c < Block->BlockLength; c++)
+			CPU->WriteMem(OpAddr, (Uint16)(Addr + c), Data8[c], Data32[c]);
+	}
+}
+
+bool CTape::ServeBlock(Uint16 OpAddr)
+{
+	C6502 *CPU = (C6502 *)PPPtr->GetWellDefinedComponent(COMPONENT_CPU);
+	TapeCatalogueEntry *Block = &Catalogue[CurrentBlock];
+
+	/* only take over at the very start of the data stage of the block currently being served */
+	if(BlockPtr != Block->DataStart || !Block->BlockLength)
+		return false;
+
+	Uint8 FS, State, Ptr, Length;
+	CPU->ReadMem(OpAddr, 0x247, FS);
+	CPU->ReadMem(OpAddr, 0xc2, State);
+	CPU->ReadMem(OpAddr, 0xbc, Ptr);
+	CPU->ReadMem(OpAddr, 0x3c8, Length);
+	if(FS || (State != 4) || Ptr || (Length != (Uint8)Block->BlockLength))
+		return false;
+
+	/* bit 7 of &bd means the block is being skipped; otherwise let the OS deal with anything headed for the tube */
+	Uint8 Skip, TubeLow, TubeHigh, TubeFlags;
+	CPU->ReadMem(OpAddr, 0xbd, Skip);
+	Skip &= 0x80;
+	if(!Skip)
+	{
+		CPU->ReadMem(OpAddr, 0xb2, TubeLow);
+		CPU->ReadMem(OpAddr, 0xb3, TubeHigh);
+		CPU->ReadMem(OpAddr, 0x27a, TubeFlags);
+		if(((TubeLow&TubeHigh) != 0xff) && (TubeFlags&0x80))
+			return false;
+	}
+
+	/* CRC-16 as per F710 */
+	Uint8 CRCLow, CRCHigh;
+	CPU->ReadMem(OpAddr, 0xbe, CRCLow);
+	CPU->ReadMem(OpAddr, 0xbf, CRCHigh);
+	Uint16 CRC = CRCLow | (CRCHigh << 8);
+	for(int c = 0; c < Block->BlockLength; c++)
+	{
+		CRC ^= Block->Data8[Block->DataStart + c] << 8;
+		for(int b = 0; b < 8; b++)
+			CRC = (CRC&0x8000) ? ((CRC << 1) ^ 0x1021) : (CRC << 1);
+	}
+	CPU->WriteMem(OpAddr, 0xbe, (Uint8)CRC);
+	CPU->WriteMem(OpAddr, 0xbf, (Uint8)(CRC >> 8));
+
+	if(!Skip)
+	{
+		Uint8 TargetLow, TargetHigh;
+		CPU->ReadMem(OpAddr, 0xb0, TargetLow);
+		CPU->ReadMem(OpAddr, 0xb1, TargetHigh);
+		WriteBlock(OpAddr, TargetLow | (TargetHigh << 8), Block);
+	}
+
+	/* leave things as the state machine would after the last byte */
+	Uint8 Status;
+	CPU->ReadMem(OpAddr, 0xc0, Status);
+	CPU->WriteMem(OpAddr, 0xc0, (Uint8)(Status - Block->BlockLength));
+	CPU->WriteMem(OpAddr, 0xbc, 1);
+	CPU->WriteMem(OpAddr, 0xc2, 5);
+	BlockPtr += Block->BlockLength;
+
+	return true;
+}
 
-	/* name (including terminator) */
+static bool NameMatches(const char *Wanted, const char *Name)
+{
+	/* CFS names are case insensitive */
+	while(*Wanted && *Name)
+	{
+		if(toupper(*Wanted) != toupper(*Name)) return false;
+		Wanted++; Name++;
+	}
+	return !*Wanted && !*Name;
+}
+
+bool CTape::LoadFile(TapeFileLoad *File)
+{
+	if(!Feeder || !TapeHasROMData)
+		return false;
+
+	C6502State CPUState;
+	((C6502 *)PPPtr->GetWellDefinedComponent(COMPONENT_CPU))->GetState(CPUState);
+
+	/* look for the first block of the file, searching forward from the current position and wrapping once */
+	int Start = CurrentBlock, Searched = 0;
+	while(Searched < CatalogueLength)
+	{
+		if(!Catalogue[Start].BlockNo && (!File->Name || !File->Name[0] || NameMatches(File->Name, Catalogue[Start].Name)))
+			break;
+		Start = (Start + 1) % CatalogueLength;
+		Searched++;
+	}
+	if(Searched == CatalogueLength)
+		return false;
+
+	/* make sure the whole file is present before touching memory */
+	int Block = Start, Expected = 0;
 	while(1)
 	{
-		TapeGetC(Byte, DWord);
+		TapeCatalogueEntry *Entry = &Catalogue[Block];
+		if(strcmp(Entry->Name, Catalogue[Start].Name) || (Entry->BlockNo > Expected))
+			return false;
+		if(Entry->BlockNo == Expected)
+		{
+			Expected++;
+			if(Entry->Flags&0x80) break;
+		}
 
-		TapeBlock.Name[Ptr] = Byte;
-		Ptr++;
-		if(!Byte || (Ptr == 11)) break;
+		Block = (Block + 1) % CatalogueLength;
+		if(Block == Start) return false;
 	}
-	TapeBlock.Name[10] = '\0';
-
-	/* load address */
-	TapeGetC(Byte, DWord); TapeBlock.LoadAddress = Byte;
-	TapeGetC(Byte, DWord); TapeBlock.LoadAddress |= Byte << 8;
-	TapeGetC(Byte, DWord); TapeBlock.LoadAddress |= Byte << 16;
-	TapeGetC(Byte, DWord); TapeBlock.LoadAddress |= Byte << 24;
-
-	/* exec address */
-	TapeGetC(Byte, DWord); TapeBlock.ExecAddress = Byte;
-	TapeGetC(Byte, DWord); TapeBlock.ExecAddress |= Byte << 8;
-	TapeGetC(Byte, DWord); TapeBlock.ExecAddress |= Byte << 16;
-	TapeGetC(Byte, DWord); TapeBlock.ExecAddress |= Byte << 24;
-
-	/* block number */
-	TapeGetC(Byte, DWord); TapeBlock.BlockNo = Byte;
-	TapeGetC(Byte, DWord); TapeBlock.BlockNo |= Byte << 8;
-
-	/* block length */
-	TapeGetC(Byte, DWord); TapeBlock.BlockLength = Byte;
-	TapeGetC(Byte, DWord); TapeBlock.BlockLength |= Byte << 8;
-
-	/* block flags */
-	TapeGetC(TapeBlock.Flags, DWord);
-
-	/* four spare bytes */
-	TapeGetC(Byte, DWord);
-	TapeGetC(Byte, DWord);
-	TapeGetC(Byte, DWord);
-	TapeGetC(Byte, DWord);
-
-	/* CRC */
-	TapeGetC(Byte, DWord);
-	TapeGetC(Byte, DWord);
-
-	if(data)
+
+	File->LoadAddress = Catalogue[Start].LoadAddress;
+	File->ExecAddress = Catalogue[Start].ExecAddress;
+	File->Length = 0;
+
+	/* now load it, skipping any repeated blocks */
+	Block = Start;
+	Expected = 0;
+	while(1)
 	{
-		/* Block body */
-		for(int c = 0; c < TapeBlock.BlockLength; c++)
-			TapeGetC(TapeBlock.Data8[c], TapeBlock.Data32[c]);
+		TapeCatalogueEntry *Entry = &Catalogue[Block];
+		if(Entry->BlockNo == Expected)
+		{
+			WriteBlock(CPUState.pc.a, (Uint16)(File->LoadAddress + File->Length), Entry);
+			File->Length += Entry->BlockLength;
+			Expected++;
+			if(Entry->Flags&0x80) break;
+		}
+		Block = (Block + 1) % CatalogueLength;
 	}
 
-#ifdef DUMP_FASTACTION
-	fprintf(stderr, "block: %s %02x [l:%04x]\n", TapeBlock.Name, TapeBlock.BlockNo, TapeBlock.LoadAddress);
-#endif
+	/* carry on from just after the file */
+	CurrentBlock = Block;
+	NextBlock();
 
 	return true;
 }
@@ -226,7 +432,6 @@ bool CTape::Read(Uint16 Addr, Uint32 TimeStamp, Uint8 &Data8, Uint32 &Data32)
 {
 	C6502State CPUState;
 	C6502 *CPU = (C6502 *)PPPtr->GetWellDefinedComponent(COMPONENT_CPU);
-	static Uint32 LTimeStamp = 0;
 
 	CPU->GetState(CPUState);
 
@@ -244,48 +449,24 @@ bool CTape::Read(Uint16 Addr, Uint32 TimeStamp, Uint8 &Data8, Uint32 &Data32)
 				case 0xf091:
 				{
 					Uint8 T8;
-					Uint32 T32;
-					static bool LastData = false;
-					CPU->ReadMem(CPUState.pc.a, 0x247, T8, T32);
+					CPU->ReadMem(CPUState.pc.a, 0x247, T8);
 					if(CPUState.x8 == 0xe && !T8) //check service call &14 is requested while filing system 0 (tape) is selected
 					{
 						// tape data is requested, so notify processpool that some transient fast processing is desirable
 						PPPtr->Message(PPM_TAPEDATA_TRANSIENT, NULL);
 
-						/* find start of new block if it has been more than half a second since anything was read */
-						LTimeStamp = TimeStamp - LTimeStamp;
-						if(LTimeStamp > 1000000)
-						{
-							while(1)
-							{
-								/* seek high tone */
-								while((ScrollRegister8&0x3ff) != 0x3ff) AdvanceBit();
-
-								/* seek beyond high tone */
-								while((ScrollRegister8&0x3ff) == 0x3ff) AdvanceBit();
-								
-								int c = 8;
-								while(c--) AdvanceBit();
-								CPUState.y8 = (Uint8)(ScrollRegister8 >> 2);
-								CPUState.y32 = (Uint32)(ScrollRegister32 >> 8);
-
-								if(CPUState.y8 == 0x2a)
-									break;
-							}
-						}
-						else
-						{
-							// read a byte of tape data. TODO: FIX ME!
-							do
-							{
-								TapeGetC(CPUState.y8, CPUState.y32);
-								if(LastData) break;
-							}
-							while((ScrollRegister8&0xc00) != 0x400);
-						}
-						LTimeStamp = TimeStamp;
-
-						LastData = (ScrollRegister8&0xc00) == 0x400;
+						/* start from the next block if it has been more than half a second since anything was read */
+						if(BlockPtr && (TimeStamp - LastServiceTime > 1000000))
+							NextBlock();
+						LastServiceTime = TimeStamp;
+
+						TapeCatalogueEntry *Block = &Catalogue[CurrentBlock];
+						CPUState.y8 = Block->Data8[BlockPtr];
+						CPUState.y32 = Block->Data32[BlockPtr];
+						BlockPtr++;
+						if(BlockPtr == Block->Length)
+							NextBlock();
+
 						CPUState.a8 = 0;			/* set service call as claimed */
 						CPU->SetState(CPUState);
 
@@ -293,6 +474,15 @@ bool CTape::Read(Uint16 Addr, Uint32 TimeStamp, Uint8 &Data8, Uint32 &Data32)
 					}
 				}
 				break;
+				case 0xf4df:
+				case 0xf50c:
+					if(ServeBlock(CPUState.pc.a))
+					{
+						PPPtr->Message(PPM_TAPEDATA_TRANSIENT, NULL);
+						LastServiceTime = TimeStamp;
+						Data8 = 0x60; return false; //RTS
+					}
+				break;
 				default: Data8 = 0xea; return false; //NOP
 			}
 		}
@@ -321,28 +511,3 @@ bool CTape::Read(Uint16 Addr, Uint32 TimeStamp, Uint8 &Data8, Uint32 &Data32)
 
 	return false;
 }
-
-void CTape::DetermineType()
-{
-	/* check if first block looks like BASIC */
-	if(TapeHasROMData = GetBlock())
-	{
-		LoadType = LT_CHAIN;
-
-		// check if it looks like a BASIC program
-		int Length = TapeBlock.BlockLength;
-		Uint8 *TPos = TapeBlock.Data8;
-		while(Length > 4)
-		{
-			if(TPos[0] != 13) {LoadType = LT_RUN; break; }
-			if((TPos[1]&0x7f) == 0x7f) break;
-
-			Length -= TPos[3];
-			TPos += TPos[3];
-		}
-	}
-	else
-		LoadType = LT_UNKNOWN;
-
-	Feeder->Seek(StartPos);
-}
@@ -8,160 +8,309 @@
 	Tape/FeederCSW.cpp
 	==================
 
-	CSW file reader. Uses cswdll.dll, provided by Fraser Ross to parse
-	CSW files for input. CSW files, like UEF, are 100% accurate reproductions
+	CSW file reader. CSW files, like UEF, are 100% accurate reproductions
 	of original source cassettes (as far as the machine can tell). They use a
 	very simple encoding scheme that focusses on accurately recreating zero
 	crossings so that data is loaded correctly. CSW files originate from the
 	ZX Spectrum world.
 
+	The pulse data is run length encoded: each byte is the length of a pulse
+	in samples, or a zero byte is followed by a 4 byte length for a pulse too
+	long to fit. Version 1 files always store that directly after a 32 byte
+	header. Version 2 files have a longer, extensible header and may
+	additionally have deflated the RLE stream with zlib ("Z-RLE").
+
 */
-#ifdef WIN32
 
 #include "Internal.h"
 #include "../HostMachine/HostMachine.h"
+#include "zlib.h"
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
-//#define CSWLOG
+#define CSW_SIGNATURE		"Compressed Square Wave\x1a"
+#define CSW_SIGNATURELENGTH	23
 
-#ifdef CSWLOG
-FILE *CSWLog;
-#endif
+#define CSW_RLE		1
+#define CSW_ZRLE	2
+
+#define Get16(p)	((p)[0] | ((p)[1] << 8))
+#define Get32(p)	((Uint32)(p)[0] | ((Uint32)(p)[1] << 8) | ((Uint32)(p)[2] << 16) | ((Uint32)(p)[3] << 24))
 
 CTapeFeederCSW::CTapeFeederCSW()
 {
-#ifdef CSWLOG
-	CSWLog = fopen("c:\\CSW.log", "wt");
+	Mapping = NULL;
+	MappingLength = 0;
+#ifdef WIN32
+	File = INVALID_HANDLE_VALUE;
+	MapObject = NULL;
 #endif
-	OpenFunc = NULL;
+	Inflated = NULL;
+	Pulses = PulsesEnd = PulsePtr = NULL;
+	OverRanFlag = false;
+}
 
+CTapeFeederCSW::~CTapeFeederCSW()
+{
+	Close();
+}
+
+void CTapeFeederCSW::MapFile(char *name)
+{
 #ifdef WIN32
-	/* check executable directory and then just general path */
-	char *Name = GetHost() -> ResolveFileName("%EXECPATH%/CSW.dll");
-#ifdef CSWLOG
-	fprintf(CSWLog, "resolved name: %s\n", Name);
-#endif
-	
-	if(!(CSWLib = LoadLibrary(Name)))
-		CSWLib = LoadLibrary("CSW.dll");
+	File = CreateFileA(name, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(File == INVALID_HANDLE_VALUE) return;
 
-	delete[] Name;
+	MappingLength = GetFileSize(File, NULL);
+	if(MappingLength == INVALID_FILE_SIZE || !MappingLength) return;
 
-	if(CSWLib)
-	{
-		OpenFunc = (OpenType)GetProcAddress(CSWLib, "Open");
-		CloseFunc = (CloseType)GetProcAddress(CSWLib, "Close");
-		Finished = (FinishedType)GetProcAddress(CSWLib, "Finished");
-		GetNextPulseLength = (GNPLType)GetProcAddress(CSWLib, "GetNextPulseLength");
-		Rewind = (FRType)GetProcAddress(CSWLib, "FullRewind");
- 		Exception = (EPType)GetProcAddress(CSWLib, "IsExceptionThrown");
- 		ExceptionText = (ESType)GetProcAddress(CSWLib, "GetExceptionMessage");
-	}
+	MapObject = CreateFileMappingA(File, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(!MapObject) return;
+
+	Mapping = (Uint8 *)MapViewOfFile(MapObject, FILE_MAP_READ, 0, 0, 0);
+#else
+	int File = open(name, O_RDONLY);
+	if(File < 0) return;
 
-	if(!OpenFunc || !CloseFunc || !Exception || !Finished || !GetNextPulseLength || !Rewind || !ExceptionText)
+	struct stat fstats;
+	if(!fstat(File, &fstats) && fstats.st_size > 0)
 	{
-#ifdef CSWLOG
-		fprintf(CSWLog, "unable to find DLL\n");
-#endif
-		OpenFunc = NULL;
-		FreeLibrary(CSWLib);
-		CSWLib = NULL;
+		MappingLength = (Uint32)fstats.st_size;
+		void *Map = mmap(NULL, MappingLength, PROT_READ, MAP_PRIVATE, File, 0);
+		if(Map != MAP_FAILED)
+			Mapping = (Uint8 *)Map;
 	}
 
+	/* the mapping stays valid after the descriptor is closed */
+	close(File);
 #endif
 }
 
-CTapeFeederCSW::~CTapeFeederCSW()
+void CTapeFeederCSW::UnmapFile()
 {
-	Close();
 #ifdef WIN32
-	if(CSWLib) FreeLibrary(CSWLib);
-#endif
-#ifdef CSWLOG
-	fclose(CSWLog);
+	if(Mapping) UnmapViewOfFile(Mapping);
+	if(MapObject) CloseHandle(MapObject);
+	if(File != INVALID_HANDLE_VALUE) CloseHandle(File);
+	MapObject = NULL;
+	File = INVALID_HANDLE_VALUE;
+#else
+	if(Mapping) munmap(Mapping, MappingLength);
 #endif
+	Mapping = NULL;
+	MappingLength = 0;
 }
 
 bool CTapeFeederCSW::Open(char *name)
 {
-	if(!OpenFunc) return false;
+	Close();
+	MapFile(name);
+	if(!Mapping || MappingLength < 0x20 || memcmp(Mapping, CSW_SIGNATURE, CSW_SIGNATURELENGTH))
+	{
+		Close();
+		return false;
+	}
 
-	OpenFunc(name);
+	int Compression;
+	Uint8 Flags;
+	Uint32 DataStart;
 
-#ifdef CSWLOG
-	bool err = Exception();
-	const char *text = ExceptionText();
-	if(err) fprintf(CSWLog, "error: %s\n", text);
-#endif
+	switch(Mapping[0x17])
+	{
+		default:
+			Close();
+		return false;
+
+		case 1:
+			SampleRate = Get16(&Mapping[0x19]);
+			Compression = Mapping[0x1b];
+			Flags = Mapping[0x1c];
+			DataStart = 0x20;
+		break;
+
+		case 2:
+			if(MappingLength < 0x34)
+			{
+				Close();
+				return false;
+			}
+			SampleRate = Get32(&Mapping[0x19]);
+			Compression = Mapping[0x21];
+			Flags = Mapping[0x22];
+			DataStart = 0x34 + Mapping[0x23];
+		break;
+	}
+
+	if(!SampleRate || DataStart >= MappingLength)
+	{
+		Close();
+		return false;
+	}
 
-	if(Exception())
+	switch(Compression)
 	{
-		const char *i = ExceptionText();
+		default:
+			Close();
 		return false;
+
+		case CSW_RLE:
+			Pulses = &Mapping[DataStart];
+			PulsesEnd = &Mapping[MappingLength];
+		break;
+
+		case CSW_ZRLE:
+		{
+			/* the inflated size isn't recorded anywhere, so guess and grow */
+			Uint32 Allocated = (MappingLength - DataStart) << 2;
+			Inflated = (Uint8 *)malloc(Allocated);
+
+			z_stream Stream;
+			memset(&Stream, 0, sizeof(Stream));
+			Stream.next_in = &Mapping[DataStart];
+			Stream.avail_in = MappingLength - DataStart;
+			Stream.next_out = Inflated;
+			Stream.avail_out = Allocated;
+
+			int Result = inflateInit(&Stream);
+			while(Result == Z_OK)
+			{
+				Result = inflate(&Stream, Z_NO_FLUSH);
+				if(Result == Z_OK && !Stream.avail_out)
+				{
+					Inflated = (Uint8 *)realloc(Inflated, Allocated << 1);
+					Stream.next_out = &Inflated[Allocated];
+					Stream.avail_out = Allocated;
+					Allocated <<= 1;
+				}
+			}
+			inflateEnd(&Stream);
+
+			if(Result != Z_STREAM_END)
+			{
+				Close();
+				return false;
+			}
+
+			Pulses = Inflated;
+			PulsesEnd = &Inflated[Stream.total_out];
+
+			/* nothing further is needed from the file itself */
+			UnmapFile();
+		}
+		break;
 	}
 
-	/* Returns true for positive first pulse in file. */
-	typedef bool (__stdcall * GIPType)(); GIPType GetInitialPolarity;
-	GetInitialPolarity = (GIPType)GetProcAddress(CSWLib, "GetInitialPolarity");
-	if(!GetInitialPolarity) return false;
-	PolarityHigh = GetInitialPolarity();
+	InitialPolarityHigh = (Flags&1) ? true : false;
 
-	/* Set sampling rate to 2,000,000 as rest of emulator works to a 2 Mhz bus */
-	typedef void (__stdcall * SetSampType)(__int32); SetSampType SetSamplingRate;
-	SetSamplingRate = (SetSampType)GetProcAddress(CSWLib, "SetSamplingRate");
-	if(!SetSamplingRate) return false;
-	SetSamplingRate(2000000);
+	/* make a pass over the pulses, both to check that they end where the
+	file does and to learn the total running time */
+	TotalSamples = 0;
+	PulsePtr = Pulses;
+	while(PulsePtr < PulsesEnd)
+	{
+		Uint32 Length = *PulsePtr++;
+		if(!Length)
+		{
+			if(PulsesEnd - PulsePtr < 4) break;
+			Length = Get32(PulsePtr);
+			PulsePtr += 4;
+		}
+		TotalSamples += Length;
+	}
 
-	FilePosition = 0;
+	if(!TotalSamples)
+	{
+		Close();
+		return false;
+	}
 
+	Seek(0);
+	OverRanFlag = false;
 	return true;
 }
 
 void CTapeFeederCSW::Close()
 {
-	if(OpenFunc)
-		CloseFunc();
+	UnmapFile();
+
+	if(Inflated)
+	{
+		free(Inflated);
+		Inflated = NULL;
+	}
+	Pulses = PulsesEnd = PulsePtr = NULL;
 }
 
 TapeWave CTapeFeederCSW::ReadWave()
 {
 	TapeWave wav;
 	wav.Type = PolarityHigh ? TapeWave::HIGH : TapeWave::LOW;
+	wav.SNChunk = NULL;
 	PolarityHigh = !PolarityHigh;
 
-	wav.Length = GetNextPulseLength();
+	Uint32 Length = *PulsePtr++;
+	if(!Length)
+	{
+		if(PulsesEnd - PulsePtr < 4)
+			PulsePtr = PulsesEnd;
+		else
+		{
+			Length = Get32(PulsePtr);
+			PulsePtr += 4;
+		}
+	}
 
-#ifdef CSWLOG
-	fprintf(CSWLog, "%u, ", WLength);
-#endif
+	/* convert from samples to 2Mhz cycles, rounding relative to the
+	start of the run rather than pulse by pulse */
+	wav.Length = (Uint32)(
+		(((SampleTime + Length) * 2000000) / SampleRate) -
+		((SampleTime * 2000000) / SampleRate));
+	SampleTime += Length;
 
-	FilePosition++;
-	if(Finished())
+	if(PulsePtr >= PulsesEnd)
 	{
 		OverRanFlag = true;
-		FilePosition = 0;
-		Rewind();
+		Seek(0);
 	}
 
 	return wav;
 }
 
+/* positions are the offset into the RLE stream, with the polarity of the
+next pulse in bit 32 */
 Uint64 CTapeFeederCSW::Tell()
 {
-	return FilePosition;
+	return (Uint64)(PulsePtr - Pulses) | (PolarityHigh ? ((Uint64)1 << 32) : 0);
 }
 
 void CTapeFeederCSW::Seek(Uint64 pos)
 {
-#ifdef CSWLOG
-	fprintf(CSWLog, "\nfull rewind\n", pos); fflush(CSWLog);
-#endif
+	Uint32 Offset = (Uint32)(pos&0xffffffff);
+	if(!pos)
+	{
+		PulsePtr = Pulses;
+		PolarityHigh = InitialPolarityHigh;
+	}
+	else
+	{
+		PulsePtr = (Offset < (Uint32)(PulsesEnd - Pulses)) ? &Pulses[Offset] : Pulses;
+		PolarityHigh = (pos >> 32) ? true : false;
+	}
+	SampleTime = 0;
+}
 
-	Rewind();
-	FilePosition = pos;
-	while(pos--)
-		GetNextPulseLength();
-	bool err = Exception();
-	const char *text = ExceptionText();
+Uint32 CTapeFeederCSW::GetLength()
+{
+	Uint64 Cycles = (TotalSamples * 2000000) / SampleRate;
+	return (Cycles > 0xffffffff) ? 0xffffffff : (Uint32)Cycles;
 }
 
 bool CTapeFeederCSW::OverRan()
@@ -173,5 +322,3 @@ void CTapeFeederCSW::ResetOverRan()
 {
 	OverRanFlag = false;
 }
-
-#endif
\ No newline at end of file
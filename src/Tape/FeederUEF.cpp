@@ -14,6 +14,7 @@
 */
 #include "Internal.h"
 #include "../HostMachine/HostMachine.h"
+#include <stdlib.h>
 
 #define UEF_VERSION		0x000a
 
@@ -51,6 +52,10 @@ class CUEFChunkFeeder
 		virtual void TrimStart(Uint32);
 		virtual Uint32 GetLength();
 
+		/* skips as close to the requested number of cycles as can be done
+		without generating waves, returning the number actually skipped */
+		virtual Uint32 SkipTime(Uint32);
+
 		struct Bit
 		{
 			Uint8 Value8; Uint32 Value32;
@@ -179,6 +184,26 @@ Uint32 CUEFChunkFeeder::GetLength()
 	return 0;
 }
 
+Uint32 CUEFChunkFeeder::SkipTime(Uint32 Cycles)
+{
+	/* only feeders built on GetBit can skip whole bits without building waves */
+	if(!BFeeder) return 0;
+
+	Uint32 Bits = Cycles / BitLength, Skipped = 0;
+	while(Skipped < Bits && !LFinished())
+	{
+		GetBit();
+		Skipped++;
+	}
+
+	/* every bit is four units of wave time, see ReadWave */
+	BitCount += Skipped << 2;
+	TimeOffset += Skipped*BitLength;
+	BitStage = 0;
+
+	return Skipped*BitLength;
+}
+
 /*
 
 	GAP (&0116 and &0112)
@@ -816,6 +841,9 @@ CTapeFeederUEF::CTapeFeederUEF()
 {
 	TSelector = NULL;
 	CSource = NULL;
+	Index = NULL;
+	IndexLength = CurrentEntry = ChunkTime = 0;
+	TotalLength = 0;
 }
 
 CTapeFeederUEF::~CTapeFeederUEF()
@@ -829,13 +857,12 @@ bool CTapeFeederUEF::Open(char *name)
 	{
 		if(TSelector->FindIdMajor(0x01))
 		{
-			/* default settings for modal values */
-			BaudRate = 1200;
-			Phase = 180;
-
-			GetNewSource();
-
-			return true;
+			BuildIndex();
+			if(IndexLength)
+			{
+				Seek(0);
+				return true;
+			}
 		}
 	}
 
@@ -855,10 +882,114 @@ void CTapeFeederUEF::Close()
 		GetHost() -> ReleaseUEFSelector(TSelector);
 		TSelector = NULL;
 	}
+
+	if(Index)
+	{
+		free(Index);
+		Index = NULL;
+	}
+	IndexLength = 0;
 }
 
-Uint32 ChunkLength, ChLength;
-Uint16 OldID;
+void CTapeFeederUEF::BuildIndex()
+{
+	Uint32 Allocated = 64;
+	Index = (IndexEntry *)malloc(sizeof(IndexEntry)*Allocated);
+	IndexLength = 0;
+	TotalLength = 0;
+
+	/* default settings for modal values */
+	BaudRate = 1200;
+	Phase = 180;
+
+	TSelector->Reset();
+	TSelector->ResetOverRan();
+	while(!TSelector->OverRan())
+	{
+		CUEFChunk *Chunk = TSelector->GetPosition();
+		float EntryBaudRate = BaudRate;
+		Uint16 EntryPhase = Phase;
+
+		if(CreateSource())
+		{
+			if(IndexLength == Allocated)
+			{
+				Allocated <<= 1;
+				Index = (IndexEntry *)realloc(Index, sizeof(IndexEntry)*Allocated);
+			}
+
+			Index[IndexLength].StartTime = TotalLength;
+			Index[IndexLength].Length = CSource->GetLength();
+			Index[IndexLength].Chunk = Chunk;
+			Index[IndexLength].BaudRate = EntryBaudRate;
+			Index[IndexLength].Phase = EntryPhase;
+			TotalLength += Index[IndexLength].Length;
+			IndexLength++;
+
+			delete CSource;
+			CSource = NULL;
+		}
+
+		TSelector->Seek(1, SEEK_CUR);
+	}
+	TSelector->ResetOverRan();
+}
+
+/* creates a source for the current chunk if it is one that produces
+output, otherwise takes note of any modal value it sets */
+bool CTapeFeederUEF::CreateSource()
+{
+#ifdef DUMP_CHUNKS
+	printf("Chunk %04x\n", TSelector->CurrentChunk()->GetId());
+#endif
+	Uint16 id = TSelector->CurrentChunk()->GetId();
+	switch(id)
+	{
+		case BAUDWISE_GAP:
+		case FLOATING_GAP:
+			CSource = new CUEFChunkFeederGap(TSelector, BaudRate, Phase);
+		break;
+
+		case HTONE:
+			CSource = new CUEFChunkFeederHTone(TSelector, BaudRate, Phase);
+		break;
+		case HTONEDUMMY:
+			CSource = new CUEFChunkFeederHToneDummy(TSelector, BaudRate, Phase);
+		break;
+
+		case IMPLICIT_DATA:
+			CSource = new CUEFChunkFeederImplicitData(TSelector, BaudRate, Phase);
+		break;
+		case EXPLICIT_DATA:
+			CSource = new CUEFChunkFeederExplicitData(TSelector, BaudRate, Phase);
+		break;
+		case SECURITY:
+			CSource = new CUEFChunkFeederSecurity(TSelector, BaudRate, Phase);
+		break;
+		case DEFINED_DATA:
+			/* NB: is this one that is going to have to be pulsed? */
+			CSource = new CUEFChunkFeederDefinedDataPulseWise(TSelector, BaudRate, Phase);
+		break;
+
+		case PHASE_CHANGE:	Phase = TSelector->CurrentChunk()->Get16();			break;
+		case BAUD_RATE:		BaudRate = TSelector->CurrentChunk()->GetFloat();	break;
+
+		default:
+			/* inline snapshot? */
+			if((id >> 8) == 0x4)
+				CSource = new CUEFChunkFeederSnapshot(TSelector, BaudRate, Phase);
+		break;
+	}
+
+	if(CSource && !CSource->Initialise())
+	{
+		delete CSource;
+		CSource = NULL;
+	}
+
+	ChunkTime = 0;
+	return CSource ? true : false;
+}
 
 void CTapeFeederUEF::GetNewSource()
 {
@@ -867,75 +998,22 @@ void CTapeFeederUEF::GetNewSource()
 	{
 		delete CSource; CSource = NULL;
 	}
-	Waves = 0;
-	 
-	/* find next useful chunk */
+
+	/* find next useful chunk - which is also the next index entry */
 	while(!CSource)
 	{
 		TSelector->Seek(1, SEEK_CUR);
-
-#ifdef DUMP_CHUNKS
-		printf("Chunk %04x\n", TSelector->CurrentChunk()->GetId());
-#endif
-		Uint16 id = TSelector->CurrentChunk()->GetId();
-		switch(id)
-		{
-			case BAUDWISE_GAP:
-			case FLOATING_GAP:
-				CSource = new CUEFChunkFeederGap(TSelector, BaudRate, Phase);
-			break;
-
-			case HTONE:
-				CSource = new CUEFChunkFeederHTone(TSelector, BaudRate, Phase);
-			break;
-			case HTONEDUMMY:
-				CSource = new CUEFChunkFeederHToneDummy(TSelector, BaudRate, Phase);
-			break;
-
-			case IMPLICIT_DATA:
-				CSource = new CUEFChunkFeederImplicitData(TSelector, BaudRate, Phase);
-			break;
-			case EXPLICIT_DATA:
-				CSource = new CUEFChunkFeederExplicitData(TSelector, BaudRate, Phase);
-			break;
-			case SECURITY:
-				CSource = new CUEFChunkFeederSecurity(TSelector, BaudRate, Phase);
-			break;
-			case DEFINED_DATA:
-				/* NB: is this one that is going to have to be pulsed? */
-				CSource = new CUEFChunkFeederDefinedDataPulseWise(TSelector, BaudRate, Phase);
-			break;
-
-			case PHASE_CHANGE:	Phase = TSelector->CurrentChunk()->Get16();			break;
-			case BAUD_RATE:		BaudRate = TSelector->CurrentChunk()->GetFloat();	break;
-
-			default:
-				/* inline snapshot? */
-				if((id >> 8) == 0x4)
-					CSource = new CUEFChunkFeederSnapshot(TSelector, BaudRate, Phase);
-			break;
-		}
-
-		if(CSource)
-			if(!CSource->Initialise())
-			{
-				delete CSource;
-				CSource = NULL;
-			}
-			else
-			{
-				ChunkLength = CSource->GetLength();
-				ChLength = 0;
-				OldID = id;
-			}
+		CreateSource();
 	}
+
+	CurrentEntry++;
+	if(CurrentEntry == IndexLength) CurrentEntry = 0;
 }
 
 TapeWave CTapeFeederUEF::ReadWave()
 {
-	Waves++;
 	TapeWave w = CSource->ReadWave();
-	ChLength += w.Length;
+	ChunkTime += w.Length;
 	if(CSource->Finished())
 		GetNewSource();
 	return w;
@@ -946,8 +1024,7 @@ TapeBit CTapeFeederUEF::ReadBit()
 	if(CSource->BitFeeder())
 	{
 		TapeBit NewBit = CSource->ReadBit();
-		ChLength += NewBit.Length;
-		Waves += NewBit.Value8 ? 4 : 2;
+		ChunkTime += NewBit.Length;
 
 		if(CSource->Finished())
 			GetNewSource();
@@ -958,25 +1035,54 @@ TapeBit CTapeFeederUEF::ReadBit()
 		return CTapeFeeder::ReadBit();
 }
 
+/* positions are in cycles from the start of the tape */
 Uint64 CTapeFeederUEF::Tell()
 {
-	return (TSelector->GetOffset()+1) | ((Uint64)Waves << 32);
+	return Index[CurrentEntry].StartTime + ChunkTime;
 }
 
 void CTapeFeederUEF::Seek(Uint64 pos)
 {
-	Uint32 FilePos, WavePos;
-	FilePos = (Uint32)(pos&0xffffffff);
-	WavePos = (Uint32)(pos >> 32);
+	/* find the first chunk that hasn't ended by pos */
+	Uint32 Low = 0, High = IndexLength-1;
+	while(Low < High)
+	{
+		Uint32 Mid = (Low+High) >> 1;
+		if(Index[Mid].StartTime + Index[Mid].Length > pos)
+			High = Mid;
+		else
+			Low = Mid+1;
+	}
 
-	if(!FilePos)
-		TSelector->Reset();
-	else
-		TSelector->Seek(FilePos-1, SEEK_SET);
+	/* back up over anything of zero length, e.g. an inline snapshot, that
+	occurs at exactly pos */
+	while(Low && Index[Low-1].StartTime == pos)
+		Low--;
+
+	if(CSource)
+	{
+		delete CSource;
+		CSource = NULL;
+	}
+
+	CurrentEntry = Low;
+	BaudRate = Index[Low].BaudRate;
+	Phase = Index[Low].Phase;
+	TSelector->SetPosition(Index[Low].Chunk);
+	if(!CreateSource())
+	{
+		GetNewSource();
+		return;
+	}
+
+	/* then get as close to pos as possible within the chunk */
+	Uint32 Offset = (pos > Index[Low].StartTime) ? (Uint32)(pos - Index[Low].StartTime) : 0;
+	ChunkTime = CSource->SkipTime(Offset);
+	while(ChunkTime < Offset && !CSource->Finished())
+		ChunkTime += CSource->ReadWave().Length;
 
-	GetNewSource();
-	while(WavePos--)
-		ReadWave();
+	if(CSource->Finished())
+		GetNewSource();
 }
 
 bool CTapeFeederUEF::OverRan()
@@ -991,18 +1097,5 @@ void CTapeFeederUEF::ResetOverRan()
 
 Uint32 CTapeFeederUEF::GetLength()
 {
-	Uint64 StorePos = Tell();
-
-	TSelector->Reset();
-	TSelector->ResetOverRan();
-	Uint32 Length = 0;
-
-	while(!TSelector->OverRan())
-	{
-		GetNewSource();
-		Length += CSource->GetLength();
-	}
-
-	Seek(StorePos);
-	return Length;
+	return (TotalLength > 0xffffffff) ? 0xffffffff : (Uint32)TotalLength;
 }
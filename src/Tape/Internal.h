@@ -237,16 +237,34 @@ class CTapeFeederUEF: public CTapeFeeder
 	private:
 		CUEFChunkSelector *TSelector;
 		void GetNewSource();
-		Uint32 Waves;
+		bool CreateSource();
 
 		class CUEFChunkFeeder *CSource;
 		float BaudRate;
 		Uint16 Phase;
+
+		/* cumulative time index, built as the tape is opened. There is one
+		entry per chunk that produces output, holding the modal values in
+		force at its start, so Tell and Seek can deal in cycles from the
+		start of the tape and find their chunk by binary search */
+		struct IndexEntry
+		{
+			Uint64 StartTime;
+			Uint32 Length;
+			CUEFChunk *Chunk;
+			float BaudRate;
+			Uint16 Phase;
+		} *Index;
+		Uint32 IndexLength, CurrentEntry;
+		Uint64 TotalLength;
+		Uint32 ChunkTime;
+		void BuildIndex();
 };
 
 #ifdef WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <windows.h>
+#endif
 
 class CTapeFeederCSW: public CTapeFeeder
 {
@@ -261,35 +279,31 @@ class CTapeFeederCSW: public CTapeFeeder
 
 		Uint64 Tell();
 		void Seek(Uint64);
+		Uint32 GetLength();
 
 		bool OverRan();
 		void ResetOverRan();
 	private:
 		bool OverRanFlag;
-		bool PolarityHigh;
-
-		Uint64 FilePosition;
-
+		bool InitialPolarityHigh, PolarityHigh;
+
+		/* the file is mapped into memory. Pulses are then decoded straight
+		from the RLE stream, which for Z-RLE files is first inflated in
+		its entirety into Inflated */
+		void MapFile(char *name);
+		void UnmapFile();
+		Uint8 *Mapping;
+		Uint32 MappingLength;
 #ifdef WIN32
-		HINSTANCE CSWLib;
+		HANDLE File, MapObject;
 #endif
-		/* Parameter is the file path and name null terminated. */
-		typedef void (__stdcall * OpenType)(const char *); OpenType OpenFunc;
-		typedef void (__stdcall * CloseType)(); CloseType CloseFunc;
-
-		/* return true for eof */
-		typedef bool (__stdcall * FinishedType)(); FinishedType Finished;
-
-		/* Returns a pulselength */
-		typedef unsigned int (__stdcall * GNPLType)(); GNPLType GetNextPulseLength;
+		Uint8 *Inflated;
+		Uint8 *Pulses, *PulsesEnd, *PulsePtr;
 
-		/* Resets internal state and effectively rewinds tape. Does not close file. */
-		typedef void (__stdcall * FRType)(); FRType Rewind;
-
-		/* check for errors */
-		typedef bool (__stdcall * EPType)(); EPType Exception;
-		typedef const char * (__stdcall *ESType)(); ESType ExceptionText;
+		/* SampleTime is the start of the next pulse, in samples since the
+		last Seek, so that rounding to 2Mhz cycles doesn't accumulate */
+		Uint32 SampleRate;
+		Uint64 SampleTime, TotalSamples;
 };
-#endif
 
 #endif
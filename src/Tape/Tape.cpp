@@ -275,6 +275,9 @@ bool CTape::SetMode(Uint32 TimeStamp, TapeModes NM, bool NTM)
 	CurrentMode = NM;
 	TapeMotor = NTM;
 
+	/* the next bit edge probably now falls somewhere else entirely */
+	PPPtr->RequestUpdate(PPNum);
+
 	return true;
 }
 
@@ -285,6 +288,7 @@ void CTape::Close()
 		delete Feeder;
 		Feeder = NULL;
 	}
+	FreeCatalogue();
 }
 
 bool CTape::Open(char *name)
@@ -308,8 +312,6 @@ bool CTape::Open(char *name)
 	char *CSWExts[] = { "csw\a", NULL };
 	if(GetHost() -> ExtensionIncluded(name, CSWExts))
 	{
-#ifdef WIN32	
-
 		CTapeFeeder *NewFeeder = new CTapeFeederCSW;
 		if(!NewFeeder->Open(name))
 		{
@@ -319,15 +321,12 @@ bool CTape::Open(char *name)
 
 		Close();
 		Feeder = NewFeeder;
-#else
-		return false; // can't do CSW on this platform!
-#endif
 	}
 
 	if(Feeder != OFeeder)
 	{
 		StartPos = Feeder->Tell();
-		DetermineType();
+		BuildCatalogue();
 		CurrentBit = Feeder->ReadBit();
 		return true;
 	}
@@ -342,11 +341,16 @@ CTape::CTape(ElectronConfiguration &cfg)
 
 	OutputCounter = BitCount = ScrollRegister8 = 0;
 	Silence = true;
-	UseFastHack = false;
+	UseFastHack = Slogger64 = false;
+
+	Catalogue = NULL;
+	LastServiceTime = 0;
+	FreeCatalogue();
 }
 
 CTape::~CTape()
 {
+	Close();
 }
 
 bool CTape::IOCtl(Uint32 Control, void *Parameter, Uint32 TimeStamp)
@@ -362,12 +366,88 @@ bool CTape::IOCtl(Uint32 Control, void *Parameter, Uint32 TimeStamp)
 		case TAPEIOCTL_REWIND:
 			if(Feeder)
 				Feeder->Seek(StartPos);
+			CurrentBlock = BlockPtr = 0;
 		return true;
+
+		case TAPEIOCTL_LOADFILE:
+		return LoadFile((TapeFileLoad *)Parameter);
 	}
 
 	return CComponentBase::IOCtl(Control, Parameter, TimeStamp);
 }
 
+void CTape::GetState(CUEFChunk *cnk, Uint32 TimeStamp)
+{
+	RunTo(TimeStamp);
+
+	cnk->PutC((TapeMotor ? 0x01 : 0) | (Silence ? 0x02 : 0) | (Feeder ? 0x04 : 0));
+	cnk->PutC(CurrentMode);
+	cnk->Put32(ScrollRegister8);
+	cnk->Put32((Uint32)ScrollRegister32);
+	cnk->Put32((Uint32)(ScrollRegister32 >> 32));
+	cnk->PutC(BitCount);
+	cnk->PutC(OutBitCount);
+	cnk->Put32(OutputCounter);
+
+	if(Feeder)
+	{
+		Uint64 Position = Feeder->Tell();
+		cnk->Put32((Uint32)Position);
+		cnk->Put32((Uint32)(Position >> 32));
+
+		cnk->PutC(CurrentBit.Type);
+		cnk->Put32(CurrentBit.Length);
+		cnk->PutC(CurrentBit.Value8);
+		cnk->Put32(CurrentBit.Value32);
+
+		cnk->Put32(CurrentBlock);
+		cnk->Put32(BlockPtr);
+	}
+}
+
+void CTape::SetState(CUEFChunk *cnk, Uint32 TimeStamp)
+{
+	RunTime = TimeStamp;
+
+	Uint8 Flags = cnk->GetC();
+	TapeMotor = (Flags&0x01) ? true : false;
+	Silence = (Flags&0x02) ? true : false;
+	CurrentMode = (TapeModes)cnk->GetC();
+	ScrollRegister8 = cnk->Get32();
+	ScrollRegister32 = cnk->Get32();
+	ScrollRegister32 |= (Uint64)cnk->Get32() << 32;
+	BitCount = cnk->GetC();
+	OutBitCount = cnk->GetC();
+	OutputCounter = cnk->Get32();
+
+	if(Feeder && (Flags&0x04))
+	{
+		Uint64 Position = cnk->Get32();
+		Position |= (Uint64)cnk->Get32() << 32;
+		Feeder->Seek(Position);
+
+		/* any snapshot in the bit has already been acted upon */
+		switch(cnk->GetC())
+		{
+			default:	CurrentBit.Type = TapeBit::GAP;		break;
+			case 1:		CurrentBit.Type = TapeBit::DATA;	break;
+		}
+		CurrentBit.Length = cnk->Get32();
+		CurrentBit.Value8 = cnk->GetC();
+		CurrentBit.Value32 = cnk->Get32();
+		CurrentBit.SNChunk = NULL;
+
+		/* position within the fast tape catalogue */
+		if(!cnk->EOC())
+		{
+			CurrentBlock = cnk->Get32();
+			BlockPtr = cnk->Get32();
+			if(CurrentBlock >= CatalogueLength || (CatalogueLength && BlockPtr >= Catalogue[CurrentBlock].Length))
+				CurrentBlock = BlockPtr = 0;
+		}
+	}
+}
+
 const char *CTape::QueryTapeCommand()
 {
 	static char RunCmd[] = "*TAPE\n*RUN\n";
@@ -9,6 +9,16 @@
 #define BIT_LENGTH			1628	/* FOR OUTPUT ONLY!!! - verified by Fraser Ross */
 
 #define TAPEIOCTL_REWIND	0x500
+#define TAPEIOCTL_LOADFILE	0x501	/* Parameter is a TapeFileLoad *, result is whether the file was found */
+
+/* names a file to load straight into memory, as OSFILE would. An empty
+name means whichever file is next on the tape. The addresses and length
+are filled in from the tape */
+struct TapeFileLoad
+{
+	const char *Name;
+	Uint32 LoadAddress, ExecAddress, Length;
+};
 
 enum TapeModes
 {
@@ -34,6 +44,13 @@ class CTape : public CComponentBase
 		/* this returns the string a user should enter to run the game - usually *RUN"" or CHAIN"" */
 		const char *QueryTapeCommand();
 
+		/* for rewinding - GetState brings the tape up to TimeStamp and
+		appends its state, including the position within the current
+		tape, to the chunk. SetState reverses that, so is meaningful only
+		while the same tape remains inserted */
+		void GetState(CUEFChunk *, Uint32 TimeStamp);
+		void SetState(CUEFChunk *, Uint32 TimeStamp);
+
 	private :
 		void RunTo(Uint32 Time);
 		Uint32 RunTime;
@@ -54,29 +71,35 @@ class CTape : public CComponentBase
 		TapeBit CurrentBit;
 		Uint64 StartPos;
 
-		/* fast tape helpers */
-		struct
+		/* fast tape helpers - the tape is decoded once, when it is opened,
+		into a catalogue of blocks. Each entry keeps the bytes exactly as the
+		OS would receive them, from the synchronisation byte through to the
+		data CRC, so that they can be served without going near the feeder */
+		struct TapeCatalogueEntry
 		{
 			char Name[11];
 			Uint32 LoadAddress, ExecAddress;
 			Uint16 BlockNo, BlockLength;
 			Uint8 Flags;
-			Uint8 Data8[256];
-			Uint32 Data32[256];
 
-			int DataPtr;
-		} TapeBlock;
-		struct FileStats
-		{
-			char Name[11];
-			Uint32 LoadAddr, ExecAddr;
-			Uint32 StartAddrOrLength, EndAddrOrFlags;
-		};
+			Uint64 EndPos;
+			int Length, DataStart;
+			Uint8 Data8[292];
+			Uint32 Data32[292];
+		} *Catalogue;
+		int CatalogueLength, CurrentBlock, BlockPtr;
+		Uint32 LastServiceTime;
+		bool Slogger64;
+
 		void SetTrapAddresses(bool Enabled, bool Slogger64);
 
-		bool GetBlock(bool data = true);
-		void TapeGetC(Uint8 &Data8, Uint32 &Data32);
-		void DetermineType();
+		void BuildCatalogue();
+		void FreeCatalogue();
+		bool CatalogueGetC(Uint8 &Data8, Uint32 &Data32);
+		void NextBlock();
+		void WriteBlock(Uint16 OpAddr, Uint16 Addr, TapeCatalogueEntry *Block);
+		bool ServeBlock(Uint16 OpAddr);
+		bool LoadFile(TapeFileLoad *File);
 		enum
 		{
 			LT_RUN, LT_CHAIN, LT_UNKNOWN
@@ -27,7 +27,7 @@ class CUEFChunkSelector;
 class CUEFChunk
 {
 	public :
-		CUEFChunk(gzFile input, char *name, bool wrte);
+		CUEFChunk(CUEFFile *owner, bool wrte);
 		~CUEFChunk(void);
 
 		int Read(void *buf, int numbytes);
@@ -55,12 +55,12 @@ class CUEFChunk
 
 	private :
 
-		bool Create(gzFile input, char *name, bool wrte);
+		bool Create(CUEFFile *owner, bool wrte);
 		bool HasChanged(void);
-		bool Write(gzFile f, CUEFFile *owner);
-		void Kill(void);
+		bool MakeWritable(void);
+		bool Write(gzFile f);
 
-		int Enable(CUEFFile *owner);
+		int Enable();
 		int Disable(void);
 		int refcount;
 		int GetRefCount(void);
@@ -79,14 +79,15 @@ class CUEFChunk
 
 		/*
 
-		memory is used to store the chunk contents while this chunk is active,
-		or until file write time if changes are made
+		memory holds the chunk contents. For a chunk that came from a file it
+		is a read only view into that file's arena until the first write, at
+		which point it becomes a private malloc'd copy ('owned')
 
 		*/
 
 		Uint8 *memory;
 		Uint32 memorylen;
-		bool dirty;
+		bool dirty, owned;
 
 		/*
 
@@ -99,13 +100,12 @@ class CUEFChunk
 
 		/*
 
-		a file block is unique by virtue of the file its in, and its start
-		location (in bytes offset) within that file
+		start of this chunk's data within its file's arena, or NULL for a
+		chunk created in memory
 
 		*/
 
-		char *fname;
-		int offset;
+		Uint8 *view;
 
 		/*
 
@@ -124,7 +124,10 @@ class CUEFFile
 		~CUEFFile(void);
 
 		bool Open(char *name, Uint16 version, char *mode);
-		void Close(void);
+
+		/* writes back any changes, returning false if they couldn't be -
+		in which case the file is left exactly as it was */
+		bool Close(void);
 
 		Uint16 GetVersion(void);
 		CUEFChunkSelector *GetSelectorPtr(void);
@@ -132,11 +135,28 @@ class CUEFFile
 
 		bool HasFile(void);
 
+		/* zlib level, 0 to 9, used when changes are written back. 9 unless set */
+		void SetCompression(int level);
+
 	private :
-		void BuildFileChain(gzFile file, char *fname);
+		void BuildFileChain(void);
 		void Killing(CUEFChunk *chunk);
 
-		gzFile GetFile(char *name);
+		/*
+
+		the whole file is inflated once into 'arena' (or, if it is stored
+		uncompressed, mapped straight into memory) and every chunk read
+		from it is a view into that block. 'parseptr' is the next unparsed
+		byte while the chunk list is being built
+
+		*/
+
+		bool LoadArena(char *name);
+		void ReleaseArena(void);
+		Uint8 *arena;
+		Uint32 arenalen, parseptr;
+		bool mapped;
+
 		friend class CUEFChunk;
 		friend class CUEFChunkSelector;
 
@@ -145,9 +165,7 @@ class CUEFFile
 
 		bool read, write;
 		Uint16 newversion, oldversion;
-
-		gzFile cinput;
-		char *cname;
+		int level;
 };
 
 class CUEFChunkSelector
@@ -164,6 +182,11 @@ class CUEFChunkSelector
 
 		CUEFChunk *CurrentChunk(void);
 
+		/* these identify a position in constant time, for callers that
+		keep an index rather than counting chunks with GetOffset */
+		CUEFChunk *GetPosition(void);
+		void SetPosition(CUEFChunk *chunk);
+
 		CUEFChunk *GetChunkPtr(void);
 		CUEFChunk *EstablishChunk(void);
 		void ReleaseChunkPtr(CUEFChunk *chunk);
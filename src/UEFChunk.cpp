@@ -16,16 +16,18 @@
 #include <malloc.h>
 #include <string.h>
 
-CUEFChunk::CUEFChunk(gzFile input, char *name, bool wrte)
+CUEFChunk::CUEFChunk(CUEFFile *owner, bool wrte)
 {
-	memory = NULL;
+	memory = view = NULL;
+	owned = false;
 	next = NULL;
-	Create(input, name, wrte);
+	Create(owner, wrte);
 	refcount = 0;
 }
 
 CUEFChunk::~CUEFChunk(void)
 {
+	if(owned) free(memory);
 }
 
 int CUEFChunk::GetRefCount(void)
@@ -149,7 +151,7 @@ int CUEFChunk::Write(const void *buf, int numbytes)
 {
 	if(!write) return -1;
 
-	if(memory)
+	if(MakeWritable())
 	{
 		dirty = true;
 
@@ -282,67 +284,94 @@ void CUEFChunk::SetId(Uint16 newid)
 
 void CUEFChunk::SetLength(Uint32 newlength)
 {
-	if(write)
+	if(write && MakeWritable())
 	{
+		if(newlength > memorylen)
+		{
+			memory = (Uint8 *)realloc(memory, newlength);
+			memset(&memory[memorylen], 0, newlength - memorylen);
+			memorylen = newlength;
+		}
+
 		length = newlength;
 		dirty = true;
 	}
 }
 
+bool CUEFChunk::MakeWritable(void)
+{
+	/*
+
+	a chunk read from a file shares its bytes with the file's arena until
+	something is written to it, at which point it gets a copy of its own
+
+	*/
+	if(owned) return true;
+
+	Uint32 newlen = length + 256 - (length&255);
+	Uint8 *copy = (Uint8 *)malloc(newlen);
+	if(!copy) return false;
+
+	if(view) memcpy(copy, view, length);
+	memory = copy;
+	memorylen = newlen;
+	owned = true;
+
+	return true;
+}
+
 bool CUEFChunk::HasChanged(void)
 {
 	return dirty;
 }
 
-bool CUEFChunk::Write(gzFile f, CUEFFile *owner)
+bool CUEFChunk::Write(gzFile f)
 {
-	/* output the chunk to the specified file */
-	bool active = true;
+	/* output the chunk to the specified file, returning false if any of it can't be */
+	bool written = true;
 
-	if(!memory)
-	{
-		active = false;
-		Enable(owner);
-	}
+	if(gzputc(f, id&255) == -1) written = false;
+	if(gzputc(f, id>>8) == -1) written = false;
 
-	gzputc(f, id&255);
-	gzputc(f, id>>8);
+	if(gzputc(f, (length & 0x000000ff) >> 0) == -1) written = false;
+	if(gzputc(f, (length & 0x0000ff00) >> 8) == -1) written = false;
+	if(gzputc(f, (length & 0x00ff0000) >> 16) == -1) written = false;
+	if(gzputc(f, (length & 0xff000000) >> 24) == -1) written = false;
 
-	gzputc(f, (length & 0x000000ff) >> 0);
-	gzputc(f, (length & 0x0000ff00) >> 8);
-	gzputc(f, (length & 0x00ff0000) >> 16);
-	gzputc(f, (length & 0xff000000) >> 24);
+	if(length && gzwrite(f, memory, length) != (int)length) written = false;
 
-	gzwrite(f, memory, length);
-
-	if(!active) Disable();
-
-	return true;
+	return written;
 }
 
-bool CUEFChunk::Create(gzFile input, char *name, bool wrte)
+bool CUEFChunk::Create(CUEFFile *owner, bool wrte)
 {
 	write = wrte;
+	readptr = writeptr = 0;
 
-	if(name)
+	if(owner)
 	{
-		/* store and setup necessary parts */
-		fname = strdup(name);
+		/* take id and length from the arena, and point at the data */
+		Uint8 *header = &owner->arena[owner->parseptr];
+		Uint32 remaining = owner->arenalen - owner->parseptr;
 		dirty = false;
 
-		/* retrieve vital information from gzFile - offset, chunk id and length */
-		id = gzgetc(input);
-		id |= ((int)gzgetc(input)) << 8;
+		if(remaining < 6)
+		{
+			owner->parseptr = owner->arenalen;
+			id = 0xffff; length = 0;
+			return false;
+		}
 
-		length = gzgetc(input);
-		length |= ((int)gzgetc(input)) << 8;
-		length |= ((int)gzgetc(input)) << 16;
-		length |= ((int)gzgetc(input)) << 24;
+		id = header[0] | (header[1] << 8);
+		length = header[2] | (header[3] << 8) | (header[4] << 16) | ((Uint32)header[5] << 24);
 
-		if(gzeof(input)) {id = 0xffff; length = 0; return false;}
+		/* a truncated file gets a truncated last chunk */
+		remaining -= 6;
+		if(length > remaining) length = remaining;
 
-		/* advance file ptr to next chunk & return */
-		offset = gzseek(input, length, SEEK_CUR) - length;
+		memory = view = header + 6;
+		memorylen = length;
+		owner->parseptr += 6 + length;
 
 		return true;
 	}
@@ -350,12 +379,12 @@ bool CUEFChunk::Create(gzFile input, char *name, bool wrte)
 	{
 		id = 0; length = 0;
 		dirty = true;
-		fname = NULL;
 
 		/* allocate 256 bytes initial maximum size */
 
 		memory = (Uint8 *)malloc(256);
 		memorylen = 256;
+		owned = true;
 
 		return true;
 	}
@@ -363,37 +392,9 @@ bool CUEFChunk::Create(gzFile input, char *name, bool wrte)
 	return false;
 }
 
-void CUEFChunk::Kill(void)
-{
-	if(fname)
-	{
-		free(fname);
-		fname = NULL;
-	}
-}
-
-int CUEFChunk::Enable(CUEFFile *owner)
+int CUEFChunk::Enable()
 {
 	readptr = writeptr = 0;
-
-	if(!memory)
-	{
-		if(! (memory = (Uint8 *)malloc(length)) ) return false;
-		memorylen = length;
-
-		gzFile tmp = owner->GetFile(fname);
-
-		if(tmp)
-		{
-			gzseek(tmp, offset, SEEK_SET);
-			gzread(tmp, memory, length);
-		}
-		else
-		{
-			free(memory);
-			memory = NULL;
-		}
-	}
 	refcount++;
 
 	return refcount;
@@ -403,25 +404,12 @@ int CUEFChunk::Disable(void)
 {
 	/*
 
-	if no changes were made, safe to just free memory and forget about it
+	the contents stay where they are, either in the file's arena or, once
+	written to, in this chunk's own copy until the file is closed
 
 	*/
 
-	if(!refcount) return refcount;
-
-	refcount--;
-
-	if(!refcount)
-	{
-		if(!dirty)
-		{
-			if(memory)
-			{
-				free(memory);
-				memory = NULL;
-			}
-		}
-	}
+	if(refcount) refcount--;
 
 	return refcount;
 }
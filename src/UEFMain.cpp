@@ -24,10 +24,17 @@
 #endif
 
 #ifdef WIN32
+#include <windows.h>
 #include <io.h>
 #define access(x, y) _access(x, y)
 #define R_OK 4
 #define W_OK 2
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 #endif
 
 /* CUEFFile class */
@@ -35,7 +42,10 @@
 CUEFFile::CUEFFile(void)
 {
 	list = NULL;
-	cinput = NULL;
+	level = 9;
+	arena = NULL;
+	arenalen = 0;
+	mapped = false;
 }
 
 CUEFFile::~CUEFFile(void)
@@ -45,11 +55,90 @@ CUEFFile::~CUEFFile(void)
 
 /*
 
-	CUEFFile::BuildFileChain - adds the chunks within 'file' (of name
-	'fname') to the end of the chunk list
+	CUEFFile::LoadArena - gets the whole of file 'name' into 'arena'. A
+	gzipped file is inflated in one pass; an uncompressed one is mapped
+	where the host allows it, otherwise gzread just copies it through
+
+*/
+bool CUEFFile::LoadArena(char *name)
+{
+	ReleaseArena();
+
+#ifndef WIN32
+	int File = open(name, O_RDONLY);
+	if(File < 0) return false;
+
+	struct stat fstats;
+	Uint8 magic[2];
+
+	if(	!fstat(File, &fstats) && fstats.st_size > 2 &&
+		pread(File, magic, 2, 0) == 2 &&
+		(magic[0] != 0x1f || magic[1] != 0x8b))
+	{
+		void *Map = mmap(NULL, (size_t)fstats.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+		if(Map != MAP_FAILED)
+		{
+			arena = (Uint8 *)Map;
+			arenalen = (Uint32)fstats.st_size;
+			mapped = true;
+		}
+	}
+
+	/* the mapping stays valid after the descriptor is closed */
+	close(File);
+	if(mapped) return true;
+#endif
+
+	gzFile input;
+	if(!(input = gzopen(name, "rb")))
+		return false;
+
+	Uint32 allocated = 0;
+	int len;
+
+	do
+	{
+		if(arenalen == allocated)
+		{
+			allocated = allocated ? allocated << 1 : 65536;
+			Uint8 *newarena = (Uint8 *)realloc(arena, allocated);
+			if(!newarena) break;
+			arena = newarena;
+		}
+
+		len = gzread(input, &arena[arenalen], allocated - arenalen);
+		if(len > 0) arenalen += len;
+	}
+	while(len > 0);
+
+	gzclose(input);
+	return true;
+}
+
+void CUEFFile::ReleaseArena(void)
+{
+	if(arena)
+	{
+#ifndef WIN32
+		if(mapped)
+			munmap(arena, arenalen);
+		else
+#endif
+			free(arena);
+	}
+
+	arena = NULL;
+	arenalen = 0;
+	mapped = false;
+}
+
+/*
+
+	CUEFFile::BuildFileChain - adds the chunks in the arena from 'parseptr'
+	onwards to the end of the chunk list
 
 */
-void CUEFFile::BuildFileChain(gzFile file, char *fname)
+void CUEFFile::BuildFileChain(void)
 {
 	CUEFChunk *newest, *last, *current;
 
@@ -60,10 +149,10 @@ void CUEFFile::BuildFileChain(gzFile file, char *fname)
 			current = current->next;
 	}
 
-	/* load in new chunk information */
-	while(!gzeof(file))
+	/* load in new chunk information; an empty file still gets one chunk */
+	do
 	{
-		newest = new CUEFChunk(file, fname, write);
+		newest = new CUEFChunk(this, write);
 
 		if(!current)
 		{
@@ -78,6 +167,7 @@ void CUEFFile::BuildFileChain(gzFile file, char *fname)
 			current->last = last;
 		}
 	}
+	while(parseptr < arenalen);
 
 	/* relink end of chain to start */
 	current->next = list;
@@ -117,19 +207,15 @@ bool CUEFFile::Open(char *name, Uint16 version, char *mode)
 
 	oldversion = newversion = version;
 	fname = strdup(name);
-	cname = NULL;
-	cinput = NULL;
 
 	/*
 
-	should really do something intelligent here to determine the new
-	'tempname'
+	changes are written to a temporary file alongside the original, which is
+	then renamed over it - so the rename stays within one file system
 
 	*/
-	if(strcmp("_____tmp.uef", name))
-		tempname = strdup("_____tmp.uef");
-	else
-		tempname = strdup("____tmp_.uef");
+	tempname = (char *)malloc(strlen(name) + 5);
+	sprintf(tempname, "%s.tmp", name);
 
 	/*
 
@@ -139,23 +225,18 @@ bool CUEFFile::Open(char *name, Uint16 version, char *mode)
 
 	if(read)
 	{
-		gzFile input;
-
-		if(!(input = gzopen(fname, "rb")))
+		if(!LoadArena(fname))
 			return false;
 
 		/*
 
-		read and check the "UEF File!" UEF identifier string
+		check the "UEF File!" UEF identifier string
 
 		*/
 
-		char ueftext[10];
-		gzread(input, ueftext, 10);
-
-		if(strcmp(ueftext, "UEF File!"))
+		if(arenalen < 12 || memcmp(arena, "UEF File!", 10))
 		{
-			gzclose(input);
+			ReleaseArena();
 			return false;
 		}
 
@@ -168,15 +249,15 @@ bool CUEFFile::Open(char *name, Uint16 version, char *mode)
 
 		Uint8 high, low;
 
-		low = gzgetc(input);
-		high = gzgetc(input);
+		low = arena[10];
+		high = arena[11];
 		oldversion = low | ((int)high << 8);
 
 		if(version)
 		{
 			if( (high != (version >> 8)) || (low > (version&255)) )
 			{
-				gzclose(input);
+				ReleaseArena();
 				return false;
 			}
 		}
@@ -188,13 +269,12 @@ bool CUEFFile::Open(char *name, Uint16 version, char *mode)
 		/*
 
 		if we've got this far, it is indeed an understood UEF file that has
-		been named. So build the 'list' chunk list from that, following
-		include chunks where necessary
+		been named. So build the 'list' chunk list from that
 
 		*/
 
-		BuildFileChain(input, fname);
-		gzclose(input);
+		parseptr = 12;
+		BuildFileChain();
 	}
 	else
 	{
@@ -204,7 +284,7 @@ bool CUEFFile::Open(char *name, Uint16 version, char *mode)
 
 		*/
 
-		list = new CUEFChunk(NULL, NULL, write);
+		list = new CUEFChunk(NULL, write);
 		list->next = list->last = list;
 	}
 
@@ -235,52 +315,11 @@ Uint16 CUEFFile::GetVersion(void)
 	return (list != NULL) ? oldversion : 0;
 }
 
-#define BATCH_SIZE 65536
-
-void move(char *src, char *dst)
-{
-	/*
-
-	does a file move, in 'BATCH_SIZE' byte length batches. Using
-	'rename' won't work since it isn't defined to work across file systems
-
-	BATCH_SIZE can be so small because most UEF files aren't exactly enormous,
-	so stack considerations are more pressing
-
-	*/
-
-	FILE *srcfile, *dstfile;
-	Uint8 buf[BATCH_SIZE];
-	int len;
-
-	srcfile = fopen(src, "rb");
-	dstfile = fopen(dst, "wb");
-
-	if(!dstfile || !srcfile)
-	{
-		if(srcfile) fclose(srcfile);
-		if(dstfile) fclose(dstfile);
-
-		return;
-	}
-
-	do
-	{
-		len = fread(buf, sizeof(Uint8), BATCH_SIZE, srcfile);
-		fwrite(buf, sizeof(Uint8), len, dstfile);
-	}
-	while(len == BATCH_SIZE);
-
-	fclose(srcfile);
-	fclose(dstfile);
-
-	unlink(src);
-}
-
-void CUEFFile::Close(void)
+bool CUEFFile::Close(void)
 {
 	/* check if this CUEFFile actually has any data */
 	CUEFChunk *current;
+	bool written = true;
 
 	if(current = list)
 	{
@@ -307,55 +346,63 @@ void CUEFFile::Close(void)
 		if(write)
 		{
 			gzFile output;
+			char outmode[4];
+			sprintf(outmode, "wb%d", level);
 
-			if(output = gzopen(tempname, "wb9"))
+			if(output = gzopen(tempname, outmode))
 			{
-				gzprintf(output, "UEF File!"); gzputc(output, 0);
+				if(gzprintf(output, "UEF File!") <= 0) written = false;
+				if(gzputc(output, 0) == -1) written = false;
 
-				gzputc(output, newversion&255);
-				gzputc(output, newversion >> 8);
+				if(gzputc(output, newversion&255) == -1) written = false;
+				if(gzputc(output, newversion >> 8) == -1) written = false;
 
 				current = list;
-				while(current)
+				while(current && written)
 				{
-					current->Write(output, this);
+					written = current->Write(output);
 					current = current->next;
 				}
 
-				gzclose(output);
-			}
-		}
-
-		if(cname)
-		{
-			free(cname);
-			cname = NULL;
-		}
+				if(gzclose(output) != Z_OK) written = false;
 
-		if(cinput)
-		{
-			gzclose(cinput);
-			cinput = NULL;
+				if(!written)
+					unlink(tempname);
+			}
+			else
+				written = false;
 		}
 
-		if(write)
-			move(tempname, fname);
-
-		/* kill & delete all members of chain until break is found */
+		/* delete all members of chain until break is found */
 
 		current = list;
 		while(current)
 		{
 			next = current->next;
-
-			current->Kill();
 			delete current;
-
 			current = next;
 		}
 
 		current = list = NULL;
 
+		/* no chunk views remain, so the original file can now be replaced,
+		but only by a complete new one. If that can't be done the original
+		is left as it was */
+		ReleaseArena();
+
+		if(write && written)
+		{
+#ifdef WIN32
+			if(!MoveFileExA(tempname, fname, MOVEFILE_REPLACE_EXISTING))
+#else
+			if(rename(tempname, fname))
+#endif
+			{
+				unlink(tempname);
+				written = false;
+			}
+		}
+
 		if(fname)
 		{
 			free(fname);
@@ -368,20 +415,15 @@ void CUEFFile::Close(void)
 			tempname = NULL;
 		}
 	}
+
+	return written;
 }
 
-gzFile CUEFFile::GetFile(char *name)
+void CUEFFile::SetCompression(int newlevel)
 {
-	if(!cname || strcmp(name, cname))
-	{
-		if(cname) free(cname);
-		cname = strdup(name);
-
-		if(cinput) gzclose(cinput);
-		cinput = gzopen(cname, "rb");
-	}
-
-	return cinput;
+	if(newlevel < 0) newlevel = 0;
+	if(newlevel > 9) newlevel = 9;
+	level = newlevel;
 }
 
 bool CUEFFile::HasFile(void)
@@ -437,6 +479,21 @@ int CUEFChunkSelector::GetOffset(void)
 	return c;
 }
 
+CUEFChunk *CUEFChunkSelector::GetPosition(void)
+{
+	return current;
+}
+
+void CUEFChunkSelector::SetPosition(CUEFChunk *chunk)
+{
+	if(!list || !chunk) return;
+
+	justopen = false;
+	ReleaseCurrent();
+	current = chunk;
+	enabled = false;
+}
+
 bool CUEFChunkSelector::Seek(long offset, int mode)
 {
 	if(!list || offset < 0) return false;
@@ -472,7 +529,7 @@ bool CUEFChunkSelector::Seek(long offset, int mode)
 
 	enabled = false;
 	return true;
-//	return (current->Enable(father) > 0) ? true : false;
+//	return (current->Enable() > 0) ? true : false;
 }
 
 bool CUEFChunkSelector::Find(Uint16 id, int shifter)
@@ -527,7 +584,7 @@ bool CUEFChunkSelector::FindIdMajor(Uint8 id)
 #define CheckEnabled()	\
 	if(!enabled)	\
 	{	\
-		current->Enable(father);\
+		current->Enable();\
 		enabled = true;\
 	}
 
@@ -560,7 +617,7 @@ CUEFChunk *CUEFChunkSelector::EstablishChunk(void)
 	CUEFChunk *next;
 
 	next = current->next;
-	current->next = new CUEFChunk(NULL, NULL, write);
+	current->next = new CUEFChunk(NULL, write);
 
 	/* newly created chunk is 'current->next' */
 
@@ -597,6 +654,7 @@ bool CUEFChunkSelector::RemoveChunk(CUEFChunk *chunk)
 	return false;
 
 	father->Killing(chunk);
+	if(chunk == list) list = list->next;
 
 	if(chunk == current)
 	{
@@ -606,7 +664,6 @@ bool CUEFChunkSelector::RemoveChunk(CUEFChunk *chunk)
 	chunk->next->last = chunk->last;
 	chunk->last->next = chunk->next;
 
-	chunk->Kill();
 	delete chunk;
 
 	return true;
@@ -16,6 +16,7 @@
 */
 
 #include "ULA.h"
+#include "Fence.h"
 #include "ProcessPool.h"
 #include "6502.h"
 #include "Display.h"
@@ -49,7 +50,13 @@ bool CULA::IOCtl(Uint32 Control, void *Parameter, Uint32 TimeStamp)
 			/* take what makes sense of config, return false if there are any changes that can't be made now */
 			Volume = ( (ElectronConfiguration *)Parameter)->Volume;
 			LowSoundLevel = 128 - ((Volume+1) >> 1);
+			MuteAtSpeed = ( (ElectronConfiguration *)Parameter)->Speed.Mute;
 		return false;	/* IOCTL_SETCONFIG always returns the opposite! */
+
+		case IOCTL_SETCLOCKRATE:
+			AudioSpeed = *(Uint32 *)Parameter;
+			LastAudioRemainder = 0;
+		return true;
 	}
 
 	return CComponentBase::IOCtl(Control, Parameter, TimeStamp);
@@ -59,6 +66,9 @@ CULA::CULA(ElectronConfiguration &cfg)
 {
 	RomStates = 0;
 	memset(KeyboardState, 0, 16);
+	KeyEventWritePtr = KeyEventReadPtr = KeyTime = 0;
+	memset(PostedKeys, 0, sizeof(PostedKeys));
+	NumHeldKeys = NumPostedKeys = 0;
 	MRBMode = MRB_UNDEFINED;
 
 	/* build tables for the three types of bus */
@@ -108,13 +118,14 @@ CULA::CULA(ElectronConfiguration &cfg)
 
 	AudioWritePtr = AudioReadPtr = 0;
 	AudioProcessTime = AudioMask = AudioMaskBackup = 0;
-	AudioBuffer[CULA_AUDIOEVENT_LENGTH-1].ClockTime = 0;
-	AudioReadPtrMutex = NULL;
+	AudioPtr = AudioInc = 0;
+	LastAudioClockTime = LastAudioRemainder = 0;
+	AudioSpeed = 1;
+	MuteAtSpeed = false;
 
 	if(SDL_OpenAudio(&WAudioSpec, &AudioSpec) >= 0)
 	{
 		AudioEnabled = true;
-		AudioReadPtrMutex = SDL_CreateMutex();
 
 		/* to avoid using a GCC-specific way of declaring a 64bit constant */
 		AudioNumerator = 0x7A12; //0x7a12 is 31250
@@ -139,11 +150,20 @@ CULA::~CULA()
 	delete[] HaltingRow;
 
 	SDL_CloseAudio();
-	if(AudioReadPtrMutex) SDL_DestroyMutex(AudioReadPtrMutex);
 }
 
 
-/* audio */
+/*
+
+	audio - the emulation thread is the only writer of AudioBuffer and
+	AudioWritePtr, the audio callback the only reader and sole owner of
+	AudioReadPtr. An event is filled in before AudioWritePtr moves past
+	it, so neither side ever needs to wait for the other. Each side moves
+	its own pointer on with ReleaseStore and reads the other's with
+	AcquireLoad (see Fence.h), so that the event itself is seen no later
+	than the pointer that covers it
+
+*/
 void CULA::EnactAudioEvent()
 {
 	/* enact top event */
@@ -172,7 +192,7 @@ void CULA::EnactAudioEvent()
 
 	}
 
-	AudioReadPtr = (AudioReadPtr+1)&(CULA_AUDIOEVENT_LENGTH-1);
+	ReleaseStore(AudioReadPtr, (AudioReadPtr+1)&(CULA_AUDIOEVENT_LENGTH-1));
 }
 
 void CULA::AudioUpdateFunctionHelper(void *tptr, Uint8 *TargetBuffer, int TargetLength)
@@ -180,102 +200,151 @@ void CULA::AudioUpdateFunctionHelper(void *tptr, Uint8 *TargetBuffer, int Target
 	((CULA *)tptr)->AudioUpdateFunction(NULL, TargetBuffer, TargetLength);
 }
 
+/*
+
+	the square wave is generated with band limited steps: the naive output
+	is corrected over the sample either side of each edge by a two sample
+	polynomial approximation of the difference between an ideal step and
+	a band limited one (i.e. 'PolyBLEP'). t is the phase of the wave and
+	dt the phase step per sample, both as fractions of a whole cycle
+
+*/
+static inline float PolyBLEP(float t, float dt)
+{
+	if(t < dt)
+	{
+		t /= dt;
+		return t+t - t*t - 1.0f;
+	}
+
+	if(t > 1.0f - dt)
+	{
+		t = (t - 1.0f) / dt;
+		return t*t + t+t + 1.0f;
+	}
+
+	return 0.0f;
+}
+
+#define PHASE_SCALE		(1.0f / 4294967296.0f)
+
 void CULA::AudioUpdateFunction(void *tptr, Uint8 *TargetBuffer, int TargetLength)
 {
-	SDL_mutexP(AudioReadPtrMutex);
+	/* anything written after this point will wait for the next callback */
+	Uint32 WritePtr = AcquireLoad(AudioWritePtr);
 
-	if(!AudioMask && (AudioReadPtr == AudioWritePtr))
+	if((!AudioMask || AudioSilenced()) && (AudioReadPtr == WritePtr))
 	{
 		/* if audio is disabled and there are no interesting events, then we know the outcome already */
 		memset(TargetBuffer, LowSoundLevel, TargetLength);
 		AudioProcessTime += TargetLength;
+		return;
 	}
-	else
+
+	int SPtr = 0;
+
+	/* check if we've run ahead */
+	if(AudioProcessTime > AudioBuffer[ AudioReadPtr ].SampleDiff)
+		AudioProcessTime = AudioBuffer[ AudioReadPtr ].SampleDiff;
+
+	/* check if we're miles behind */
+	if( AudioReadPtr != WritePtr)
 	{
-		int SPtr = 0;
-		
-		/* check if we've run ahead */
-		if(AudioProcessTime > AudioBuffer[ AudioReadPtr ].SampleDiff)
-			AudioProcessTime = AudioBuffer[ AudioReadPtr ].SampleDiff;
+		while(1)
+		{
+			Uint32 TimeDiff = AudioBuffer[ (WritePtr-1)&(CULA_AUDIOEVENT_LENGTH-1) ].ClockTime - AudioBuffer[ AudioReadPtr ].ClockTime;
+			if(TimeDiff < 125000*(AudioSpeed ? AudioSpeed : 1)) break;
+			EnactAudioEvent();
+		}
+	}
 
-		/* check if we're miles behind */
-		if( AudioReadPtr != AudioWritePtr)
+	/* normal processing */
+	while(SPtr < TargetLength)
+	{
+		while(
+			( AudioReadPtr != WritePtr) &&
+			( AudioProcessTime >= AudioBuffer[ AudioReadPtr ].SampleDiff)
+		)
 		{
-			while(1)
-			{
-				Uint32 TimeDiff = AudioBuffer[ (AudioWritePtr-1)&(CULA_AUDIOEVENT_LENGTH-1) ].ClockTime - AudioBuffer[ AudioReadPtr ].ClockTime;
-				if(TimeDiff < 125000) break;
-				EnactAudioEvent();
-			}
+			AudioProcessTime -= AudioBuffer[ AudioReadPtr ].SampleDiff;
+			EnactAudioEvent();
 		}
 
-		/* normal processing */
-		while(SPtr < TargetLength)
+		Uint32 SamplesToWrite;
+		if(AudioReadPtr == WritePtr)
 		{
-			while(
-				( AudioReadPtr != AudioWritePtr) &&
-				( AudioProcessTime >= AudioBuffer[ AudioReadPtr ].SampleDiff)
-			)
-			{
-				AudioProcessTime -= AudioBuffer[ AudioReadPtr ].SampleDiff;
-				EnactAudioEvent();
-			}
+			SamplesToWrite = TargetLength-SPtr;
+		}
+		else
+		{
+			SamplesToWrite = AudioBuffer[ AudioReadPtr ].SampleDiff - AudioProcessTime;
 
-			Uint32 SamplesToWrite;
-			if(AudioReadPtr == AudioWritePtr)
-			{
+			if(SamplesToWrite > (unsigned)(TargetLength-SPtr))
 				SamplesToWrite = TargetLength-SPtr;
-			}
-			else
-			{
-				SamplesToWrite = AudioBuffer[ AudioReadPtr ].SampleDiff - AudioProcessTime;
+		}
 
-				if(SamplesToWrite > (unsigned)(TargetLength-SPtr))
-					SamplesToWrite = TargetLength-SPtr;
-			}
+		AudioProcessTime += SamplesToWrite;
 
-			AudioProcessTime += SamplesToWrite;
+		if(!AudioMask || !AudioInc || AudioSilenced())
+		{
+			/* no edges in this stretch, so it's a flat line */
+			memset(&TargetBuffer[SPtr], (AudioMask && (AudioPtr&0x80000000) && !AudioSilenced()) ? LowSoundLevel + Volume : LowSoundLevel, SamplesToWrite);
+			AudioPtr += AudioInc*SamplesToWrite;
+			SPtr += SamplesToWrite;
+		}
+		else
+		{
+			float Amplitude = Volume * 0.5f;
+			float Centre = LowSoundLevel + Amplitude + 0.5f;
+			float dt = AudioInc * PHASE_SCALE;
 
 			while(SamplesToWrite--)
 			{
-				TargetBuffer[SPtr] = (Uint8)(LowSoundLevel + (( ((AudioPtr&0x80000000) >> 31) * Volume )& AudioMask));
+				float Level = (AudioPtr&0x80000000) ? 1.0f : -1.0f;
+				Level -= PolyBLEP(AudioPtr * PHASE_SCALE, dt);
+				Level += PolyBLEP((Uint32)(AudioPtr + 0x80000000) * PHASE_SCALE, dt);
+
+				float Sample = Centre + Level*Amplitude;
+				TargetBuffer[SPtr++] = (Sample < 0.0f) ? 0 : ((Sample > 255.0f) ? 255 : (Uint8)Sample);
 				AudioPtr += AudioInc;
-				SPtr++;
 			}
 		}
 	}
-
-	SDL_mutexV(AudioReadPtrMutex);
 }
 
 void CULA::WriteAudioEvent(Uint32 TimeStamp)
 {
-	SDL_mutexP(AudioReadPtrMutex);
+	Uint32 NextWritePtr = (AudioWritePtr+1)&(CULA_AUDIOEVENT_LENGTH-1);
 
-	AudioBuffer[AudioWritePtr].ClockTime = TimeStamp;
+	/* if the audio callback has stalled for this long then losing the event hardly matters */
+	if(NextWritePtr == AcquireLoad(AudioReadPtr)) return;
 
-	Uint64 Difference = TimeStamp - AudioBuffer[(AudioWritePtr-1)&(CULA_AUDIOEVENT_LENGTH-1)].ClockTime;
-	Uint64 SDDiff = Difference*(Uint64)AudioSpec.freq + AudioBuffer[(AudioWritePtr-1)&(CULA_AUDIOEVENT_LENGTH-1)].Remainder;
+	AudioBuffer[AudioWritePtr].ClockTime = TimeStamp;
 
-	AudioBuffer[AudioWritePtr].SampleDiff = (Uint32)(SDDiff / 1996800);
-	AudioBuffer[AudioWritePtr].Remainder = (Uint32)(SDDiff % 1996800);
+	Uint64 Difference = TimeStamp - LastAudioClockTime;
+	Uint64 SDDiff = Difference*(Uint64)AudioSpec.freq + LastAudioRemainder;
 
-	AudioWritePtr = (AudioWritePtr+1)&(CULA_AUDIOEVENT_LENGTH-1);
+	/* above 1x the same events are packed into proportionally fewer samples */
+	Uint64 ClockRate = (Uint64)1996800 * (AudioSpeed ? AudioSpeed : 1);
+	AudioBuffer[AudioWritePtr].SampleDiff = (Uint32)(SDDiff / ClockRate);
+	LastAudioRemainder = (Uint32)(SDDiff % ClockRate);
+	LastAudioClockTime = TimeStamp;
 
-	SDL_mutexV(AudioReadPtrMutex);
+	ReleaseStore(AudioWritePtr, NextWritePtr);
 }
 
 Uint32 CULA::Update(Uint32 t, bool)
 {
 	TotalTime += t;
 	UpdateKeyTable();
+	ReleaseStore(KeyTime, TotalTime);
 
 	if(AudioEnabled)
 	{
-		if(AudioReadPtr == AudioWritePtr)
+		if(AcquireLoad(AudioReadPtr) == AudioWritePtr)
 		{
 			/* generate NOP event to keep sound system alert and awake if it has been four seconds since an event */
-			Uint32 BigDiff = TotalTime - AudioBuffer[(AudioWritePtr-1)&(CULA_AUDIOEVENT_LENGTH-1)].ClockTime;
+			Uint32 BigDiff = TotalTime - LastAudioClockTime;
 
 			if(BigDiff > 8000000)
 			{
@@ -285,7 +354,8 @@ Uint32 CULA::Update(Uint32 t, bool)
 		}
 	}
 
-	return CYCLENO_ANY;
+	/* come back when the next key event falls due */
+	return NextKeyEvent();
 }
 
 void CULA::SetROMMode(int slot, int mode)
@@ -610,12 +680,10 @@ void CULA::AttachTo(CProcessPool &pool, Uint32 id)
 	pool.SetTrapAddressSet(0);
 	RomStates = 0;
 
-	while(
-		( AudioReadPtr != AudioWritePtr)
-	)
-		EnactAudioEvent();
-
-	AudioBuffer[(AudioWritePtr-1)&(CULA_AUDIOEVENT_LENGTH-1)].ClockTime = TotalTime = ProgramTime = 0;
+	/* time restarts from zero; anything still queued is from before that, so
+	the audio callback will see it as miles behind and skip straight through it */
+	LastAudioClockTime = LastAudioRemainder = TotalTime = ProgramTime = 0;
+	ReleaseStore(KeyTime, 0);
 	/* set into a defined start state */
 //	ClockDividerBackup = 0xff;
 //	Write(0xfe06, 0, 0, 0);
@@ -17,6 +17,9 @@
 #define MEM_ROM(n)			2+n
 
 #define CULA_AUDIOEVENT_LENGTH	1024
+#define CULA_KEYEVENT_LENGTH	64
+#define CULA_MAXHELDKEYS		32
+#define CULA_KEYLATENCY			CYCLENO_ANY	/* cycles from the ULA's last update to a posted key event taking effect */
 
 #define KEYMOD_SHIFT	4
 #define KEYMOD_CTRL		2
@@ -64,8 +67,14 @@ class CULA : public CComponentBase
 		/* see below for notes on this! */
 		void RedefineKey(Uint8 SrcMods, SDLKey Key, Uint8 TrgMods, Uint8 Line, Uint8 Mask);
 
-		/* UpdateKeyTable updates the Electron keyboard state based on the current PC keyboard state */
-		void UpdateKeyTable();
+		/* PostKeyEvent is for whichever thread receives SDL events - it queues a PC key
+		going down or up, stamped with the emulated cycle it is to take effect at.
+		UpdateKeyTable applies queued transitions that are due to the Electron keyboard
+		state, or all of them if AllEvents is set, and is otherwise called only by the
+		ULA's own Update or while emulation is stopped, so the queue has exactly one
+		reader and one writer and needs no locking */
+		void PostKeyEvent(SDLKey Key, bool Down);
+		void UpdateKeyTable(bool AllEvents = false);
 
 		/* QueryKey returns true if the 'ElkCode' key is depressed, false otherwise.
 		An ElkCode is formed with a high nibble equal to keyline, low nibble equal to mask */
@@ -257,6 +266,28 @@ class CULA : public CComponentBase
 		bool Keyboard, CapsLED;
 
 		Uint8 KeyboardState[16];
+
+		/* PC keys currently down, as learnt from the key event queue. KeyTime is
+		TotalTime as of the last update, published for PostKeyEvent to stamp events
+		with. PostedKeys and NumPostedKeys belong to the posting thread and record
+		which keys it has queued as down, so that room can always be kept for
+		their releases */
+		struct KeyEvent
+		{
+			Uint32 Time;
+			Uint16 Key;
+			bool Down;
+		} KeyEvents[CULA_KEYEVENT_LENGTH];
+		volatile Uint32 KeyEventWritePtr, KeyEventReadPtr, KeyTime;
+		Uint8 PostedKeys[(SDLK_LAST+7) >> 3];
+		Uint32 NumPostedKeys;
+		Uint16 HeldKeys[CULA_MAXHELDKEYS];
+		int NumHeldKeys;
+		bool ReadKeyEvents(bool AllEvents);
+		Uint32 NextKeyEvent();
+		bool KeyHeld(Uint16 Key);
+		void MapHeldKeys();
+
 		struct KeyDefinition
 		{
 			Uint8 Shift, Line, Mask;
@@ -287,12 +318,12 @@ class CULA : public CComponentBase
 			} Type;
 
 			Uint8 Value;
-			Uint32 SampleDiff, ClockTime, Remainder;
+			Uint32 SampleDiff, ClockTime;
 		};
 
 		AudioEvent AudioBuffer[CULA_AUDIOEVENT_LENGTH];
-		Uint32 AudioWritePtr, AudioReadPtr;
-		SDL_mutex *AudioReadPtrMutex;
+		volatile Uint32 AudioWritePtr, AudioReadPtr;
+		Uint32 LastAudioClockTime, LastAudioRemainder;
 		void AudioUpdateFunction(void *, Uint8 *, int);
 		static void AudioUpdateFunctionHelper(void *, Uint8 *, int);
 		void WriteAudioEvent(Uint32);
@@ -314,6 +345,12 @@ class CULA : public CComponentBase
 
 		/* volume */
 		Uint8 LowSoundLevel, Volume;
+
+		/* speed - away from 1x audio is either silenced or played back
+		AudioSpeed times faster at the same pitch */
+		Uint32 AudioSpeed;
+		bool MuteAtSpeed;
+		bool AudioSilenced() {return !AudioSpeed || (AudioSpeed != 1 && MuteAtSpeed);}
 };
 
 #endif